@@ -18,6 +18,11 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include "../physics/geometry/ConvexHull.h"
+#include "../physics/geometry/ConvexDecomposition.h"
+#include "../physics/geometry/TriangleMesh.h"
+#include "../physics/geometry/Heightfield.h"
+
 struct Vertex
 {
 	glm::vec3 pos;
@@ -316,121 +321,113 @@ public:
 		//glDeleteTextures(1, )
 	}
 
-	std::vector<fiz::Polyhedron> loadPolyhedronAndDecompose(const std::string& filepath)
+	/**
+	Loads every object in the file as one mesh and splits it into convex hulls.
+	The hulls are cached next to the file and reused while the file, scale
+	and settings stay the same. The models show the hulls, not the mesh.
+	*/
+	std::vector<fiz::Shape*> loadPolyhedronAndDecompose(const std::string& filepath, float scale, const fiz::DecompositionSettings& settings = fiz::DecompositionSettings())
 	{
-		std::vector<fiz::Polyhedron> polyhedra;
-
-		std::string text;
-		std::ifstream file(filepath);
-
-		std::vector<glm::vec3> vertices;
-		std::vector<glm::vec3> normals;
-		std::vector<glm::vec2> textures;
+		std::string cache_path = filepath + ".hulls";
+		uint64_t key = fiz::ConvexDecomposition::hashFile(filepath);
+		key = fiz::ConvexDecomposition::hash(&scale, sizeof(scale), key);
+		key = fiz::ConvexDecomposition::hashSettings(settings, key);
 
-		std::vector<glm::uvec3> faces;
-
-		std::vector<float> vertex_buffer;
-		unsigned int vertex_count = 0;
-
-		while (std::getline(file, text))
+		fiz::ConvexDecomposition decomposition;
+		if (!decomposition.load(cache_path, key))
 		{
-			// split current line into tokens
-			unsigned int token_length = 0;
-			std::string tokens[8];
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			std::string warn, err;
 
-			std::stringstream ss(text);
-			while (ss >> tokens[token_length])
-				token_length++;
+			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+				throw std::runtime_error(warn + err);
 
-			if (token_length == 0)
-				continue;
+			std::vector<glm::vec3> vertices;
+			std::vector<glm::uvec3> triangles;
 
-			if (tokens[0] == "v")
+			for (unsigned int i = 0; i < shapes.size(); ++i)
 			{
-				float x = std::stof(tokens[1]);
-				float y = std::stof(tokens[2]);
-				float z = std::stof(tokens[3]);
+				// objects keep their own vertices so they stay separate pieces
+				std::unordered_map<glm::vec3, unsigned int> unique_vertices;
+				std::vector<unsigned int> indices;
 
-				glm::vec3 vertex = glm::vec3(x, y, z);
-				vertices.push_back(vertex);
-			}
-			else if (tokens[0] == "vt")
-			{
-				float u = std::stof(tokens[1]);
-				float v = std::stof(tokens[2]);
+				for (const auto& index : shapes[i].mesh.indices)
+				{
+					glm::vec3 pos = {
+						attrib.vertices[3 * index.vertex_index + 0],
+						-attrib.vertices[3 * index.vertex_index + 2],
+						attrib.vertices[3 * index.vertex_index + 1]
+					};
+					pos *= scale;
+
+					if (unique_vertices.count(pos) == 0)
+					{
+						unique_vertices[pos] = vertices.size();
+						vertices.push_back(pos);
+					}
+					indices.push_back(unique_vertices[pos]);
+				}
 
-				glm::vec2 texture = glm::vec2(u, v);
-				textures.push_back(texture);
+				for (unsigned int j = 0; j < indices.size() / 3; ++j)
+					triangles.push_back(glm::uvec3(indices[3 * j], indices[3 * j + 1], indices[3 * j + 2]));
 			}
-			else if (tokens[0] == "vn")
-			{
-				float x = std::stof(tokens[1]);
-				float y = std::stof(tokens[2]);
-				float z = std::stof(tokens[3]);
 
-				glm::vec3 vertex = glm::vec3(x, y, z);
-				normals.push_back(vertex);
-			}
-			else if (tokens[0] == "f")
-			{
-				int slash_loc = tokens[1].find("/");
-				int slash_loc_next = tokens[1].find("/", slash_loc + 1);
-				int v1 = std::stoi(tokens[1].substr(0, slash_loc)) - 1;
-				int t1 = std::stoi(tokens[1].substr(slash_loc + 1, slash_loc_next)) - 1;
-				int vn1 = std::stoi(tokens[1].substr(slash_loc_next + 1, std::string::npos)) - 1;
+			decomposition.decompose(vertices, triangles, settings);
+			decomposition.save(cache_path, key);
+		}
 
-				slash_loc = tokens[2].find("/");
-				slash_loc_next = tokens[2].find("/", slash_loc + 1);
-				int v2 = std::stoi(tokens[2].substr(0, slash_loc)) - 1;
-				int t2 = std::stoi(tokens[2].substr(slash_loc + 1, slash_loc_next)) - 1;
-				int vn2 = std::stoi(tokens[2].substr(slash_loc_next + 1, std::string::npos)) - 1;
+		std::vector<fiz::Shape*> poly_shapes;
+		std::vector<fiz::Polyhedron*> polyhedra = decomposition.createPolyhedra();
+		for (unsigned int i = 0; i < polyhedra.size(); ++i)
+		{
+			// flat shaded model of the hull
+			std::vector<Vertex> vertex_buffer;
+			for (unsigned int j = 0; j < polyhedra[i]->indices.size(); ++j)
+			{
+				glm::vec3 a = polyhedra[i]->vertices[polyhedra[i]->indices[j].x];
+				glm::vec3 b = polyhedra[i]->vertices[polyhedra[i]->indices[j].y];
+				glm::vec3 c = polyhedra[i]->vertices[polyhedra[i]->indices[j].z];
+				glm::vec3 norm = glm::normalize(glm::cross(b - a, c - a));
+
+				vertex_buffer.push_back({ a, norm, glm::vec2(0.0f, 0.0f) });
+				vertex_buffer.push_back({ b, norm, glm::vec2(1.0f, 0.0f) });
+				vertex_buffer.push_back({ c, norm, glm::vec2(0.0f, 1.0f) });
+			}
 
-				slash_loc = tokens[3].find("/");
-				slash_loc_next = tokens[3].find("/", slash_loc + 1);
-				int v3 = std::stoi(tokens[3].substr(0, slash_loc)) - 1;
-				int t3 = std::stoi(tokens[3].substr(slash_loc + 1, slash_loc_next)) - 1;
-				int vn3 = std::stoi(tokens[3].substr(slash_loc_next + 1, std::string::npos)) - 1;
+			unsigned int VBO;
+			glGenBuffers(1, &VBO);
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-				vertex_buffer.push_back(vertices[v1].x);
-				vertex_buffer.push_back(vertices[v1].y);
-				vertex_buffer.push_back(vertices[v1].z);
-				vertex_buffer.push_back(normals[vn1].x);
-				vertex_buffer.push_back(normals[vn1].y);
-				vertex_buffer.push_back(normals[vn1].z);
-				vertex_buffer.push_back(textures[t1].x);
-				vertex_buffer.push_back(textures[t1].y);
+			unsigned int VAO;
+			glGenVertexArrays(1, &VAO);
+			glBindVertexArray(VAO);
 
-				vertex_buffer.push_back(vertices[v2].x);
-				vertex_buffer.push_back(vertices[v2].y);
-				vertex_buffer.push_back(vertices[v2].z);
-				vertex_buffer.push_back(normals[vn2].x);
-				vertex_buffer.push_back(normals[vn2].y);
-				vertex_buffer.push_back(normals[vn2].z);
-				vertex_buffer.push_back(textures[t2].x);
-				vertex_buffer.push_back(textures[t2].y);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertex_buffer.size(), vertex_buffer.data(), GL_STATIC_DRAW);
 
-				vertex_buffer.push_back(vertices[v3].x);
-				vertex_buffer.push_back(vertices[v3].y);
-				vertex_buffer.push_back(vertices[v3].z);
-				vertex_buffer.push_back(normals[vn3].x);
-				vertex_buffer.push_back(normals[vn3].y);
-				vertex_buffer.push_back(normals[vn3].z);
-				vertex_buffer.push_back(textures[t3].x);
-				vertex_buffer.push_back(textures[t3].y);
+			// vertex positions
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(0);
 
-				glm::uvec3 face = glm::uvec3(v1, v2, v3);
-				faces.push_back(face);
+			// vertex normals
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+			glEnableVertexAttribArray(1);
 
-				vertex_count += 3;
-			}
-		}
+			// vertex texture coordinates
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+			glEnableVertexAttribArray(2);
 
+			polyhedronVAO.push_back(VAO);
+			polyhedron_vertex_count.push_back(vertex_buffer.size());
 
+			poly_shapes.push_back((fiz::Shape*)polyhedra[i]);
+		}
 
-		return polyhedra;
+		return poly_shapes;
 	}
 
-	fiz::Shape* loadPolyhedron(const std::string& filepath, float scale)
+	fiz::Shape* loadPolyhedron(const std::string& filepath, float scale, const fiz::HullSettings& hull_settings = fiz::HullSettings())
 	{
 		std::string text;
 		std::ifstream file(filepath);
@@ -561,13 +558,23 @@ public:
 
 		file.close();
 
-		fiz::Polyhedron* shape = new fiz::Polyhedron(vertices.size());
+		// the rigid body uses the cooked hull, the model keeps the original mesh
+		fiz::Polyhedron* shape;
+		fiz::ConvexHull hull;
+		if (hull.build(vertices, hull_settings))
+		{
+			shape = hull.createPolyhedron();
+		}
+		else
+		{
+			shape = new fiz::Polyhedron(vertices.size());
 
-		for (unsigned int i = 0; i < vertices.size(); ++i)
-			shape->addVertex(vertices[i]);
+			for (unsigned int i = 0; i < vertices.size(); ++i)
+				shape->addVertex(vertices[i]);
 
-		for (unsigned int i = 0; i < faces.size(); ++i)
-			shape->addIndex(faces[i]);
+			for (unsigned int i = 0; i < faces.size(); ++i)
+				shape->addIndex(faces[i]);
+		}
 
 		polyhedronVAO.push_back(VAO);
 		polyhedron_vertex_count.push_back(vertex_count);
@@ -575,7 +582,145 @@ public:
 		return (fiz::Shape*)shape;
 	}
 
-	std::vector<fiz::Shape*> loadPolyhedra(const std::string& filepath)
+	/**
+	Loads every object in the file as a single static triangle mesh.
+	Vertices at the same position are welded so seams between objects
+	share edges and get internal edge correction.
+	*/
+	fiz::Shape* loadTriangleMesh(const std::string& filepath, float scale)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+			throw std::runtime_error(warn + err);
+
+		std::vector<Vertex> vertex_buffer; // for model
+
+		std::vector<glm::vec3> vertices; // for rigid body
+		std::unordered_map<glm::vec3, unsigned int> unique_vertices;
+		std::vector<unsigned int> indices;
+
+		for (unsigned int i = 0; i < shapes.size(); ++i)
+		{
+			for (const auto& index : shapes[i].mesh.indices)
+			{
+				glm::vec3 pos = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					-attrib.vertices[3 * index.vertex_index + 2],
+					attrib.vertices[3 * index.vertex_index + 1]
+				};
+				pos *= scale;
+
+				glm::vec3 norm = {
+					attrib.normals[3 * index.normal_index + 0],
+					-attrib.normals[3 * index.normal_index + 2],
+					attrib.normals[3 * index.normal_index + 1]
+				};
+
+				glm::vec2 tex = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1]
+				};
+
+				if (unique_vertices.count(pos) == 0)
+				{
+					unique_vertices[pos] = vertices.size();
+					vertices.push_back(pos);
+				}
+
+				vertex_buffer.push_back({ pos, norm, tex });
+				indices.push_back(unique_vertices[pos]);
+			}
+		}
+
+		unsigned int VBO;
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		unsigned int VAO;
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertex_buffer.size(), vertex_buffer.data(), GL_STATIC_DRAW);
+
+		// vertex positions
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+
+		// vertex normals
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		// vertex texture coordinates
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+
+		std::vector<glm::uvec3> triangles;
+		for (unsigned int i = 0; i < indices.size() / 3; ++i)
+			triangles.push_back(glm::uvec3(indices[3 * i], indices[3 * i + 1], indices[3 * i + 2]));
+
+		fiz::TriangleMesh* mesh = new fiz::TriangleMesh(vertices, triangles);
+
+		polyhedronVAO.push_back(VAO);
+		polyhedron_vertex_count.push_back(vertex_buffer.size());
+
+		return (fiz::Shape*)mesh;
+	}
+
+	/**
+	Builds a model of the cell triangles of a heightfield
+	*/
+	void createHeightfieldModel(fiz::Heightfield* heightfield)
+	{
+		std::vector<Vertex> vertex_buffer;
+		vertex_buffer.reserve(heightfield->columns * heightfield->rows * 6);
+
+		for (unsigned int i = 0; i < heightfield->columns * heightfield->rows * 2; ++i)
+		{
+			fiz::Triangle triangle = heightfield->getTriangle(i);
+			glm::vec3 normal = heightfield->getNormal(triangle);
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				glm::vec2 tex = glm::vec2(triangle.v[j].x, triangle.v[j].y) / heightfield->cell_size;
+				vertex_buffer.push_back({ triangle.v[j], normal, tex });
+			}
+		}
+
+		unsigned int VBO;
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		unsigned int VAO;
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertex_buffer.size(), vertex_buffer.data(), GL_STATIC_DRAW);
+
+		// vertex positions
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+
+		// vertex normals
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		// vertex texture coordinates
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+
+		polyhedronVAO.push_back(VAO);
+		polyhedron_vertex_count.push_back(vertex_buffer.size());
+	}
+
+	/**
+	Loads every object in the file as a polyhedron.
+	If cook_hulls is set each object is replaced by its convex hull,
+	otherwise the triangles are kept as they are for raycasting.
+	*/
+	std::vector<fiz::Shape*> loadPolyhedra(const std::string& filepath, bool cook_hulls = false, const fiz::HullSettings& hull_settings = fiz::HullSettings())
 	{
 		std::vector<fiz::Shape*> poly_shapes;
 
@@ -651,15 +796,24 @@ public:
 			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 			glEnableVertexAttribArray(2);
 
-			fiz::Polyhedron* shape = new fiz::Polyhedron(vertices.size());
+			fiz::Polyhedron* shape;
+			fiz::ConvexHull hull;
+			if (cook_hulls && hull.build(vertices, hull_settings))
+			{
+				shape = hull.createPolyhedron();
+			}
+			else
+			{
+				shape = new fiz::Polyhedron(vertices.size());
 
-			for (unsigned int i = 0; i < vertices.size(); ++i)
-				shape->addVertex(vertices[i]);
+				for (unsigned int i = 0; i < vertices.size(); ++i)
+					shape->addVertex(vertices[i]);
 
-			for (unsigned int i = 0; i < indices.size() / 3; ++i)
-			{
-				glm::uvec3 ind = { indices[3 * i], indices[3 * i + 1], indices[3 * i + 2] };
-				shape->addIndex(ind);
+				for (unsigned int i = 0; i < indices.size() / 3; ++i)
+				{
+					glm::uvec3 ind = { indices[3 * i], indices[3 * i + 1], indices[3 * i + 2] };
+					shape->addIndex(ind);
+				}
 			}
 
 			polyhedronVAO.push_back(VAO);
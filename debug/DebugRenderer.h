@@ -54,7 +54,9 @@ public:
 	bool show_sleep;
 	bool outline_shapes;
 
-	DebugRenderer(fiz::World* world) : world(world), light_direction(0.0f, 0.0f, -1.0f), camera(glm::vec3(0.0f, -10.0f, 5.0f), glm::vec3(0.0f, 1.0f, -0.2f), glm::vec3(0.0f, 0.0f, 1.0f)), models(100), show_contact_points(false), show_contact_normals(false), show_BVH(false), show_velocities(false), show_aabb(false), show_sleep(false), outline_shapes(false), render_mode(RENDER_COLORS)
+	float plane_render_size; // half width of the square drawn for each plane
+
+	DebugRenderer(fiz::World* world) : world(world), light_direction(0.0f, 0.0f, -1.0f), camera(glm::vec3(0.0f, -10.0f, 5.0f), glm::vec3(0.0f, 1.0f, -0.2f), glm::vec3(0.0f, 0.0f, 1.0f)), models(100), show_contact_points(false), show_contact_normals(false), show_BVH(false), show_velocities(false), show_aabb(false), show_sleep(false), outline_shapes(false), plane_render_size(20.0f), render_mode(RENDER_COLORS)
 	{
 		// generate shaders
 		shape_shader = new Shader("shaders/Vertex.shader", "shaders/Fragment.shader");
@@ -165,16 +167,37 @@ public:
 		}
 	}
 
-	fiz::Shape* loadPolyhedron(const std::string& filepath, float scale)
+	fiz::Shape* loadPolyhedron(const std::string& filepath, float scale, const fiz::HullSettings& hull_settings = fiz::HullSettings())
 	{
-		fiz::Shape* polyhedron_shape = models.loadPolyhedron(filepath, scale);
+		fiz::Shape* polyhedron_shape = models.loadPolyhedron(filepath, scale, hull_settings);
 		polyhedron_shapes.push_back(polyhedron_shape);
 		return polyhedron_shape;
 	}
 
-	std::vector<fiz::Shape*> loadPolyhedra(const std::string& filepath, float scale)
+	std::vector<fiz::Shape*> loadPolyhedra(const std::string& filepath, float scale, bool cook_hulls = false, const fiz::HullSettings& hull_settings = fiz::HullSettings())
+	{
+		std::vector<fiz::Shape*> polyhedra_shapes = models.loadPolyhedra(filepath, cook_hulls, hull_settings);
+		for (unsigned int i = 0; i < polyhedra_shapes.size(); ++i)
+			polyhedron_shapes.push_back(polyhedra_shapes[i]);
+		return polyhedra_shapes;
+	}
+
+	fiz::Shape* loadTriangleMesh(const std::string& filepath, float scale)
+	{
+		fiz::Shape* mesh_shape = models.loadTriangleMesh(filepath, scale);
+		polyhedron_shapes.push_back(mesh_shape);
+		return mesh_shape;
+	}
+
+	void addHeightfield(fiz::Shape* heightfield)
 	{
-		std::vector<fiz::Shape*> polyhedra_shapes = models.loadPolyhedra(filepath);
+		models.createHeightfieldModel((fiz::Heightfield*)heightfield);
+		polyhedron_shapes.push_back(heightfield);
+	}
+
+	std::vector<fiz::Shape*> loadPolyhedronAndDecompose(const std::string& filepath, float scale, const fiz::DecompositionSettings& settings = fiz::DecompositionSettings())
+	{
+		std::vector<fiz::Shape*> polyhedra_shapes = models.loadPolyhedronAndDecompose(filepath, scale, settings);
 		for (unsigned int i = 0; i < polyhedra_shapes.size(); ++i)
 			polyhedron_shapes.push_back(polyhedra_shapes[i]);
 		return polyhedra_shapes;
@@ -326,7 +349,7 @@ public:
 		setSphereColor(glm::vec3(1.0f, 0.0f, 0.0f));
 		for (unsigned int i = 0; i < manifold.num_contacts && i < 4; ++i)
 		{
-			renderSphere(manifold.local_a[i], 0.05f);
+			renderSphere(manifold.getWorldA(i), 0.05f);
 		}
 	}
 
@@ -455,6 +478,10 @@ public:
 		{
 			fiz::Shape* shape = body.shapes[j];
 
+			// children of compound bodies are offset from the body origin
+			glm::mat4 child_model = glm::translate(model, getShapeOffset(shape));
+			setShaderModel(child_model);
+
 			switch (shape->shape_type)
 			{
 			case fiz::SPHERE_TYPE:
@@ -464,7 +491,7 @@ public:
 				if (outline_shapes)
 				{
 					line_shader->use();
-					glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+					glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(child_model));
 					glUniformMatrix4fv(line_view_loc, 1, GL_FALSE, glm::value_ptr(camera.view));
 					glUniformMatrix4fv(line_proj_loc, 1, GL_FALSE, glm::value_ptr(camera.projection));
 
@@ -498,7 +525,7 @@ public:
 				if (outline_shapes)
 				{
 					line_shader->use();
-					glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+					glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(child_model));
 					glUniformMatrix4fv(line_view_loc, 1, GL_FALSE, glm::value_ptr(camera.view));
 					glUniformMatrix4fv(line_proj_loc, 1, GL_FALSE, glm::value_ptr(camera.projection));
 
@@ -537,7 +564,7 @@ public:
 				glDrawElements(GL_TRIANGLES, index_size * 3, GL_UNSIGNED_INT, 0);
 
 				/*line_shader->use();
-				glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+				glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(child_model));
 				glUniformMatrix4fv(line_view_loc, 1, GL_FALSE, glm::value_ptr(camera.view));
 				glUniformMatrix4fv(line_proj_loc, 1, GL_FALSE, glm::value_ptr(camera.projection));
 
@@ -556,10 +583,10 @@ public:
 
 				fiz::Capsule* capsule = (fiz::Capsule*)shape;
 				
-				renderCapsule(model, capsule->rad, capsule->height);
+				renderCapsule(child_model, capsule->rad, capsule->height);
 
 				/*line_shader->use();
-				glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+				glUniformMatrix4fv(line_model_loc, 1, GL_FALSE, glm::value_ptr(child_model));
 				glUniformMatrix4fv(line_view_loc, 1, GL_FALSE, glm::value_ptr(camera.view));
 				glUniformMatrix4fv(line_proj_loc, 1, GL_FALSE, glm::value_ptr(camera.projection));
 
@@ -570,6 +597,8 @@ public:
 				break;
 			}
 			case fiz::POLYHEDRON_TYPE:
+			case fiz::TRIANGLE_MESH_TYPE:
+			case fiz::HEIGHTFIELD_TYPE:
 			{
 				if (is_asleep && show_sleep)
 					glBindTexture(GL_TEXTURE_2D, models.sleep_texture);
@@ -578,9 +607,9 @@ public:
 
 				for (unsigned int x = 0; x < polyhedron_shapes.size(); ++x)
 				{
-					if (body.shapes[0] == polyhedron_shapes[x])
+					if (shape == polyhedron_shapes[x])
 					{
-						renderPolyhedron(model, x);
+						renderPolyhedron(child_model, x);
 						break;
 					}
 				}
@@ -665,6 +694,23 @@ public:
 			renderBody(body, i);
 		}
 
+		// planes are drawn as a square around the closest point to the body origin
+		setEdgePlaneColor(glm::vec3(0.6f, 0.6f, 0.7f));
+		setEdgePlaneStartOpacity(0.4f);
+		setEdgePlaneEndOpacity(0.4f);
+		for (unsigned int i = 0; i < world->plane_bodies.size(); ++i)
+		{
+			fiz::Body& body = world->plane_bodies[i];
+			fiz::Plane* plane = (fiz::Plane*)body.shapes[0];
+			glm::vec3 normal = body.getWorldVec(plane->normal);
+			glm::vec3 center = body.getWorldPos(plane->normal * plane->offset);
+
+			glm::vec3 tangent = glm::abs(normal.z) < 0.9f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 u = glm::normalize(glm::cross(normal, tangent)) * plane_render_size;
+			glm::vec3 v = glm::cross(normal, u);
+			renderEdgePlane(center - u - v, center + u - v, v, plane_render_size * 2.0f);
+		}
+
 		for (unsigned int i = 0; i < world->contacts.size(); ++i)
 		{
 			fiz::ContactInfo& contact = world->contacts[i];
@@ -796,6 +842,37 @@ private:
 		return min + random() * (max - min);
 	}
 
+	inline void setShaderModel(glm::mat4& model)
+	{
+		if (render_mode == RenderMode::RENDER_SHAPES)
+		{
+			shape_shader->use();
+			glUniformMatrix4fv(shape_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+		}
+		else
+		{
+			color_shader->use();
+			glUniformMatrix4fv(color_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+		}
+	}
+
+	inline glm::vec3 getShapeOffset(fiz::Shape* shape)
+	{
+		switch (shape->shape_type)
+		{
+		case fiz::SPHERE_TYPE:
+			return ((fiz::Sphere*)shape)->pos;
+		case fiz::BOX_TYPE:
+			return ((fiz::Box*)shape)->pos;
+		case fiz::CYLINDER_TYPE:
+			return ((fiz::Cylinder*)shape)->pos;
+		case fiz::CAPSULE_TYPE:
+			return ((fiz::Capsule*)shape)->pos;
+		default:
+			return glm::vec3(0.0f);
+		}
+	}
+
 	inline void setShaderScale(float x, float y, float z)
 	{
 		if (render_mode == RenderMode::RENDER_SHAPES)
@@ -0,0 +1,533 @@
+#pragma once
+
+#include <vector>
+
+#include "Body.h"
+#include "Joint.h"
+
+namespace fiz
+{
+	enum ArticulationJointType
+	{
+		ARTICULATION_FREE, // six degrees of freedom, only for the root link
+		ARTICULATION_REVOLUTE,
+		ARTICULATION_SPHERICAL
+	};
+
+	/**
+	6x6 spatial inertia in blocks, maps a motion (angular, linear) to a force (moment, force)
+	*/
+	struct SpatialInertia
+	{
+		glm::mat3 aa;
+		glm::mat3 al;
+		glm::mat3 la;
+		glm::mat3 ll;
+
+		SpatialInertia() : aa(0.0f), al(0.0f), la(0.0f), ll(0.0f)
+		{
+
+		}
+
+		/**
+		The inertia seen from a point that is r away from the point of this one, X^T I X
+		for the motion transform X that shifts a velocity by r
+		*/
+		SpatialInertia shift(const glm::vec3& r) const
+		{
+			glm::mat3 skew_r = skew(r);
+			SpatialInertia result;
+			result.la = la - ll * skew_r;
+			result.aa = aa - al * skew_r + skew_r * result.la;
+			result.al = al + skew_r * ll;
+			result.ll = ll;
+			return result;
+		}
+
+		/**
+		Solves I * (angular, linear) = (moment, force) with the Schur complement of the angular block
+		*/
+		void solve(const glm::vec3& moment, const glm::vec3& force, glm::vec3& angular, glm::vec3& linear) const
+		{
+			glm::mat3 aa_inv = glm::inverse(aa);
+			glm::mat3 schur = ll - la * aa_inv * al;
+			linear = glm::inverse(schur) * (force - la * (aa_inv * moment));
+			angular = aa_inv * (moment - al * linear);
+		}
+	};
+
+	/**
+	A body of an articulation and the joint to its parent, or to the world for the root
+	All vectors are in world coordinates unless they are marked local
+	*/
+	struct ArticulationLink
+	{
+		DynamicBody* body;
+		int parent; // index into Articulation::links, -1 for the root
+		ArticulationJointType type;
+
+		glm::vec3 parent_anchor; // joint point local to the parent, in world coordinates for the root
+		glm::vec3 child_anchor; // joint point local to the body
+		glm::vec3 axis; // revolute axis local to the parent, in world coordinates for the root
+
+		float angle; // revolute angle from the orientation the link was added in
+		glm::quat rest; // orientation relative to the parent at angle 0, spherical joints keep the current one here
+		glm::vec3 joint_vel; // the revolute speed is in x, spherical joints hold the angular velocity relative to the parent
+		glm::vec3 pseudo_joint_vel; // from the position correction of the contacts, only moves the link once
+
+		// velocities of the link from the joint velocities, the difference to the velocities
+		// of the body is what the world did to it since they were last written
+		glm::vec3 vel;
+		glm::vec3 angular_vel;
+		glm::vec3 pseudo_vel;
+		glm::vec3 pseudo_angular_vel;
+
+		// solver data of the current configuration
+		glm::mat3 s_angular; // motion of the link per unit joint velocity, one column per degree of freedom
+		glm::mat3 s_linear;
+		glm::vec3 r; // from the center of mass of the parent to the one of the link
+		SpatialInertia articulated; // inertia of the link and its subtree
+		SpatialInertia projected; // what the subtree passes on to the parent through the joint
+		glm::mat3 u_angular; // articulated inertia times the motion subspace
+		glm::mat3 u_linear;
+		glm::mat3 d_inv;
+		glm::vec3 bias_angular; // acceleration from the velocities alone
+		glm::vec3 bias_linear;
+		glm::vec3 force_angular; // bias force of the subtree
+		glm::vec3 force_linear;
+		glm::vec3 u;
+
+		// change of the velocities found by propagate
+		glm::vec3 d_joint_vel;
+		glm::vec3 d_vel;
+		glm::vec3 d_angular_vel;
+	};
+
+	/**
+	A tree of bodies simulated in reduced coordinates with Featherstone's articulated body algorithm
+	The links are ordinary dynamic bodies, so they collide through the usual contact pipeline. The impulses
+	the world gives them, from gravity, forces and contacts, are moved into joint space in O(n) and the
+	poses come from the joint angles, so the joints never drift apart however few iters are used
+	Add the links parent first, then add the articulation to the world
+	*/
+	class Articulation
+	{
+	public:
+		std::vector<ArticulationLink> links;
+
+		Articulation()
+		{
+			links.reserve(16);
+		}
+
+		/**
+		Adds a body with a joint at anchor to the link parent, -1 joins the root to the world
+		The joint is at rest in the current poses, axis is only used by revolute joints
+		Anchor and axis are in world coordinates
+		*/
+		unsigned int addLink(DynamicBody* body, int parent, ArticulationJointType type, glm::vec3 anchor, glm::vec3 axis = glm::vec3(0.0f, 0.0f, 1.0f))
+		{
+			ArticulationLink link = {};
+			link.body = body;
+			link.parent = parent;
+			link.type = type;
+			link.angle = 0.0f;
+			link.joint_vel = glm::vec3(0.0f);
+			link.pseudo_joint_vel = glm::vec3(0.0f);
+
+			// a BodyDef leaves the orientation as a zero quaternion, which composes to nothing
+			if (glm::dot(body->orientation, body->orientation) < 1e-6f)
+				body->orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			body->updateOrientationMat();
+			link.child_anchor = body->getLocalPos(anchor);
+
+			if (parent >= 0)
+			{
+				DynamicBody* parent_body = links[parent].body;
+				link.parent_anchor = parent_body->getLocalPos(anchor);
+				link.axis = glm::normalize(parent_body->getLocalVec(axis));
+				link.rest = glm::normalize(glm::inverse(parent_body->orientation) * body->orientation);
+
+				// the link starts moving with its parent
+				link.angular_vel = links[parent].angular_vel;
+				link.vel = links[parent].vel + glm::cross(links[parent].angular_vel, body->pos - parent_body->pos);
+			}
+			else
+			{
+				link.parent_anchor = anchor;
+				link.axis = glm::normalize(axis);
+				link.rest = body->orientation;
+				link.angular_vel = type == ARTICULATION_FREE ? body->angular_vel : glm::vec3(0.0f);
+				link.vel = type == ARTICULATION_FREE ? body->vel : glm::vec3(0.0f);
+			}
+			link.pseudo_vel = glm::vec3(0.0f);
+			link.pseudo_angular_vel = glm::vec3(0.0f);
+
+			links.push_back(link);
+			return links.size() - 1;
+		}
+
+		bool isAwake()
+		{
+			return !links.empty() && links[0].body->is_awake;
+		}
+
+		// called by the world when it moves its dynamic bodies
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			for (unsigned int i = 0; i < links.size(); ++i)
+				relocation.apply(links[i].body);
+		}
+
+		/**
+		Runs after the world has integrated the velocities of the links as free bodies
+		Their change is the impulse of gravity and the forces, which is applied to the
+		tree together with the velocity product terms of the joints
+		*/
+		void integrateVelocities(float dt)
+		{
+			if (!isAwake())
+			{
+				stop();
+				return;
+			}
+
+			updateFrames();
+			factor();
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				glm::mat3 inertia = getWorldInertia(link.body);
+				link.force_angular = glm::cross(link.angular_vel, inertia * link.angular_vel) * dt - inertia * (link.body->angular_vel - link.angular_vel);
+				link.force_linear = -link.body->mass * (link.body->vel - link.vel);
+			}
+			propagate(dt);
+			addVelocityChange(false);
+			updateVelocities();
+		}
+
+		/**
+		Runs after the contact solve, the velocity and pseudo velocity the contacts gave each link
+		as a free body are applied to the tree as impulses, with the factors of this substep
+		*/
+		void applyImpulses()
+		{
+			if (!isAwake())
+				return;
+
+			// most substeps no contact touches the links and both passes are skipped
+			bool touched = false;
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				link.force_angular = -(getWorldInertia(link.body) * (link.body->angular_vel - link.angular_vel));
+				link.force_linear = -link.body->mass * (link.body->vel - link.vel);
+				touched |= link.force_angular != glm::vec3(0.0f) || link.force_linear != glm::vec3(0.0f);
+			}
+			if (touched)
+			{
+				propagate(0.0f);
+				addVelocityChange(false);
+			}
+
+			bool pushed = false;
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				link.force_angular = -(getWorldInertia(link.body) * link.body->pseudo_angular_vel);
+				link.force_linear = -link.body->mass * link.body->pseudo_vel;
+				pushed |= link.force_angular != glm::vec3(0.0f) || link.force_linear != glm::vec3(0.0f);
+			}
+			if (pushed)
+			{
+				propagate(0.0f);
+				addVelocityChange(true);
+			}
+
+			if (touched || pushed)
+				updateVelocities();
+		}
+
+		/**
+		Runs after the world has moved the bodies, the links are put back where the joints say
+		*/
+		void integratePositions(float dt)
+		{
+			if (!isAwake())
+				return;
+
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				DynamicBody* body = link.body;
+				glm::quat parent_orientation = link.parent >= 0 ? links[link.parent].body->orientation : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+				// a free root was already moved by the world with the velocities written to it
+				if (link.type != ARTICULATION_FREE)
+				{
+					if (link.type == ARTICULATION_REVOLUTE)
+					{
+						link.angle += (link.joint_vel.x + link.pseudo_joint_vel.x) * dt;
+						body->orientation = glm::normalize(parent_orientation * glm::angleAxis(link.angle, link.axis) * link.rest);
+					}
+					else
+					{
+						// the relative angular velocity turns the relative orientation in the frame of the parent
+						glm::vec3 rotation = glm::inverse(parent_orientation) * ((link.joint_vel + link.pseudo_joint_vel) * dt);
+						link.rest = glm::normalize(getRotation(rotation) * link.rest);
+						body->orientation = glm::normalize(parent_orientation * link.rest);
+					}
+
+					body->updateOrientationMat();
+					glm::vec3 joint = link.parent >= 0 ? links[link.parent].body->getWorldPos(link.parent_anchor) : link.parent_anchor;
+					body->pos = joint - body->getWorldVec(link.child_anchor);
+				}
+
+				body->updateOrientationMat();
+				body->updateInverseInertiaWorld();
+				link.pseudo_joint_vel = glm::vec3(0.0f);
+				link.pseudo_vel = glm::vec3(0.0f);
+				link.pseudo_angular_vel = glm::vec3(0.0f);
+			}
+
+			// the joint velocities move the links differently in the new configuration
+			updateFrames();
+			updateVelocities();
+		}
+
+	private:
+		void stop()
+		{
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				links[i].joint_vel = glm::vec3(0.0f);
+				links[i].pseudo_joint_vel = glm::vec3(0.0f);
+				links[i].vel = glm::vec3(0.0f);
+				links[i].angular_vel = glm::vec3(0.0f);
+			}
+		}
+
+		glm::mat3 getWorldInertia(DynamicBody* body)
+		{
+			return body->orientation_mat * body->inertia * body->orientation_mat_inv;
+		}
+
+		glm::quat getRotation(const glm::vec3& rotation)
+		{
+			float angle = glm::length(rotation);
+			if (angle < 1e-9f)
+				return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			return glm::angleAxis(angle, rotation / angle);
+		}
+
+		// motion subspaces and offsets of the links in their current poses
+		void updateFrames()
+		{
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				if (link.type == ARTICULATION_FREE)
+				{
+					link.s_angular = glm::mat3(1.0f);
+					link.s_linear = glm::mat3(0.0f);
+					link.r = glm::vec3(0.0f);
+					continue;
+				}
+
+				DynamicBody* parent = link.parent >= 0 ? links[link.parent].body : nullptr;
+				glm::vec3 joint = parent != nullptr ? parent->getWorldPos(link.parent_anchor) : link.parent_anchor;
+				glm::vec3 arm = link.body->pos - joint;
+				link.r = parent != nullptr ? link.body->pos - parent->pos : glm::vec3(0.0f);
+
+				if (link.type == ARTICULATION_REVOLUTE)
+				{
+					glm::vec3 axis = parent != nullptr ? parent->getWorldVec(link.axis) : link.axis;
+					link.s_angular = glm::mat3(0.0f);
+					link.s_linear = glm::mat3(0.0f);
+					link.s_angular[0] = axis;
+					link.s_linear[0] = glm::cross(axis, arm);
+				}
+				else
+				{
+					link.s_angular = glm::mat3(1.0f);
+					link.s_linear = skew(-arm);
+				}
+			}
+		}
+
+		// link velocities from the joint velocities, root first
+		void updateVelocities()
+		{
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				if (link.type != ARTICULATION_FREE)
+				{
+					glm::vec3 joint_vel = link.type == ARTICULATION_REVOLUTE ? glm::vec3(link.joint_vel.x, 0.0f, 0.0f) : link.joint_vel;
+					glm::vec3 pseudo_joint_vel = link.type == ARTICULATION_REVOLUTE ? glm::vec3(link.pseudo_joint_vel.x, 0.0f, 0.0f) : link.pseudo_joint_vel;
+					link.angular_vel = link.s_angular * joint_vel;
+					link.vel = link.s_linear * joint_vel;
+					link.pseudo_angular_vel = link.s_angular * pseudo_joint_vel;
+					link.pseudo_vel = link.s_linear * pseudo_joint_vel;
+					if (link.parent >= 0)
+					{
+						ArticulationLink& parent = links[link.parent];
+						link.angular_vel += parent.angular_vel;
+						link.vel += parent.vel + glm::cross(parent.angular_vel, link.r);
+						link.pseudo_angular_vel += parent.pseudo_angular_vel;
+						link.pseudo_vel += parent.pseudo_vel + glm::cross(parent.pseudo_angular_vel, link.r);
+					}
+				}
+
+				link.body->vel = link.vel;
+				link.body->angular_vel = link.angular_vel;
+				link.body->pseudo_vel = link.pseudo_vel;
+				link.body->pseudo_angular_vel = link.pseudo_angular_vel;
+			}
+		}
+
+		/**
+		Articulated inertias from the leaves to the root, and the accelerations the velocities
+		alone give each link. Both only change with the configuration and velocities, so the
+		impulses of the contacts reuse them
+		*/
+		void factor()
+		{
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				link.articulated = SpatialInertia();
+				link.articulated.aa = getWorldInertia(link.body);
+				link.articulated.ll = glm::mat3(link.body->mass);
+
+				link.bias_angular = glm::vec3(0.0f);
+				link.bias_linear = glm::vec3(0.0f);
+				if (link.type == ARTICULATION_FREE)
+					continue;
+
+				// centripetal acceleration of the link about the joint and of the joint about the parent
+				glm::vec3 arm = link.body->pos - (link.parent >= 0 ? links[link.parent].body->getWorldPos(link.parent_anchor) : link.parent_anchor);
+				link.bias_linear = glm::cross(link.angular_vel, glm::cross(link.angular_vel, arm));
+				if (link.parent >= 0)
+				{
+					glm::vec3 parent_angular_vel = links[link.parent].angular_vel;
+					link.bias_linear += glm::cross(parent_angular_vel, glm::cross(parent_angular_vel, link.r - arm));
+
+					// a revolute axis is carried around by the parent
+					if (link.type == ARTICULATION_REVOLUTE)
+					{
+						link.bias_angular = glm::cross(parent_angular_vel, link.s_angular[0] * link.joint_vel.x);
+						link.bias_linear += glm::cross(link.bias_angular, arm);
+					}
+				}
+			}
+
+			for (int i = (int)links.size() - 1; i >= 0; --i)
+			{
+				ArticulationLink& link = links[i];
+				if (link.type == ARTICULATION_FREE)
+					continue;
+
+				SpatialInertia& inertia = link.articulated;
+				link.u_angular = inertia.aa * link.s_angular + inertia.al * link.s_linear;
+				link.u_linear = inertia.la * link.s_angular + inertia.ll * link.s_linear;
+				glm::mat3 d = glm::transpose(link.s_angular) * link.u_angular + glm::transpose(link.s_linear) * link.u_linear;
+
+				// the unused columns of a revolute joint are zero, their diagonal keeps d invertible
+				if (link.type == ARTICULATION_REVOLUTE)
+					d[1][1] = d[2][2] = 1.0f;
+
+				// long chains make d badly conditioned, the twist of a link is light next to the swing of its subtree,
+				// and the rounding of a lopsided inverse feeds energy into the twist, so the results are kept symmetric
+				d = (d + glm::transpose(d)) * 0.5f;
+				link.d_inv = glm::inverse(d);
+				link.d_inv = (link.d_inv + glm::transpose(link.d_inv)) * 0.5f;
+
+				glm::mat3 ud_angular = link.u_angular * link.d_inv;
+				glm::mat3 ud_linear = link.u_linear * link.d_inv;
+				link.projected.aa = inertia.aa - ud_angular * glm::transpose(link.u_angular);
+				link.projected.al = inertia.al - ud_angular * glm::transpose(link.u_linear);
+				link.projected.ll = inertia.ll - ud_linear * glm::transpose(link.u_linear);
+				link.projected.aa = (link.projected.aa + glm::transpose(link.projected.aa)) * 0.5f;
+				link.projected.ll = (link.projected.ll + glm::transpose(link.projected.ll)) * 0.5f;
+				link.projected.la = glm::transpose(link.projected.al);
+
+				if (link.parent >= 0)
+				{
+					SpatialInertia shifted = link.projected.shift(link.r);
+					SpatialInertia& parent = links[link.parent].articulated;
+					parent.aa += shifted.aa;
+					parent.al += shifted.al;
+					parent.la += shifted.la;
+					parent.ll += shifted.ll;
+				}
+			}
+		}
+
+		/**
+		Finds the change of the joint and link velocities from the bias forces set in each link,
+		with bias_scale times the velocity product accelerations, in one pass in and one out
+		*/
+		void propagate(float bias_scale)
+		{
+			for (int i = (int)links.size() - 1; i >= 0; --i)
+			{
+				ArticulationLink& link = links[i];
+				if (link.type == ARTICULATION_FREE)
+					continue;
+
+				link.u = -(link.force_angular * link.s_angular + link.force_linear * link.s_linear);
+				if (link.parent < 0)
+					continue;
+
+				glm::vec3 bias_angular = link.bias_angular * bias_scale;
+				glm::vec3 bias_linear = link.bias_linear * bias_scale;
+				glm::vec3 du = link.d_inv * link.u;
+				glm::vec3 force_angular = link.force_angular + link.projected.aa * bias_angular + link.projected.al * bias_linear + link.u_angular * du;
+				glm::vec3 force_linear = link.force_linear + link.projected.la * bias_angular + link.projected.ll * bias_linear + link.u_linear * du;
+
+				ArticulationLink& parent = links[link.parent];
+				parent.force_angular += force_angular + glm::cross(link.r, force_linear);
+				parent.force_linear += force_linear;
+			}
+
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				if (link.type == ARTICULATION_FREE)
+				{
+					link.articulated.solve(-link.force_angular, -link.force_linear, link.d_angular_vel, link.d_vel);
+					continue;
+				}
+
+				glm::vec3 angular = link.bias_angular * bias_scale;
+				glm::vec3 linear = link.bias_linear * bias_scale;
+				if (link.parent >= 0)
+				{
+					ArticulationLink& parent = links[link.parent];
+					angular += parent.d_angular_vel;
+					linear += parent.d_vel + glm::cross(parent.d_angular_vel, link.r);
+				}
+
+				link.d_joint_vel = link.d_inv * (link.u - angular * link.u_angular - linear * link.u_linear);
+				link.d_angular_vel = angular + link.s_angular * link.d_joint_vel;
+				link.d_vel = linear + link.s_linear * link.d_joint_vel;
+			}
+		}
+
+		void addVelocityChange(bool pseudo)
+		{
+			for (unsigned int i = 0; i < links.size(); ++i)
+			{
+				ArticulationLink& link = links[i];
+				if (link.type == ARTICULATION_FREE)
+				{
+					(pseudo ? link.pseudo_vel : link.vel) += link.d_vel;
+					(pseudo ? link.pseudo_angular_vel : link.angular_vel) += link.d_angular_vel;
+				}
+				else
+					(pseudo ? link.pseudo_joint_vel : link.joint_vel) += link.d_joint_vel;
+			}
+		}
+	};
+}
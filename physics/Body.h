@@ -4,8 +4,11 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include "geometry/Shape.h"
+#include "acceleration/BVH.h"
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 
 namespace fiz
 {
@@ -15,6 +18,36 @@ namespace fiz
 		DYNAMIC
 	};
 
+	struct ChildShape
+	{
+		AABB aabb; // bounds of the shape in body coordinates
+		unsigned int index; // index into the shapes of the body
+	};
+
+	/**
+	Decides which pairs of bodies collide
+	Bodies in the same nonzero group always collide if it is positive and never if it is negative,
+	otherwise each body must be in a category accepted by the mask of the other
+	*/
+	struct CollisionFilter
+	{
+		unsigned int category;
+		unsigned int mask;
+		int group;
+
+		CollisionFilter() : category(0x0001), mask(0xFFFFFFFF), group(0)
+		{
+
+		}
+
+		bool shouldCollide(const CollisionFilter& other) const
+		{
+			if (group != 0 && group == other.group)
+				return group > 0;
+			return (category & other.mask) != 0 && (other.category & mask) != 0;
+		}
+	};
+
 	class Body
 	{
 	public:
@@ -32,13 +65,30 @@ namespace fiz
 		AABB aabb;
 		std::vector<Shape*> shapes;
 
+		// compound bodies cull pairs of child shapes with a small tree in body coordinates
+		std::vector<ChildShape> children;
+		BVH<ChildShape> child_bvh;
+
+		// bounds of all shapes in body coordinates as a box rounded by a margin and clipped
+		// to a sphere, so the AABB can be updated from the orientation without visiting the shapes
+		glm::vec3 local_center;
+		glm::vec3 local_extent;
+		float local_margin;
+		float local_radius;
+
+		// sensors report overlaps as events and are never solved
+		bool is_sensor;
+
+		CollisionFilter filter;
+		std::vector<Body*> jointed_bodies; // bodies connected by joints that don't collide with this body
+
 		int user_data;
 
 		Body() : Body(glm::vec3(0.0f))
 		{
 
 		}
-		Body(glm::vec3 pos) : pos(pos), orientation(0.0f, 0.0f, 0.0f, 0.0f), orientation_mat(1.0f), orientation_mat_inv(1.0f), friction(0.2f), restitution(0.2f), user_data(0)
+		Body(glm::vec3 pos) : pos(pos), orientation(0.0f, 0.0f, 0.0f, 0.0f), orientation_mat(1.0f), orientation_mat_inv(1.0f), friction(0.2f), restitution(0.2f), child_bvh(&children), local_center(0.0f), local_extent(0.0f), local_margin(0.0f), local_radius(0.0f), is_sensor(false), user_data(0)
 		{
 
 		}
@@ -46,6 +96,118 @@ namespace fiz
 		void addShape(Shape* shape)
 		{
 			shapes.push_back(shape);
+
+			ChildShape child;
+			glm::vec3 origin = glm::vec3(0.0f);
+			glm::mat3 identity = glm::mat3(1.0f);
+			shape->setAABB(&child.aabb, origin, identity);
+			child.index = shapes.size() - 1;
+			children.push_back(child);
+
+			if (children.size() > 1)
+			{
+				child_bvh.primitives = &children;
+				child_bvh.createBVH();
+			}
+
+			updateLocalBounds();
+		}
+
+		// after the shapes have moved in body coordinates
+		void updateChildBounds()
+		{
+			glm::vec3 origin = glm::vec3(0.0f);
+			glm::mat3 identity = glm::mat3(1.0f);
+			for (unsigned int i = 0; i < children.size(); ++i)
+				shapes[children[i].index]->setAABB(&children[i].aabb, origin, identity);
+
+			if (children.size() > 1)
+			{
+				child_bvh.primitives = &children;
+				child_bvh.createBVH();
+			}
+
+			updateLocalBounds();
+		}
+
+		void updateLocalBounds()
+		{
+			AABB bounds = children[0].aabb;
+			for (unsigned int i = 1; i < children.size(); ++i)
+				bounds.combine(children[i].aabb);
+			local_center = (bounds.min + bounds.max) * 0.5f;
+			local_extent = (bounds.max - bounds.min) * 0.5f;
+			local_margin = 0.0f;
+			local_radius = glm::length(local_extent);
+
+			if (shapes.size() > 1)
+				return;
+
+			// round shapes are a point or a segment along z with a radius around it
+			if (shapes[0]->shape_type == SPHERE_TYPE)
+			{
+				Sphere* sphere = (Sphere*)shapes[0];
+				local_center = sphere->pos;
+				local_extent = glm::vec3(0.0f);
+				local_margin = sphere->rad;
+			}
+			else if (shapes[0]->shape_type == CAPSULE_TYPE)
+			{
+				Capsule* capsule = (Capsule*)shapes[0];
+				local_center = capsule->pos;
+				local_extent = glm::vec3(0.0f, 0.0f, capsule->height);
+				local_margin = capsule->rad;
+			}
+			else if (shapes[0]->shape_type == CYLINDER_TYPE)
+			{
+				Cylinder* cylinder = (Cylinder*)shapes[0];
+				local_center = cylinder->pos;
+				local_extent = glm::vec3(0.0f, 0.0f, cylinder->height);
+				local_margin = cylinder->rad;
+			}
+			else if (shapes[0]->shape_type == POLYHEDRON_TYPE)
+			{
+				// the bounds of a spinning polyhedron grow quickly, the sphere around its vertices is often smaller
+				Polyhedron* polyhedron = (Polyhedron*)shapes[0];
+				local_radius = 0.0f;
+				for (unsigned int i = 0; i < polyhedron->vertices.size(); ++i)
+					local_radius = glm::max(local_radius, glm::length(polyhedron->vertices[i] - local_center));
+			}
+		}
+
+		/**
+		Whether pairs with the other body reach the narrow phase
+		Checked before the bounds so filtered pairs cost a few bit operations
+		*/
+		bool shouldCollide(Body* other)
+		{
+			return filter.shouldCollide(other->filter) && !isJointedTo(other);
+		}
+
+		bool isJointedTo(Body* other)
+		{
+			for (unsigned int i = 0; i < jointed_bodies.size(); ++i)
+			{
+				if (jointed_bodies[i] == other)
+					return true;
+			}
+			return false;
+		}
+
+		/**
+		Finds the children whose bounds intersect an AABB
+		The AABB is in body coordinates, hits are indices into children
+		*/
+		void traverseChildren(AABB& local_aabb, std::vector<int>& hits)
+		{
+			if (children.size() == 1)
+			{
+				hits.push_back(0);
+				return;
+			}
+
+			child_bvh.primitives = &children; // the body may have been copied since the tree was built
+			child_bvh.traverse(local_aabb, hits);
 		}
 
 		void updateOrientationMat()
@@ -65,6 +227,25 @@ namespace fiz
 			}
 		}
 
+		/**
+		Updates the AABB from the local bounds as min(|R| * local extent, local radius) + local margin
+		Doesn't visit the shapes. It is exact for boxes, spheres and capsules,
+		but looser than updateAABB for rotated polyhedra and compound bodies
+		*/
+		void updateLocalAABB()
+		{
+			glm::vec3 center = orientation_mat * local_center + pos;
+			glm::vec3 extent;
+			for (unsigned int i = 0; i < 3; ++i)
+			{
+				extent[i] = glm::min(glm::abs(orientation_mat[0][i]) * local_extent.x +
+									 glm::abs(orientation_mat[1][i]) * local_extent.y +
+									 glm::abs(orientation_mat[2][i]) * local_extent.z, local_radius) + local_margin;
+			}
+			aabb.min = center - extent;
+			aabb.max = center + extent;
+		}
+
 		glm::vec3 getWorldPos(glm::vec3 pos)
 		{
 			return orientation_mat * pos + this->pos;
@@ -89,13 +270,11 @@ namespace fiz
 	class StaticBody : public Body
 	{
 	public:
-		bool is_sensor;
-
 		StaticBody() : StaticBody(glm::vec3(0.0f))
 		{
 			type = STATIC;
 		}
-		StaticBody(glm::vec3 pos) : Body(pos), is_sensor(false)
+		StaticBody(glm::vec3 pos) : Body(pos)
 		{
 			type = STATIC;
 		}
@@ -108,11 +287,16 @@ namespace fiz
 
 		glm::vec3 angular_vel;
 
+		// velocities that only correct penetration, they move the body once in integratePosition and are dropped
+		glm::vec3 pseudo_vel;
+		glm::vec3 pseudo_angular_vel;
+
 		float linear_damping;
 		float angular_damping;
 
 		float mass;
 		glm::vec3 centroid;
+		std::vector<std::shared_ptr<Shape>> owned_shapes; // copies of the shapes moved to put the center of mass at pos
 
 		glm::mat3 inertia;
 		glm::mat3 inertia_inv;
@@ -124,15 +308,17 @@ namespace fiz
 		glm::vec3 torques; // world coordinates
 
 		unsigned int still_frames;
+		unsigned int slot; // index of the handle slot of the body in its world
 
 		bool rotation_locked;
 		bool is_awake;
+		bool ccd;
 
 		DynamicBody() : DynamicBody(glm::vec3(0.0f, 0.0f, 0.0f))
 		{
 			type = DYNAMIC;
 		}
-		DynamicBody(glm::vec3 pos) : Body(pos), vel(0.0f), angular_vel(0.0f), linear_damping(1.0f), angular_damping(1.0f), mass(0.0f), centroid(0.0f), inertia(1.0f), inertia_inv(1.0f), inertia_inv_world(1.0f), density(1.0f), forces(0.0f), torques(0.0f), still_frames(0), rotation_locked(false), is_awake(true)
+		DynamicBody(glm::vec3 pos) : Body(pos), vel(0.0f), angular_vel(0.0f), pseudo_vel(0.0f), pseudo_angular_vel(0.0f), linear_damping(1.0f), angular_damping(1.0f), mass(0.0f), centroid(0.0f), inertia(1.0f), inertia_inv(1.0f), inertia_inv_world(1.0f), density(1.0f), forces(0.0f), torques(0.0f), still_frames(0), slot(0), rotation_locked(false), is_awake(true), ccd(false)
 		{
 			type = DYNAMIC;
 		}
@@ -156,6 +342,23 @@ namespace fiz
 			}
 			centroid /= mass;
 
+			// the body moves and rotates about pos, so it works on copies of its shapes moved to put the
+			// center of mass there, and pos moves the other way so the shapes stay where they were placed.
+			// The shapes themselves may be shared with other bodies and are left alone
+			if (centroid != glm::vec3(0.0f) && canCloneShapes())
+			{
+				for (unsigned int i = 0; i < shapes.size(); ++i)
+				{
+					owned_shapes.push_back(std::shared_ptr<Shape>(shapes[i]->clone()));
+					shapes[i] = owned_shapes.back().get();
+					shapes[i]->translate(-centroid);
+					shapes[i]->computeMassProperties();
+				}
+				pos += glm::mat3_cast(orientation) * centroid;
+				centroid = glm::vec3(0.0f);
+				updateChildBounds();
+			}
+
 			// update inertia
 			float Ixx = 0, Iyy = 0, Izz = 0;
 			float Ixy = 0, Ixz = 0, Iyz = 0;
@@ -166,12 +369,13 @@ namespace fiz
 				glm::vec3 loc_inertia = shapes[i]->local_inertia;
 				glm::vec3 loc_products = shapes[i]->local_products;
 
-				Ixx += loc_inertia.x;// +shape_mass * (cg.y * cg.y + cg.z * cg.z);
-				Iyy += loc_inertia.y;// +shape_mass * (cg.x * cg.x + cg.z * cg.z);
-				Izz += loc_inertia.z;// +shape_mass * (cg.x * cg.x + cg.y * cg.y);
-				Ixy += loc_products.x;// shape_mass* cg.x* cg.y;
-				Ixz += loc_products.y;// shape_mass* cg.x* cg.z;
-				Iyz += loc_products.z;// shape_mass* cg.y* cg.z;
+				// parallel axis theorem moves each child inertia to the centroid of the body
+				Ixx += loc_inertia.x + shape_mass * (cg.y * cg.y + cg.z * cg.z);
+				Iyy += loc_inertia.y + shape_mass * (cg.x * cg.x + cg.z * cg.z);
+				Izz += loc_inertia.z + shape_mass * (cg.x * cg.x + cg.y * cg.y);
+				Ixy += loc_products.x + shape_mass * cg.x * cg.y;
+				Ixz += loc_products.y + shape_mass * cg.x * cg.z;
+				Iyz += loc_products.z + shape_mass * cg.y * cg.z;
 			}
 
 			inertia[0][0] = Ixx;
@@ -187,22 +391,56 @@ namespace fiz
 			inertia_inv = glm::inverse(inertia);
 		}
 
+		// the convex shapes come first in ShapeType, the others are only used by static bodies
+		bool canCloneShapes()
+		{
+			for (unsigned int i = 0; i < shapes.size(); ++i)
+			{
+				if (shapes[i]->shape_type > POLYHEDRON_TYPE)
+					return false;
+			}
+			return true;
+		}
+
 		void updateInverseInertiaWorld()
 		{
 			// definitely needs optimization
 			inertia_inv_world = glm::transpose(orientation_mat_inv) * inertia_inv * orientation_mat_inv;
 		}
 
+		/**
+		Counts the substeps the body has been still for
+		The world puts a whole island to sleep once all of its bodies are still
+		*/
 		void updateSleep(float dt)
 		{
+			if (!is_awake)
+				return;
+
 			float motion = glm::max(glm::dot(vel, vel), glm::dot(angular_vel, angular_vel));
 			if (motion < 0.005f)
 				still_frames++;
 			else
 				still_frames = 0;
+		}
 
-			if (still_frames >= 80)
-				is_awake = false;
+		bool isStill()
+		{
+			return still_frames >= 80;
+		}
+
+		/**
+		Distance from the body origin to the furthest point of its shapes
+		*/
+		float getBoundingRadius()
+		{
+			float radius = 0.0f;
+			for (unsigned int i = 0; i < children.size(); ++i)
+			{
+				glm::vec3 corner = glm::max(glm::abs(children[i].aabb.min), glm::abs(children[i].aabb.max));
+				radius = glm::max(radius, glm::length(corner));
+			}
+			return radius;
 		}
 
 		void setAwake()
@@ -211,7 +449,26 @@ namespace fiz
 			is_awake = true;
 		}
 
+		void setAsleep()
+		{
+			is_awake = false;
+			vel = glm::vec3(0.0f);
+			angular_vel = glm::vec3(0.0f);
+			pseudo_vel = glm::vec3(0.0f);
+			pseudo_angular_vel = glm::vec3(0.0f);
+		}
+
 		void update(float dt)
+		{
+			integrateVelocity(dt);
+			integratePosition(dt);
+		}
+
+		/**
+		Applies the forces and damping to the velocities
+		The contact solver runs between this and integratePosition
+		*/
+		void integrateVelocity(float dt)
 		{
 			if (!is_awake)
 				return;
@@ -223,7 +480,6 @@ namespace fiz
 			glm::vec3 acceleration = forces / mass;
 			vel += acceleration * dt;
 			vel *= linear_damping;
-			pos += vel * dt;
 
 			// update torques
 			if (!rotation_locked)
@@ -231,7 +487,23 @@ namespace fiz
 				glm::vec3 angular_acceleration = inertia_inv_world * torques;
 				angular_vel += angular_acceleration * dt;
 				angular_vel *= angular_damping;
-				glm::vec3 d_avel = angular_vel * dt;
+			}
+
+			resetForces();
+		}
+
+		void integratePosition(float dt)
+		{
+			if (!is_awake)
+				return;
+
+			pos += (vel + pseudo_vel) * dt;
+			pseudo_vel = glm::vec3(0.0f);
+
+			if (!rotation_locked)
+			{
+				glm::vec3 d_avel = (angular_vel + pseudo_angular_vel) * dt;
+				pseudo_angular_vel = glm::vec3(0.0f);
 				float angle = glm::sin(0.5f * glm::length(d_avel));
 				if (angle != 0.0f)
 				{
@@ -246,10 +518,6 @@ namespace fiz
 				updateOrientationMat();
 				updateInverseInertiaWorld();
 			}
-
-			updateAABB();
-
-			resetForces();
 		}
 
 		glm::vec3 getVelocityWorld(glm::vec3 pos)
@@ -322,4 +590,54 @@ namespace fiz
 		}
 
 	};
+	/**
+	Refers to a dynamic body of a world, unlike a pointer it stays valid when the world grows
+	or reorders its bodies, and resolves to null once the body is destroyed
+	*/
+	struct BodyHandle
+	{
+		unsigned int slot;
+		unsigned int generation;
+	};
+
+	struct BodySlot
+	{
+		unsigned int body; // index into the dynamic bodies of the world
+		unsigned int generation; // bumped when the body is destroyed so old handles stop resolving
+	};
+
+	/**
+	Count bodies that were moved from one place in memory to another
+	Applied to every pointer the world keeps when it moves its dynamic bodies
+	*/
+	struct BodyRelocation
+	{
+		DynamicBody* from;
+		unsigned int count;
+		DynamicBody* to;
+
+		// index of the body in the old storage or count, addresses are compared as integers since most bodies are in other arrays and the moved ones may no longer be readable
+		unsigned int findIndex(const void* body, const void* begin) const
+		{
+			std::uintptr_t address = (std::uintptr_t)body;
+			std::uintptr_t first = (std::uintptr_t)begin;
+			if (address < first || address - first >= count * sizeof(DynamicBody))
+				return count;
+			return (unsigned int)((address - first) / sizeof(DynamicBody));
+		}
+
+		void apply(DynamicBody*& body) const
+		{
+			unsigned int index = findIndex(body, from);
+			if (index < count)
+				body = to + index;
+		}
+
+		void apply(Body*& body) const
+		{
+			unsigned int index = findIndex(body, static_cast<Body*>(from));
+			if (index < count)
+				body = to + index;
+		}
+	};
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <vector>
+
 #include "geometry/Shape.h"
 
 namespace fiz
@@ -11,7 +13,7 @@ namespace fiz
 	{
 		BodyType type;
 
-		glm::vec3 pos;
+		glm::vec3 pos; // origin of the shapes, dynamic bodies move their pos to the center of mass
 		glm::vec3 vel;
 
 		glm::quat orientation;
@@ -27,11 +29,16 @@ namespace fiz
 
 		bool rotation_locked;
 
-		bool is_sensor;
+		bool is_sensor; // reports overlaps as sensor events instead of colliding
+
+		CollisionFilter filter;
+
+		bool ccd; // continuous collision with static bodies for fast bodies
 
 		Shape* shape;
+		std::vector<Shape*> child_shapes; // additional shapes for compound bodies
 
-		BodyDef() : type(BodyType::DYNAMIC), pos(0.0f), vel(0.0f), orientation(0.0f, 0.0f, 0.0f, 0.0f), angular_vel(0.0f), linear_damping(1.0f), angular_damping(1.0f), density(1.0f), friction(0.2f), restitution(0.2f), rotation_locked(false), is_sensor(false), shape(nullptr)
+		BodyDef() : type(BodyType::DYNAMIC), pos(0.0f), vel(0.0f), orientation(0.0f, 0.0f, 0.0f, 0.0f), angular_vel(0.0f), linear_damping(1.0f), angular_damping(1.0f), density(1.0f), friction(0.2f), restitution(0.2f), rotation_locked(false), is_sensor(false), ccd(false), shape(nullptr)
 		{
 
 		}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FIZ_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "Body.h"
+
+namespace fiz
+{
+	/**
+	The bounds and collision filters of the dynamic bodies as an array for each coordinate
+	The pair test streams these four at a time instead of visiting the bodies,
+	which are several cache lines each
+	*/
+	struct BoundsBatch
+	{
+		std::vector<float> min_x;
+		std::vector<float> min_y;
+		std::vector<float> min_z;
+		std::vector<float> max_x;
+		std::vector<float> max_y;
+		std::vector<float> max_z;
+		std::vector<unsigned int> categories;
+		std::vector<unsigned int> masks;
+		std::vector<int> groups;
+		unsigned int count;
+
+		BoundsBatch() : count(0)
+		{
+
+		}
+
+		// sensors are gathered with an empty filter, they never take part in the pair test
+		void gather(std::vector<AABB>& bounds, std::vector<DynamicBody>& bodies)
+		{
+			count = bounds.size();
+
+			// padded to a multiple of four with bounds that overlap nothing and filters that accept nothing
+			unsigned int padded = (count + 3) & ~3u;
+			min_x.assign(padded, FLT_MAX);
+			min_y.assign(padded, FLT_MAX);
+			min_z.assign(padded, FLT_MAX);
+			max_x.assign(padded, -FLT_MAX);
+			max_y.assign(padded, -FLT_MAX);
+			max_z.assign(padded, -FLT_MAX);
+			categories.assign(padded, 0);
+			masks.assign(padded, 0);
+			groups.assign(padded, 0);
+
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				min_x[i] = bounds[i].min.x;
+				min_y[i] = bounds[i].min.y;
+				min_z[i] = bounds[i].min.z;
+				max_x[i] = bounds[i].max.x;
+				max_y[i] = bounds[i].max.y;
+				max_z[i] = bounds[i].max.z;
+
+				if (bodies[i].is_sensor)
+					continue;
+				categories[i] = bodies[i].filter.category;
+				masks[i] = bodies[i].filter.mask;
+				groups[i] = bodies[i].filter.group;
+			}
+		}
+
+		/**
+		Finds the gathered bounds that intersect the AABB and whose filters collide with the filter,
+		in the order they were gathered. The filters are tested first so filtered pairs skip the bounds
+		*/
+		void query(const AABB& aabb, const CollisionFilter& filter, std::vector<unsigned int>& hits)
+		{
+#ifdef FIZ_SSE2
+			const unsigned int padded = min_x.size();
+			const __m128 x0 = _mm_set1_ps(aabb.min.x);
+			const __m128 y0 = _mm_set1_ps(aabb.min.y);
+			const __m128 z0 = _mm_set1_ps(aabb.min.z);
+			const __m128 x1 = _mm_set1_ps(aabb.max.x);
+			const __m128 y1 = _mm_set1_ps(aabb.max.y);
+			const __m128 z1 = _mm_set1_ps(aabb.max.z);
+
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i category = _mm_set1_epi32((int)filter.category);
+			const __m128i mask = _mm_set1_epi32((int)filter.mask);
+			const __m128i group = _mm_set1_epi32(filter.group);
+
+			for (unsigned int i = 0; i < padded; i += 4)
+			{
+				// lanes where either category misses the other mask
+				__m128i rejected = _mm_or_si128(
+					_mm_cmpeq_epi32(_mm_and_si128(category, _mm_loadu_si128((const __m128i*)&masks[i])), zero),
+					_mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i*)&categories[i]), mask), zero));
+				if (filter.group != 0)
+				{
+					__m128i same = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&groups[i]), group);
+					rejected = filter.group > 0 ? _mm_andnot_si128(same, rejected) : _mm_or_si128(same, rejected);
+				}
+				int accepted = ~_mm_movemask_ps(_mm_castsi128_ps(rejected)) & 0xF;
+				if (accepted == 0)
+					continue;
+
+				__m128 x = _mm_and_ps(_mm_cmpgt_ps(x1, _mm_loadu_ps(&min_x[i])), _mm_cmplt_ps(x0, _mm_loadu_ps(&max_x[i])));
+				__m128 y = _mm_and_ps(_mm_cmpgt_ps(y1, _mm_loadu_ps(&min_y[i])), _mm_cmplt_ps(y0, _mm_loadu_ps(&max_y[i])));
+				__m128 z = _mm_and_ps(_mm_cmpgt_ps(z1, _mm_loadu_ps(&min_z[i])), _mm_cmplt_ps(z0, _mm_loadu_ps(&max_z[i])));
+				int overlap = _mm_movemask_ps(_mm_and_ps(x, _mm_and_ps(y, z))) & accepted;
+				if (overlap == 0)
+					continue;
+
+				for (unsigned int j = 0; j < 4; ++j)
+				{
+					if (overlap & (1 << j))
+						hits.push_back(i + j);
+				}
+			}
+#else
+			CollisionFilter other;
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				other.category = categories[i];
+				other.mask = masks[i];
+				other.group = groups[i];
+				if (!filter.shouldCollide(other))
+					continue;
+
+				if (aabb.max.x > min_x[i] && aabb.min.x < max_x[i] &&
+					aabb.max.y > min_y[i] && aabb.min.y < max_y[i] &&
+					aabb.max.z > min_z[i] && aabb.min.z < max_z[i])
+					hits.push_back(i);
+			}
+#endif
+		}
+	};
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace fiz
+{
+	/**
+	Greedy coloring of constraints so that no two constraints of a color share a dynamic body
+	The constraints of a color can then be solved at the same time on different threads
+	Static bodies and the ground are never written by the solver, so they don't conflict
+	Constraints that find no free color, or don't know their bodies, are left to an overflow set
+	*/
+	class GraphColoring
+	{
+	public:
+		static const unsigned int max_colors = 32;
+		static const unsigned int no_body = (unsigned int)-1;
+
+		std::vector<unsigned int> constraints; // grouped by color, the overflow set is last
+		unsigned int num_colors;
+
+		GraphColoring() : num_colors(0)
+		{
+			for (unsigned int i = 0; i <= max_colors + 1; ++i)
+				color_start[i] = 0;
+		}
+
+		void reset(unsigned int num_bodies)
+		{
+			body_colors.assign(num_bodies, 0);
+			added.clear();
+			num_colors = 0;
+		}
+
+		/**
+		Adds a constraint between two dynamic bodies, either can be no_body
+		*/
+		void add(unsigned int constraint, unsigned int body_a, unsigned int body_b)
+		{
+			uint32_t used = 0;
+			if (body_a != no_body)
+				used |= body_colors[body_a];
+			if (body_b != no_body)
+				used |= body_colors[body_b];
+
+			unsigned int color = 0;
+			while (color < max_colors && (used & (1u << color)))
+				++color;
+
+			if (color < max_colors)
+			{
+				if (body_a != no_body)
+					body_colors[body_a] |= 1u << color;
+				if (body_b != no_body)
+					body_colors[body_b] |= 1u << color;
+				if (color >= num_colors)
+					num_colors = color + 1;
+			}
+			added.push_back({ constraint, color });
+		}
+
+		// adds a constraint that may touch any body
+		void addOverflow(unsigned int constraint)
+		{
+			added.push_back({ constraint, max_colors });
+		}
+
+		/**
+		Groups the added constraints by color, keeping the order they were added in within each color
+		*/
+		void finish()
+		{
+			for (unsigned int i = 0; i <= max_colors + 1; ++i)
+				color_start[i] = 0;
+			for (unsigned int i = 0; i < added.size(); ++i)
+				color_start[added[i].color + 1]++;
+			for (unsigned int i = 0; i <= max_colors; ++i)
+				color_start[i + 1] += color_start[i];
+
+			unsigned int next[max_colors + 1];
+			for (unsigned int i = 0; i <= max_colors; ++i)
+				next[i] = color_start[i];
+
+			constraints.resize(added.size());
+			for (unsigned int i = 0; i < added.size(); ++i)
+				constraints[next[added[i].color]++] = added[i].constraint;
+		}
+
+		unsigned int getColorStart(unsigned int color) { return color_start[color]; }
+		unsigned int getColorSize(unsigned int color) { return color_start[color + 1] - color_start[color]; }
+		unsigned int getOverflowStart() { return color_start[max_colors]; }
+		unsigned int getOverflowSize() { return color_start[max_colors + 1] - color_start[max_colors]; }
+
+	private:
+		struct ColoredConstraint
+		{
+			unsigned int constraint;
+			unsigned int color; // max_colors for the overflow set
+		};
+
+		std::vector<uint32_t> body_colors; // bit set of the colors used by each body
+		std::vector<ColoredConstraint> added;
+		unsigned int color_start[max_colors + 2];
+	};
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+namespace fiz
+{
+	/**
+	Union-find over the dynamic bodies, joined by their contacts and joints
+	Bodies with the same root are in the same island
+	*/
+	struct IslandSet
+	{
+		std::vector<unsigned int> parent;
+		std::vector<unsigned int> rank;
+
+		void reset(unsigned int count)
+		{
+			parent.resize(count);
+			rank.assign(count, 0);
+			for (unsigned int i = 0; i < count; ++i)
+				parent[i] = i;
+		}
+
+		unsigned int find(unsigned int i)
+		{
+			// path halving keeps the trees flat without recursion
+			while (parent[i] != i)
+			{
+				parent[i] = parent[parent[i]];
+				i = parent[i];
+			}
+			return i;
+		}
+
+		void join(unsigned int a, unsigned int b)
+		{
+			a = find(a);
+			b = find(b);
+			if (a == b)
+				return;
+
+			if (rank[a] < rank[b])
+				std::swap(a, b);
+			parent[b] = a;
+			if (rank[a] == rank[b])
+				rank[a]++;
+		}
+	};
+
+	/**
+	A group of dynamic bodies that touch or are jointed, directly or through other bodies
+	Islands sleep and wake as a unit
+	*/
+	struct Island
+	{
+		unsigned int start; // first index into World::island_bodies
+		unsigned int count;
+		unsigned int manifold_start; // first index into World::island_manifolds
+		unsigned int manifold_count;
+		unsigned int joint_start; // first index into World::island_joints
+		unsigned int joint_count;
+		bool is_awake;
+
+		// the islands are ordered and batched by the number of constraints they solve
+		unsigned int getConstraintCount()
+		{
+			return manifold_count + joint_count;
+		}
+	};
+
+	/**
+	A range of World::island_order solved by one task
+	Islands share no bodies, so batches can run on any thread in any order
+	*/
+	struct IslandBatch
+	{
+		unsigned int start;
+		unsigned int count;
+	};
+}
@@ -1,15 +1,266 @@
 #pragma once
 
+#include <cfloat>
+
 #include "Body.h"
 #include "geometry/Collision.h"
 #include "acceleration/BVH.h"
 
 namespace fiz
 {
+	// fraction of the position error of a joint corrected in each substep
+	inline float joint_baumgarte = 0.2f;
+
+	inline float getJointInverseMass(DynamicBody* body)
+	{
+		return body != nullptr ? 1.0f / body->mass : 0.0f;
+	}
+
+	inline glm::mat3 getJointInverseInertia(DynamicBody* body)
+	{
+		return body != nullptr && !body->rotation_locked ? body->inertia_inv_world : glm::mat3(0.0f);
+	}
+
+	// matrix of the cross product, skew(v) * x == cross(v, x)
+	inline glm::mat3 skew(const glm::vec3& v)
+	{
+		return glm::mat3(0.0f, v.z, -v.y, -v.z, 0.0f, v.x, v.y, -v.x, 0.0f);
+	}
+
+	/**
+	Three rows that keep a point of b on a point of a, solved together with a 3x3 effective mass
+	a is null for a point fixed in the world
+	*/
+	struct PointRows
+	{
+		glm::vec3 r_a; // from each center of mass to its point
+		glm::vec3 r_b;
+		glm::mat3 mass;
+		glm::vec3 bias;
+		glm::vec3 impulse; // accumulated over the iterations and kept to warm start the next substep
+
+		PointRows() : r_a(0.0f), r_b(0.0f), mass(1.0f), bias(0.0f), impulse(0.0f)
+		{
+
+		}
+
+		void prestep(DynamicBody* a, DynamicBody* b, const glm::vec3& world_a, const glm::vec3& world_b, float dt)
+		{
+			r_a = a != nullptr ? world_a - a->pos : glm::vec3(0.0f);
+			r_b = world_b - b->pos;
+
+			// change in velocity of the point per unit impulse, m^-1 - [r] I^-1 [r] for each body
+			glm::mat3 k(getJointInverseMass(a) + getJointInverseMass(b));
+			k -= skew(r_b) * getJointInverseInertia(b) * skew(r_b);
+			if (a != nullptr)
+				k -= skew(r_a) * getJointInverseInertia(a) * skew(r_a);
+			mass = glm::inverse(k);
+
+			bias = (world_a - world_b) * (joint_baumgarte / dt);
+		}
+
+		void warmStart(DynamicBody* a, DynamicBody* b)
+		{
+			applyImpulse(a, b, impulse);
+		}
+
+		void solve(DynamicBody* a, DynamicBody* b)
+		{
+			glm::vec3 vel = b->vel + glm::cross(b->angular_vel, r_b);
+			if (a != nullptr)
+				vel -= a->vel + glm::cross(a->angular_vel, r_a);
+
+			glm::vec3 lambda = mass * (bias - vel);
+			impulse += lambda;
+			applyImpulse(a, b, lambda);
+		}
+
+	private:
+		void applyImpulse(DynamicBody* a, DynamicBody* b, const glm::vec3& j)
+		{
+			b->vel += j / b->mass;
+			b->angular_vel += getJointInverseInertia(b) * glm::cross(r_b, j);
+			if (a != nullptr)
+			{
+				a->vel -= j / a->mass;
+				a->angular_vel -= getJointInverseInertia(a) * glm::cross(r_a, j);
+			}
+		}
+	};
+
+	/**
+	One row on the angular velocity of b relative to a about an axis
+	The accumulated impulse is clamped to [lower, upper], so the same row
+	holds an axis fixed or only pushes one way for a limit
+	*/
+	struct AngularRow
+	{
+		glm::vec3 axis;
+		float mass;
+		float bias;
+		float impulse;
+		float lower;
+		float upper;
+
+		AngularRow() : axis(0.0f, 0.0f, 1.0f), mass(0.0f), bias(0.0f), impulse(0.0f), lower(-FLT_MAX), upper(FLT_MAX)
+		{
+
+		}
+
+		void prestep(DynamicBody* a, DynamicBody* b, const glm::vec3& axis, float bias)
+		{
+			this->axis = axis;
+			this->bias = bias;
+			float k = glm::dot(axis, (getJointInverseInertia(a) + getJointInverseInertia(b)) * axis);
+			mass = k > 0.0f ? 1.0f / k : 0.0f;
+		}
+
+		void warmStart(DynamicBody* a, DynamicBody* b)
+		{
+			applyImpulse(a, b, impulse);
+		}
+
+		void solve(DynamicBody* a, DynamicBody* b)
+		{
+			float vel = glm::dot(b->angular_vel, axis);
+			if (a != nullptr)
+				vel -= glm::dot(a->angular_vel, axis);
+
+			float old_impulse = impulse;
+			impulse = glm::clamp(impulse + mass * (bias - vel), lower, upper);
+			applyImpulse(a, b, impulse - old_impulse);
+		}
+
+	private:
+		void applyImpulse(DynamicBody* a, DynamicBody* b, float j)
+		{
+			b->angular_vel += getJointInverseInertia(b) * (axis * j);
+			if (a != nullptr)
+				a->angular_vel -= getJointInverseInertia(a) * (axis * j);
+		}
+	};
+
+	/**
+	The rows of a hinge, b keeps its point on a and turns about the axis of a only
+	With the limit enabled the angle between the reference vectors of a and b, measured
+	about the axis of a, is kept between lower_angle and upper_angle
+	*/
+	struct HingeRows
+	{
+		PointRows point;
+		AngularRow swing[2]; // keep the axis of b lined up with the axis of a
+		AngularRow lower_limit;
+		AngularRow upper_limit;
+		bool enable_limit;
+
+		HingeRows() : enable_limit(false)
+		{
+			lower_limit.lower = 0.0f;
+			upper_limit.upper = 0.0f;
+		}
+
+		void prestep(DynamicBody* a, DynamicBody* b, const glm::vec3& world_a, const glm::vec3& world_b, const glm::vec3& axis_a, const glm::vec3& axis_b,
+			const glm::vec3& ref_a, const glm::vec3& ref_b, bool enable_limit, float lower_angle, float upper_angle, float dt)
+		{
+			point.prestep(a, b, world_a, world_b, dt);
+
+			glm::vec3 tangent;
+			if (glm::abs(axis_a.x) > glm::abs(axis_a.y))
+				tangent = glm::normalize(glm::cross(axis_a, glm::vec3(0.0f, 1.0f, 0.0f)));
+			else
+				tangent = glm::normalize(glm::cross(axis_a, glm::vec3(1.0f, 0.0f, 0.0f)));
+			glm::vec3 bitangent = glm::cross(axis_a, tangent);
+
+			// for small errors this is the rotation that takes the axis of a to the axis of b
+			glm::vec3 error = glm::cross(axis_a, axis_b);
+			swing[0].prestep(a, b, tangent, -glm::dot(error, tangent) * joint_baumgarte / dt);
+			swing[1].prestep(a, b, bitangent, -glm::dot(error, bitangent) * joint_baumgarte / dt);
+
+			if (!enable_limit)
+			{
+				lower_limit.impulse = upper_limit.impulse = 0.0f;
+				this->enable_limit = false;
+				return;
+			}
+			this->enable_limit = true;
+
+			// the limits stay active, inside them the bias lets the angle close the gap to the limit
+			// within the substep and no further, so a hinge resting on a limit doesn't lose its warm start
+			float angle = glm::atan(glm::dot(glm::cross(ref_a, ref_b), axis_a), glm::dot(ref_a, ref_b));
+			float lower_gap = angle - lower_angle;
+			float upper_gap = upper_angle - angle;
+			lower_limit.prestep(a, b, axis_a, lower_gap > 0.0f ? -lower_gap / dt : -lower_gap * joint_baumgarte / dt);
+			upper_limit.prestep(a, b, axis_a, upper_gap > 0.0f ? upper_gap / dt : upper_gap * joint_baumgarte / dt);
+		}
+
+		void warmStart(DynamicBody* a, DynamicBody* b)
+		{
+			point.warmStart(a, b);
+			swing[0].warmStart(a, b);
+			swing[1].warmStart(a, b);
+			if (enable_limit)
+			{
+				lower_limit.warmStart(a, b);
+				upper_limit.warmStart(a, b);
+			}
+		}
+
+		void solve(DynamicBody* a, DynamicBody* b)
+		{
+			if (enable_limit)
+			{
+				lower_limit.solve(a, b);
+				upper_limit.solve(a, b);
+			}
+			swing[0].solve(a, b);
+			swing[1].solve(a, b);
+			point.solve(a, b);
+		}
+	};
+
 	class Joint
 	{
 	public:
-		virtual void applyForces() = 0;
+		bool collide_connected; // set to false before adding the joint to stop the connected bodies colliding
+
+		Joint() : collide_connected(true)
+		{
+
+		}
+
+		// applied with the other forces before the velocities are integrated, for springs and motors
+		virtual void applyForces()
+		{
+
+		}
+
+		/**
+		Velocity constraints, solved in the same iterations as the contacts of their island
+		prestep runs once per substep, then warmStart applies the impulses kept from the last
+		substep and solveVelocities runs once per iteration
+		*/
+		virtual void prestep(float)
+		{
+
+		}
+		virtual void warmStart()
+		{
+
+		}
+		virtual void solveVelocities()
+		{
+
+		}
+
+		// the bodies connected by the joint, a is null for joints anchored to the world
+		virtual DynamicBody* getBodyA() { return nullptr; }
+		virtual DynamicBody* getBodyB() { return nullptr; }
+
+		// called by the world when it moves its dynamic bodies
+		virtual void relocateBodies(const BodyRelocation&)
+		{
+
+		}
 	};
 
 	class AnchoredSpringJoint : public Joint
@@ -37,6 +288,13 @@ namespace fiz
 			glm::vec3 force = dir * (diff * spring_constant);
 			body->applyForceLocal(force, local);
 		}
+
+		DynamicBody* getBodyB() { return body; }
+
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(body);
+		}
 	};
 
 	class SpringJoint : public Joint
@@ -68,6 +326,15 @@ namespace fiz
 			a->applyForceLocal(force, local_a);
 			b->applyForceLocal(-force, local_b);
 		}
+
+		DynamicBody* getBodyA() { return a; }
+		DynamicBody* getBodyB() { return b; }
+
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(a);
+			relocation.apply(b);
+		}
 	};
 
 	class AnchoredBallJoint : public Joint
@@ -82,26 +349,30 @@ namespace fiz
 
 		}
 
-		void applyForces()
+		void prestep(float dt)
 		{
-			// reset pos
-			glm::vec3 dir = body->getWorldPos(local) - anchor;
-			body->pos -= dir;
-
-			// create contact
-			ContactInfo contact;
-			contact.collided = true;
-			contact.body_a = nullptr;
-			contact.body_b = body;
-			contact.poc = anchor;
-			contact.normal = -glm::normalize(body->getVelocityWorld(anchor));
-			if (contact.normal.x != contact.normal.x)
-				contact.normal = glm::vec3(0.0f, 0.0f, 1.0f);
-			contact.depth = 0.0f;
-			contact.restitution = 0.0f;
-			contact.friction = 1.0f;
-			contact.solveContactStatic();
+			point.prestep(nullptr, body, anchor, body->getWorldPos(local), dt);
 		}
+
+		void warmStart()
+		{
+			point.warmStart(nullptr, body);
+		}
+
+		void solveVelocities()
+		{
+			point.solve(nullptr, body);
+		}
+
+		DynamicBody* getBodyB() { return body; }
+
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(body);
+		}
+
+	private:
+		PointRows point;
 	};
 
 	class BallJoint : public Joint
@@ -117,53 +388,89 @@ namespace fiz
 
 		}
 
-		void applyForces()
+		void prestep(float dt)
 		{
-			// reset pos
-			glm::vec3 world_a = a->getWorldPos(local_a);
-			glm::vec3 world_b = b->getWorldPos(local_b);
-			glm::vec3 dir = world_b - world_a;
-			a->pos += dir * 0.5f;
-			b->pos -= dir * 0.5f;
-
-			ContactInfo contact;
-			contact.collided = true;
-			contact.body_a = a;
-			contact.body_b = b;
-			contact.poc = (world_a + world_b) * 0.5f;
-			contact.normal = -glm::normalize(b->getVelocityWorld(contact.poc) - a->getVelocityWorld(contact.poc));
-			if (contact.normal.x != contact.normal.x)
-				contact.normal = glm::vec3(0.0f, 0.0f, 1.0f);
-			contact.depth = 0.0f;
-			contact.restitution = 0.0f;
-			contact.friction = 1.0f;
-			contact.solveContactDynamic();
+			point.prestep(a, b, a->getWorldPos(local_a), b->getWorldPos(local_b), dt);
+		}
+
+		void warmStart()
+		{
+			point.warmStart(a, b);
 		}
+
+		void solveVelocities()
+		{
+			point.solve(a, b);
+		}
+
+		DynamicBody* getBodyA() { return a; }
+		DynamicBody* getBodyB() { return b; }
+
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(a);
+			relocation.apply(b);
+		}
+
+	private:
+		PointRows point;
 	};
 
+	/**
+	Hinge between a body and the world, the limit angle is 0 when the
+	reference vectors of the body and the anchor point the same way
+	*/
 	class AnchoredRevoluteJoint : public Joint
 	{
 	public:
 		DynamicBody* body;
 		glm::vec3 local;
 		glm::vec3 local_axis;
+		glm::vec3 local_ref;
 
 		glm::vec3 anchor;
 		glm::vec3 anchor_axis;
+		glm::vec3 anchor_ref;
+
+		bool enable_limit;
+		float lower_angle;
+		float upper_angle;
 
-		AnchoredRevoluteJoint() : body(nullptr), local(0.0f), local_axis(0.0f, 0.0f, 1.0f), anchor(0.0f), anchor_axis(0.0f, 0.0f, 1.0f)
+		AnchoredRevoluteJoint() : body(nullptr), local(0.0f), local_axis(0.0f, 0.0f, 1.0f), local_ref(1.0f, 0.0f, 0.0f), anchor(0.0f), anchor_axis(0.0f, 0.0f, 1.0f), anchor_ref(1.0f, 0.0f, 0.0f), enable_limit(false), lower_angle(0.0f), upper_angle(0.0f)
 		{
 
 		}
 
-		void applyForces()
+		void prestep(float dt)
 		{
-			// position constraint
-			glm::vec3 dir = body->getWorldPos(local) - anchor;
-			body->pos -= dir;
+			hinge.prestep(nullptr, body, anchor, body->getWorldPos(local), glm::normalize(anchor_axis), glm::normalize(body->getWorldVec(local_axis)),
+				anchor_ref, body->getWorldVec(local_ref), enable_limit, lower_angle, upper_angle, dt);
 		}
+
+		void warmStart()
+		{
+			hinge.warmStart(nullptr, body);
+		}
+
+		void solveVelocities()
+		{
+			hinge.solve(nullptr, body);
+		}
+
+		DynamicBody* getBodyB() { return body; }
+
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(body);
+		}
+
+	private:
+		HingeRows hinge;
 	};
 
+	/**
+	Hinge between two bodies, the limit angle is 0 when their reference vectors point the same way
+	*/
 	class RevoluteJoint : public Joint
 	{
 	public:
@@ -173,66 +480,45 @@ namespace fiz
 		glm::vec3 local_b;
 		glm::vec3 local_axis_a;
 		glm::vec3 local_axis_b;
+		glm::vec3 local_ref_a;
+		glm::vec3 local_ref_b;
+
+		bool enable_limit;
+		float lower_angle;
+		float upper_angle;
 
-		RevoluteJoint() : a(nullptr), b(nullptr), local_a(0.0f), local_b(0.0f), local_axis_a(0.0f, 0.0f, 1.0f), local_axis_b(0.0f, 0.0f, 1.0f)
+		RevoluteJoint() : a(nullptr), b(nullptr), local_a(0.0f), local_b(0.0f), local_axis_a(0.0f, 0.0f, 1.0f), local_axis_b(0.0f, 0.0f, 1.0f), local_ref_a(1.0f, 0.0f, 0.0f), local_ref_b(1.0f, 0.0f, 0.0f), enable_limit(false), lower_angle(0.0f), upper_angle(0.0f)
 		{
 
 		}
 
-		void applyForces()
+		void prestep(float dt)
 		{
-			// solve position constraint
-			glm::vec3 world_a = a->getWorldPos(local_a);
-			glm::vec3 world_b = b->getWorldPos(local_b);
-			glm::vec3 dir = world_b - world_a;
-			a->pos += dir * 0.5f;
-			b->pos -= dir * 0.5f;
-
-			// solve angle constraint
-			glm::vec3 world_axis_a = glm::normalize(a->getWorldVec(local_axis_a));
-			glm::vec3 world_axis_b = glm::normalize(b->getWorldVec(local_axis_b));
-			
-			glm::quat rot;
-			float cos = glm::dot(world_axis_a, world_axis_b);
-			glm::vec3 rot_axis;
-			if (cos < -0.9999f) // almost opposite direction
-			{
-				rot_axis = glm::cross(glm::vec3(0.0f, 0.0f, 1.0f), world_axis_a);
-				if (glm::dot(rot_axis, rot_axis) < 0.01f)
-					rot_axis = glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), world_axis_a);
-
-				rot_axis = glm::normalize(rot_axis);
-				rot = glm::angleAxis(glm::pi<float>(), rot_axis);
-			}
-			else
-			{
-				rot_axis = glm::cross(world_axis_a, world_axis_b);
-
-				float s = glm::sqrt((1 + cos) * 2.0f);
-				float inv_s = 1.0f / s;
+			hinge.prestep(a, b, a->getWorldPos(local_a), b->getWorldPos(local_b), glm::normalize(a->getWorldVec(local_axis_a)), glm::normalize(b->getWorldVec(local_axis_b)),
+				a->getWorldVec(local_ref_a), b->getWorldVec(local_ref_b), enable_limit, lower_angle, upper_angle, dt);
+		}
 
-				rot = glm::quat(s * 0.5f, rot_axis.x * inv_s, rot_axis.y * inv_s, rot_axis.z * inv_s);
-			}
-			
-			glm::quat rot_a = glm::mix(glm::quat(0.0f, 0.0f, 0.0f, 0.0f), rot, 0.5f);
-			glm::quat rot_b = glm::quat(rot_a.w, -rot_a.x, -rot_a.y, -rot_a.z);
+		void warmStart()
+		{
+			hinge.warmStart(a, b);
+		}
 
-			a->orientation = glm::normalize(rot * a->orientation);
-			//a->updateOrientationMat();
-			a->updateInverseInertiaWorld();
-			/*b->orientation = glm::normalize(rot_b * b->orientation);
+		void solveVelocities()
+		{
+			hinge.solve(a, b);
+		}
 
-			a->updateOrientationMat();
-			a->updateInverseInertiaWorld();
-			b->updateOrientationMat();
-			b->updateInverseInertiaWorld();*/
+		DynamicBody* getBodyA() { return a; }
+		DynamicBody* getBodyB() { return b; }
 
-			// solve velocity constraint
-			a->angular_vel = world_axis_a * glm::dot(a->angular_vel, world_axis_a);
-			b->angular_vel = world_axis_b * glm::dot(b->angular_vel, world_axis_b);
-			a->setAwake();
-			b->setAwake();
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(a);
+			relocation.apply(b);
 		}
+
+	private:
+		HingeRows hinge;
 	};
 
 	class CarJoint : public Joint
@@ -299,5 +585,12 @@ namespace fiz
 				}
 			}
 		}
+
+		DynamicBody* getBodyB() { return body; }
+
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			relocation.apply(body);
+		}
 	};
 }
\ No newline at end of file
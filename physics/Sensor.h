@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Body.h"
+
+namespace fiz
+{
+	enum SensorEventType
+	{
+		SENSOR_ENTER,
+		SENSOR_STAY,
+		SENSOR_EXIT
+	};
+
+	struct SensorEvent
+	{
+		SensorEventType type;
+		Body* sensor;
+		Body* body;
+	};
+
+	/**
+	A sensor and a body overlapping it
+	Kept sorted so the overlaps of two steps can be merged into events
+	*/
+	struct SensorPair
+	{
+		Body* sensor;
+		Body* body;
+
+		bool operator<(const SensorPair& other) const
+		{
+			if (sensor != other.sensor)
+				return sensor < other.sensor;
+			return body < other.body;
+		}
+
+		bool operator==(const SensorPair& other) const
+		{
+			return sensor == other.sensor && body == other.body;
+		}
+	};
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace fiz
+{
+	/**
+	Worker threads that run the tasks of a batch, each worker pops tasks from the front
+	of its own queue and steals from the back of the others when it runs out
+	Owned by the application, a world only keeps a pointer so it can still be copied
+	*/
+	class ThreadPool
+	{
+	public:
+		ThreadPool() : ThreadPool(std::thread::hardware_concurrency())
+		{
+
+		}
+		ThreadPool(unsigned int num_threads) : task(nullptr), generation(0), remaining(0), stopping(false)
+		{
+			// the calling thread works too, so it gets the first queue
+			if (num_threads == 0)
+				num_threads = 1;
+			for (unsigned int i = 0; i < num_threads; ++i)
+				queues.push_back(std::make_unique<TaskQueue>());
+			for (unsigned int i = 1; i < num_threads; ++i)
+				workers.emplace_back(&ThreadPool::workerLoop, this, i);
+		}
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			start_condition.notify_all();
+			for (unsigned int i = 0; i < workers.size(); ++i)
+				workers[i].join();
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		unsigned int getThreadCount()
+		{
+			return queues.size();
+		}
+
+		/**
+		Runs task(i) for every i below count and returns once all of them are done
+		Tasks are dealt to the queues in order, so put the largest ones first
+		*/
+		void run(unsigned int count, const std::function<void(unsigned int)>& task)
+		{
+			if (count == 0)
+				return;
+
+			if (workers.empty() || count == 1)
+			{
+				for (unsigned int i = 0; i < count; ++i)
+					task(i);
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				this->task = &task;
+				remaining = count;
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					TaskQueue& queue = *queues[i % queues.size()];
+					std::lock_guard<std::mutex> queue_lock(queue.mutex);
+					queue.tasks.push_back(i);
+				}
+				generation++;
+			}
+			start_condition.notify_all();
+
+			work(0);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done_condition.wait(lock, [this]() { return remaining == 0; });
+		}
+
+	private:
+		struct TaskQueue
+		{
+			std::mutex mutex;
+			std::deque<unsigned int> tasks;
+		};
+
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<TaskQueue>> queues; // one for each worker and the calling thread
+
+		std::mutex mutex;
+		std::condition_variable start_condition;
+		std::condition_variable done_condition;
+		const std::function<void(unsigned int)>* task;
+		unsigned int generation; // incremented for each batch so the workers know to start
+		std::atomic<unsigned int> remaining;
+		bool stopping;
+
+		void workerLoop(unsigned int id)
+		{
+			unsigned int seen = 0;
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					start_condition.wait(lock, [this, seen]() { return stopping || generation != seen; });
+					if (stopping)
+						return;
+					seen = generation;
+				}
+				work(id);
+			}
+		}
+
+		void work(unsigned int id)
+		{
+			unsigned int index;
+			while (popTask(id, index))
+			{
+				(*task)(index);
+				if (--remaining == 0)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					done_condition.notify_all();
+				}
+			}
+		}
+
+		bool popTask(unsigned int id, unsigned int& index)
+		{
+			{
+				TaskQueue& own = *queues[id];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (!own.tasks.empty())
+				{
+					index = own.tasks.front();
+					own.tasks.pop_front();
+					return true;
+				}
+			}
+
+			for (unsigned int i = 1; i < queues.size(); ++i)
+			{
+				TaskQueue& other = *queues[(id + i) % queues.size()];
+				std::lock_guard<std::mutex> lock(other.mutex);
+				if (!other.tasks.empty())
+				{
+					index = other.tasks.back();
+					other.tasks.pop_back();
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+}
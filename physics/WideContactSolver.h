@@ -0,0 +1,416 @@
+#pragma once
+
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FIZ_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "Body.h"
+#include "GraphColoring.h"
+#include "geometry/Collision.h"
+
+namespace fiz
+{
+	/**
+	Four floats worked on together, one for each lane of a contact batch
+	Uses SSE when the compiler targets it and plain arrays otherwise
+	*/
+	struct float4
+	{
+#ifdef FIZ_SSE
+		union
+		{
+			__m128 v;
+			float lanes[4];
+		};
+
+		float4() {}
+		float4(__m128 v) : v(v) {}
+		float4(float f) : v(_mm_set1_ps(f)) {}
+		float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+		friend float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+		friend float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+		friend float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+		friend float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+		friend float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+		friend float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+		friend float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+#else
+		union
+		{
+			float v[4];
+			float lanes[4];
+		};
+
+		float4() {}
+		float4(float f) : v{ f, f, f, f } {}
+		float4(float a, float b, float c, float d) : v{ a, b, c, d } {}
+
+		friend float4 operator+(float4 a, float4 b) { return float4(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]); }
+		friend float4 operator-(float4 a, float4 b) { return float4(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]); }
+		friend float4 operator*(float4 a, float4 b) { return float4(a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]); }
+		friend float4 operator/(float4 a, float4 b) { return float4(a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]); }
+		friend float4 min(float4 a, float4 b) { return float4(glm::min(a.v[0], b.v[0]), glm::min(a.v[1], b.v[1]), glm::min(a.v[2], b.v[2]), glm::min(a.v[3], b.v[3])); }
+		friend float4 max(float4 a, float4 b) { return float4(glm::max(a.v[0], b.v[0]), glm::max(a.v[1], b.v[1]), glm::max(a.v[2], b.v[2]), glm::max(a.v[3], b.v[3])); }
+		friend float4 sqrt(float4 a) { return float4(glm::sqrt(a.v[0]), glm::sqrt(a.v[1]), glm::sqrt(a.v[2]), glm::sqrt(a.v[3])); }
+#endif
+	};
+
+	// a vec3 for each lane, stored as x, y and z rows
+	struct vec3x4
+	{
+		float4 x;
+		float4 y;
+		float4 z;
+
+		vec3x4() {}
+		vec3x4(float4 x, float4 y, float4 z) : x(x), y(y), z(z) {}
+
+		vec3x4& operator+=(const vec3x4& b) { x = x + b.x; y = y + b.y; z = z + b.z; return *this; }
+		vec3x4& operator-=(const vec3x4& b) { x = x - b.x; y = y - b.y; z = z - b.z; return *this; }
+
+		friend vec3x4 operator-(const vec3x4& a, const vec3x4& b) { return vec3x4(a.x - b.x, a.y - b.y, a.z - b.z); }
+		friend vec3x4 operator*(const vec3x4& a, float4 s) { return vec3x4(a.x * s, a.y * s, a.z * s); }
+		friend float4 dot(const vec3x4& a, const vec3x4& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	};
+
+	// the rows of one contact point in each lane of a batch
+	struct ContactPointRows
+	{
+		// r cross the row direction, for the relative velocity, and the inverse inertia times it, for the impulse
+		vec3x4 normal_arm_a;
+		vec3x4 normal_arm_b;
+		vec3x4 normal_turn_a;
+		vec3x4 normal_turn_b;
+		vec3x4 tangent_arm_a;
+		vec3x4 tangent_arm_b;
+		vec3x4 tangent_turn_a;
+		vec3x4 tangent_turn_b;
+		vec3x4 bitangent_arm_a;
+		vec3x4 bitangent_arm_b;
+		vec3x4 bitangent_turn_a;
+		vec3x4 bitangent_turn_b;
+
+		float4 normal_mass; // zero for empty lanes, which then never get an impulse
+		float4 tangent_mass;
+		float4 bitangent_mass;
+		float4 velocity_bias;
+		float4 position_bias;
+
+		float4 normal_impulse;
+		float4 tangent_impulse;
+		float4 bitangent_impulse;
+		float4 push_impulse;
+	};
+
+	/**
+	Up to four manifolds solved together, one in each lane
+	The manifolds of a batch come from one color so no two lanes share a dynamic body
+	*/
+	struct ContactBatch
+	{
+		ContactManifold* manifolds[4]; // null for empty lanes
+		DynamicBody* bodies_a[4]; // null when the body doesn't move in the solver
+		DynamicBody* bodies_b[4];
+		unsigned int num_points; // the most points of any lane
+
+		float4 inv_mass_a;
+		float4 inv_mass_b;
+		vec3x4 normal;
+		vec3x4 tangent;
+		vec3x4 bitangent;
+		float4 friction;
+
+		ContactPointRows points[4];
+	};
+
+	/**
+	Solves the velocities and positions of colored contact manifolds four at a time
+	The manifolds are prestepped and warm started before build, which copies their
+	rows into batches, and storeImpulses copies the impulses back for the next step
+	*/
+	class WideContactSolver
+	{
+	public:
+		std::vector<ContactBatch> batches;
+		std::vector<unsigned int> color_start; // the batches of color c are [color_start[c], color_start[c + 1])
+		unsigned int overflow_start; // the overflow set gets one lane per batch since its manifolds may share bodies
+
+		WideContactSolver() : overflow_start(0)
+		{
+
+		}
+
+		void build(GraphColoring& coloring, std::vector<ContactManifold>& manifolds)
+		{
+			batches.clear();
+			color_start.clear();
+			for (unsigned int c = 0; c < coloring.num_colors; ++c)
+			{
+				color_start.push_back(batches.size());
+
+				unsigned int lane = 4;
+				for (unsigned int i = coloring.getColorStart(c); i < coloring.getColorStart(c) + coloring.getColorSize(c); ++i)
+				{
+					ContactManifold& manifold = manifolds[coloring.constraints[i]];
+					if (!manifold.isActive())
+						continue;
+
+					if (lane == 4)
+					{
+						batches.emplace_back();
+						initBatch(batches.back());
+						lane = 0;
+					}
+					addLane(batches.back(), lane++, manifold);
+				}
+			}
+			color_start.push_back(batches.size());
+
+			overflow_start = batches.size();
+			for (unsigned int i = coloring.getOverflowStart(); i < coloring.getOverflowStart() + coloring.getOverflowSize(); ++i)
+			{
+				ContactManifold& manifold = manifolds[coloring.constraints[i]];
+				if (!manifold.isActive())
+					continue;
+
+				batches.emplace_back();
+				initBatch(batches.back());
+				addLane(batches.back(), 0, manifold);
+			}
+		}
+
+		/**
+		One velocity iteration over the lanes of a batch, the same steps as ContactManifold::solveVelocities
+		*/
+		void solveBatch(ContactBatch& batch)
+		{
+			vec3x4 vel_a, vel_b, angular_vel_a, angular_vel_b;
+			gather(batch.bodies_a, &DynamicBody::vel, &DynamicBody::angular_vel, vel_a, angular_vel_a);
+			gather(batch.bodies_b, &DynamicBody::vel, &DynamicBody::angular_vel, vel_b, angular_vel_b);
+
+			for (unsigned int i = 0; i < batch.num_points; ++i)
+			{
+				ContactPointRows& point = batch.points[i];
+
+				// friction
+				vec3x4 rel_vel = vel_b - vel_a;
+				float4 tangent_vel = dot(rel_vel, batch.tangent) + dot(point.tangent_arm_b, angular_vel_b) - dot(point.tangent_arm_a, angular_vel_a);
+				float4 bitangent_vel = dot(rel_vel, batch.bitangent) + dot(point.bitangent_arm_b, angular_vel_b) - dot(point.bitangent_arm_a, angular_vel_a);
+
+				float4 max_friction = batch.friction * point.normal_impulse;
+				float4 old_tangent = point.tangent_impulse;
+				float4 old_bitangent = point.bitangent_impulse;
+				float4 tangent_impulse = old_tangent - tangent_vel * point.tangent_mass;
+				float4 bitangent_impulse = old_bitangent - bitangent_vel * point.bitangent_mass;
+
+				// scale back onto the cone, lanes inside it get a scale of one
+				float4 friction_impulse = sqrt(tangent_impulse * tangent_impulse + bitangent_impulse * bitangent_impulse);
+				float4 scale = min(max_friction / max(friction_impulse, float4(1e-20f)), float4(1.0f));
+				point.tangent_impulse = tangent_impulse * scale;
+				point.bitangent_impulse = bitangent_impulse * scale;
+
+				float4 d_tangent = point.tangent_impulse - old_tangent;
+				float4 d_bitangent = point.bitangent_impulse - old_bitangent;
+				vec3x4 impulse = batch.tangent * d_tangent;
+				impulse += batch.bitangent * d_bitangent;
+				vel_b += impulse * batch.inv_mass_b;
+				vel_a -= impulse * batch.inv_mass_a;
+				angular_vel_b += point.tangent_turn_b * d_tangent;
+				angular_vel_b += point.bitangent_turn_b * d_bitangent;
+				angular_vel_a -= point.tangent_turn_a * d_tangent;
+				angular_vel_a -= point.bitangent_turn_a * d_bitangent;
+
+				// normal
+				rel_vel = vel_b - vel_a;
+				float4 normal_vel = dot(rel_vel, batch.normal) + dot(point.normal_arm_b, angular_vel_b) - dot(point.normal_arm_a, angular_vel_a);
+				float4 lambda = point.normal_mass * (point.velocity_bias - normal_vel);
+				float4 old_normal = point.normal_impulse;
+				point.normal_impulse = max(old_normal + lambda, float4(0.0f));
+
+				float4 d_normal = point.normal_impulse - old_normal;
+				vel_b += batch.normal * (d_normal * batch.inv_mass_b);
+				vel_a -= batch.normal * (d_normal * batch.inv_mass_a);
+				angular_vel_b += point.normal_turn_b * d_normal;
+				angular_vel_a -= point.normal_turn_a * d_normal;
+			}
+
+			scatter(batch.bodies_a, &DynamicBody::vel, &DynamicBody::angular_vel, vel_a, angular_vel_a);
+			scatter(batch.bodies_b, &DynamicBody::vel, &DynamicBody::angular_vel, vel_b, angular_vel_b);
+		}
+
+		/**
+		One position iteration over the lanes of a batch, the same steps as ContactManifold::solvePositions
+		*/
+		void solvePositionBatch(ContactBatch& batch)
+		{
+			vec3x4 vel_a, vel_b, angular_vel_a, angular_vel_b;
+			gather(batch.bodies_a, &DynamicBody::pseudo_vel, &DynamicBody::pseudo_angular_vel, vel_a, angular_vel_a);
+			gather(batch.bodies_b, &DynamicBody::pseudo_vel, &DynamicBody::pseudo_angular_vel, vel_b, angular_vel_b);
+
+			for (unsigned int i = 0; i < batch.num_points; ++i)
+			{
+				ContactPointRows& point = batch.points[i];
+
+				vec3x4 rel_vel = vel_b - vel_a;
+				float4 normal_vel = dot(rel_vel, batch.normal) + dot(point.normal_arm_b, angular_vel_b) - dot(point.normal_arm_a, angular_vel_a);
+				float4 lambda = point.normal_mass * (point.position_bias - normal_vel);
+				float4 old_push = point.push_impulse;
+				point.push_impulse = max(old_push + lambda, float4(0.0f));
+
+				float4 d_push = point.push_impulse - old_push;
+				vel_b += batch.normal * (d_push * batch.inv_mass_b);
+				vel_a -= batch.normal * (d_push * batch.inv_mass_a);
+				angular_vel_b += point.normal_turn_b * d_push;
+				angular_vel_a -= point.normal_turn_a * d_push;
+			}
+
+			scatter(batch.bodies_a, &DynamicBody::pseudo_vel, &DynamicBody::pseudo_angular_vel, vel_a, angular_vel_a);
+			scatter(batch.bodies_b, &DynamicBody::pseudo_vel, &DynamicBody::pseudo_angular_vel, vel_b, angular_vel_b);
+		}
+
+		// copies the accumulated impulses back to the manifolds to warm start the next step
+		void storeImpulses()
+		{
+			for (unsigned int i = 0; i < batches.size(); ++i)
+			{
+				ContactBatch& batch = batches[i];
+				for (unsigned int lane = 0; lane < 4; ++lane)
+				{
+					ContactManifold* manifold = batch.manifolds[lane];
+					if (manifold == nullptr)
+						continue;
+
+					for (unsigned int j = 0; j < manifold->num_contacts; ++j)
+					{
+						manifold->normal_impulse[j] = batch.points[j].normal_impulse.lanes[lane];
+						manifold->tangent_impulse[j] = batch.points[j].tangent_impulse.lanes[lane];
+						manifold->bitangent_impulse[j] = batch.points[j].bitangent_impulse.lanes[lane];
+						manifold->push_impulse[j] = batch.points[j].push_impulse.lanes[lane];
+					}
+				}
+			}
+		}
+
+	private:
+		void initBatch(ContactBatch& batch)
+		{
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				batch.manifolds[lane] = nullptr;
+				batch.bodies_a[lane] = nullptr;
+				batch.bodies_b[lane] = nullptr;
+			}
+			batch.num_points = 0;
+		}
+
+		inline void setLane(float4& wide, unsigned int lane, float value)
+		{
+			wide.lanes[lane] = value;
+		}
+
+		inline void setLane(vec3x4& wide, unsigned int lane, const glm::vec3& value)
+		{
+			setLane(wide.x, lane, value.x);
+			setLane(wide.y, lane, value.y);
+			setLane(wide.z, lane, value.z);
+		}
+
+		// the lanes of a batch start empty, so rows a lane doesn't fill are zero
+		void addLane(ContactBatch& batch, unsigned int lane, ContactManifold& manifold)
+		{
+			if (lane == 0)
+			{
+				batch.inv_mass_a = batch.inv_mass_b = batch.friction = float4(0.0f);
+				batch.normal = batch.tangent = batch.bitangent = vec3x4(float4(0.0f), float4(0.0f), float4(0.0f));
+				for (unsigned int i = 0; i < 4; ++i)
+					batch.points[i] = zeroRows();
+			}
+
+			batch.manifolds[lane] = &manifold;
+			batch.bodies_a[lane] = manifold.solver_a;
+			batch.bodies_b[lane] = manifold.solver_b;
+			batch.num_points = glm::max(batch.num_points, manifold.num_contacts);
+
+			setLane(batch.inv_mass_a, lane, manifold.solver_a ? 1.0f / manifold.solver_a->mass : 0.0f);
+			setLane(batch.inv_mass_b, lane, manifold.solver_b ? 1.0f / manifold.solver_b->mass : 0.0f);
+			setLane(batch.normal, lane, manifold.normal);
+			setLane(batch.tangent, lane, manifold.tangent);
+			setLane(batch.bitangent, lane, manifold.bitangent);
+			setLane(batch.friction, lane, manifold.friction);
+
+			for (unsigned int i = 0; i < manifold.num_contacts; ++i)
+			{
+				ContactPointRows& point = batch.points[i];
+				setRow(point.normal_arm_a, point.normal_turn_a, lane, manifold.solver_a, manifold.r_a[i], manifold.normal);
+				setRow(point.normal_arm_b, point.normal_turn_b, lane, manifold.solver_b, manifold.r_b[i], manifold.normal);
+				setRow(point.tangent_arm_a, point.tangent_turn_a, lane, manifold.solver_a, manifold.r_a[i], manifold.tangent);
+				setRow(point.tangent_arm_b, point.tangent_turn_b, lane, manifold.solver_b, manifold.r_b[i], manifold.tangent);
+				setRow(point.bitangent_arm_a, point.bitangent_turn_a, lane, manifold.solver_a, manifold.r_a[i], manifold.bitangent);
+				setRow(point.bitangent_arm_b, point.bitangent_turn_b, lane, manifold.solver_b, manifold.r_b[i], manifold.bitangent);
+
+				setLane(point.normal_mass, lane, manifold.normal_mass[i]);
+				setLane(point.tangent_mass, lane, manifold.tangent_mass[i]);
+				setLane(point.bitangent_mass, lane, manifold.bitangent_mass[i]);
+				setLane(point.velocity_bias, lane, manifold.velocity_bias[i]);
+				setLane(point.position_bias, lane, manifold.position_bias[i]);
+				setLane(point.normal_impulse, lane, manifold.normal_impulse[i]);
+				setLane(point.tangent_impulse, lane, manifold.tangent_impulse[i]);
+				setLane(point.bitangent_impulse, lane, manifold.bitangent_impulse[i]);
+				setLane(point.push_impulse, lane, manifold.push_impulse[i]);
+			}
+		}
+
+		inline void setRow(vec3x4& arm, vec3x4& turn, unsigned int lane, DynamicBody* body, const glm::vec3& r, const glm::vec3& dir)
+		{
+			if (body == nullptr)
+				return;
+
+			glm::vec3 torque = glm::cross(r, dir);
+			setLane(arm, lane, torque);
+			if (!body->rotation_locked)
+				setLane(turn, lane, body->inertia_inv_world * torque);
+		}
+
+		ContactPointRows zeroRows()
+		{
+			ContactPointRows rows;
+			vec3x4 zero(float4(0.0f), float4(0.0f), float4(0.0f));
+			rows.normal_arm_a = rows.normal_arm_b = rows.normal_turn_a = rows.normal_turn_b = zero;
+			rows.tangent_arm_a = rows.tangent_arm_b = rows.tangent_turn_a = rows.tangent_turn_b = zero;
+			rows.bitangent_arm_a = rows.bitangent_arm_b = rows.bitangent_turn_a = rows.bitangent_turn_b = zero;
+			rows.normal_mass = rows.tangent_mass = rows.bitangent_mass = rows.velocity_bias = rows.position_bias = float4(0.0f);
+			rows.normal_impulse = rows.tangent_impulse = rows.bitangent_impulse = rows.push_impulse = float4(0.0f);
+			return rows;
+		}
+
+		// linear and angular pick the real or the pseudo velocities of the bodies
+		inline void gather(DynamicBody** bodies, glm::vec3 DynamicBody::* linear, glm::vec3 DynamicBody::* angular, vec3x4& vel, vec3x4& angular_vel)
+		{
+			glm::vec3 v[4];
+			glm::vec3 w[4];
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				v[lane] = bodies[lane] ? bodies[lane]->*linear : glm::vec3(0.0f);
+				w[lane] = bodies[lane] ? bodies[lane]->*angular : glm::vec3(0.0f);
+			}
+			vel = vec3x4(float4(v[0].x, v[1].x, v[2].x, v[3].x), float4(v[0].y, v[1].y, v[2].y, v[3].y), float4(v[0].z, v[1].z, v[2].z, v[3].z));
+			angular_vel = vec3x4(float4(w[0].x, w[1].x, w[2].x, w[3].x), float4(w[0].y, w[1].y, w[2].y, w[3].y), float4(w[0].z, w[1].z, w[2].z, w[3].z));
+		}
+
+		inline void scatter(DynamicBody** bodies, glm::vec3 DynamicBody::* linear, glm::vec3 DynamicBody::* angular, const vec3x4& vel, const vec3x4& angular_vel)
+		{
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				if (bodies[lane] == nullptr)
+					continue;
+
+				bodies[lane]->*linear = glm::vec3(vel.x.lanes[lane], vel.y.lanes[lane], vel.z.lanes[lane]);
+				bodies[lane]->*angular = glm::vec3(angular_vel.x.lanes[lane], angular_vel.y.lanes[lane], angular_vel.z.lanes[lane]);
+			}
+		}
+	};
+}
@@ -6,6 +6,13 @@
 #include "Body.h"
 #include "BodyDef.h"
 #include "Joint.h"
+#include "Articulation.h"
+#include "Sensor.h"
+#include "Island.h"
+#include "ThreadPool.h"
+#include "GraphColoring.h"
+#include "WideContactSolver.h"
+#include "BoundsBatch.h"
 #include "geometry/Shape.h"
 #include "geometry/Collision.h"
 
@@ -17,43 +24,129 @@ namespace fiz
 	{
 	public:
 		unsigned int iters;
+		unsigned int velocity_iters; // contact solver iterations in each substep
+		unsigned int position_iters; // contact position correction iterations in each substep
 
 		std::vector<Shape*> shapes;
 
+		// grows without leaving the pointers the world keeps dangling, the user should keep a BodyHandle
+		// instead of a pointer to a dynamic body that lives across createBody or destroyBody
 		std::vector<DynamicBody> dynamic_bodies;
+		std::vector<BodySlot> body_slots; // indexed by handles
+		std::vector<unsigned int> free_body_slots;
 		std::vector<StaticBody> static_bodies;
 		BVH<StaticBody> static_bvh;
+		std::vector<StaticBody> plane_bodies; // static bodies with a plane, kept out of the BVH
+		PlaneBatch plane_batch;
+
+		// static sensors live in their own tree so they never reach the narrow phase,
+		// plane sensors stay in plane_bodies and dynamic sensors in dynamic_bodies
+		std::vector<StaticBody> sensor_bodies;
+		BVH<StaticBody> sensor_bvh;
+		std::vector<SensorPair> sensor_overlaps; // overlaps found in the last step, sorted
+		std::vector<SensorEvent> sensor_events; // events of the last step
 
 		std::vector<Joint*> joints;
+		std::vector<Articulation*> articulations;
+
+		// dynamic bodies grouped by their contacts and joints, rebuilt every substep
+		IslandSet island_set;
+		std::vector<Island> islands;
+		std::vector<unsigned int> island_bodies; // indices into dynamic_bodies, grouped by island
+		std::vector<unsigned int> island_manifolds; // indices into contact_manifolds, grouped by island
+		std::vector<unsigned int> island_joints; // indices into joints, grouped by island
+		std::vector<unsigned int> awake_bodies; // awake dynamic bodies that aren't sensors
+
+		// the solvers run on the pool when it is set, on the scalar path islands with fewer constraints
+		// than island_batch_size are batched together so each task is worth handing to a thread
+		ThreadPool* thread_pool;
+		unsigned int island_batch_size;
+		std::vector<unsigned int> island_order; // awake islands, largest first
+		std::vector<IslandBatch> island_batches;
+
+		// islands with at least this many manifolds and joints, and the joint forces when there are this many
+		// joints, are solved color by color so a single large island is spread over the threads too
+		unsigned int graph_color_size;
+		GraphColoring contact_coloring;
+		GraphColoring joint_coloring;
+
+		// solve the contacts four manifolds at a time with SIMD, over all awake islands colored together,
+		// this is the default path and the scalar one solves island by island when it is off
+		bool wide_contacts;
+		WideContactSolver wide_solver;
+
+		// solve the normal impulses of each manifold together as a small LCP, so boxes resting on a face
+		// stop rocking in fewer iterations, uses the scalar solver since the wide one has no block rows
+		bool block_contacts;
 
 		std::vector<ContactInfo> contacts;
 		std::vector<ContactManifold> contact_manifolds;
+		std::unordered_map<ManifoldKey, unsigned int, ManifoldKeyHash> manifold_lookup;
 
 		glm::vec3 gravity;
 
+		// collide with the ground plane z = 0, turn off for worlds with their own terrain
+		bool ground_enabled;
+
+		// bodies with ccd that move further than this in a substep are swept against static bodies
+		float ccd_motion_threshold;
+		unsigned int ccd_max_impacts; // impacts resolved for each body in a substep
+		std::vector<Sweep> sweeps;
+
+		// pairs that are apart but close the gap within a substep get a speculative contact,
+		// so fast bodies stop at the surface with fewer iters instead of tunneling
+		bool speculative_contacts;
+
+		// detect collisions once per step and only substep the joints, integration and contact
+		// solve, collision cost drops by iters at the price of finding new contacts a step late
+		bool tgs_substepping;
+		std::vector<AABB> predicted_aabbs; // bounds of each dynamic body over the next substep
+		BoundsBatch bounds_batch; // predicted_aabbs split by coordinate for the pair test
+		std::vector<unsigned int> bounds_hits;
+
 		void (*static_dynamic_collision_listener)(ContactInfo*);
 		void (*dynamic_dynamic_collision_listener)(ContactInfo*);
+		void (*sensor_listener)(SensorEvent*);
 
-		World() : gravity(0.0f, 0.0f, -9.8f), iters(4), static_bvh(&static_bodies), static_dynamic_collision_listener(nullptr), dynamic_dynamic_collision_listener(nullptr)
+		World() : iters(4), velocity_iters(4), position_iters(2), static_bvh(&static_bodies), sensor_bvh(&sensor_bodies), thread_pool(nullptr), island_batch_size(32), graph_color_size(256), wide_contacts(true), block_contacts(false), gravity(0.0f, 0.0f, -9.8f), ground_enabled(true), ccd_motion_threshold(0.05f), ccd_max_impacts(4), speculative_contacts(false), tgs_substepping(false), static_dynamic_collision_listener(nullptr), dynamic_dynamic_collision_listener(nullptr), sensor_listener(nullptr), substep_dt(0.0f)
 		{
 			shapes.reserve(10);
 			dynamic_bodies.reserve(600);
 			static_bodies.reserve(100);
+			plane_bodies.reserve(16);
+			sensor_bodies.reserve(16);
 			joints.reserve(40);
+			articulations.reserve(8);
 		}
 		~World() {}
 
 		void buildBVH()
 		{
-			static_bvh.createBVH();
+			// the world may have been copied since the trees were constructed
+			static_bvh.primitives = &static_bodies;
+			sensor_bvh.primitives = &sensor_bodies;
+
+			if (!static_bodies.empty())
+				static_bvh.createBVH();
+			if (!sensor_bodies.empty())
+				sensor_bvh.createBVH();
 		}
 
+		/**
+		Creates a body from the definition
+		A dynamic body moves whenever the world grows its storage or destroys another body, so the
+		pointer is only good until then, keep the handle from createDynamicBody instead
+		*/
 		Body* createBody(BodyDef& bd)
 		{
 			if (bd.type == BodyType::DYNAMIC)
 			{
+				if (dynamic_bodies.size() == dynamic_bodies.capacity())
+					growDynamicBodies();
+
 				dynamic_bodies.emplace_back(bd.pos);
 				DynamicBody* body = &dynamic_bodies[dynamic_bodies.size() - 1];
+				body->slot = createBodySlot(dynamic_bodies.size() - 1);
 				//shapes.push_back(bd.shape);
 
 				body->vel = bd.vel;
@@ -65,7 +158,12 @@ namespace fiz
 				body->linear_damping = bd.linear_damping;
 				body->angular_damping = bd.angular_damping;
 				body->rotation_locked = bd.rotation_locked;
+				body->is_sensor = bd.is_sensor;
+				body->filter = bd.filter;
+				body->ccd = bd.ccd && !bd.is_sensor;
 				body->addShape(bd.shape);
+				for (unsigned int i = 0; i < bd.child_shapes.size(); ++i)
+					body->addShape(bd.child_shapes[i]);
 
 				body->updateMassProperties();
 				body->updateOrientationMat();
@@ -76,15 +174,32 @@ namespace fiz
 			}
 			else if (bd.type == BodyType::STATIC)
 			{
-				static_bodies.emplace_back(bd.pos);
-				StaticBody* body = &static_bodies[static_bodies.size() - 1];
+				StaticBody* body;
+				if (bd.shape->shape_type == ShapeType::PLANE_TYPE)
+				{
+					plane_bodies.emplace_back(bd.pos);
+					body = &plane_bodies[plane_bodies.size() - 1];
+				}
+				else if (bd.is_sensor)
+				{
+					sensor_bodies.emplace_back(bd.pos);
+					body = &sensor_bodies[sensor_bodies.size() - 1];
+				}
+				else
+				{
+					static_bodies.emplace_back(bd.pos);
+					body = &static_bodies[static_bodies.size() - 1];
+				}
 				//shapes.push_back(bd.shape);
 
 				body->orientation = bd.orientation;
 				body->restitution = bd.restitution;
 				body->friction = bd.friction;
 				body->is_sensor = bd.is_sensor;
+				body->filter = bd.filter;
 				body->addShape(bd.shape);
+				for (unsigned int i = 0; i < bd.child_shapes.size(); ++i)
+					body->addShape(bd.child_shapes[i]);
 
 				body->updateOrientationMat();
 				body->updateAABB();
@@ -94,116 +209,165 @@ namespace fiz
 			return nullptr;
 		}
 
-		void addJoint(Joint* joint)
+		// creates a dynamic body and returns a handle that stays valid until the body is destroyed
+		BodyHandle createDynamicBody(BodyDef& bd)
 		{
-			joints.push_back(joint);
+			bd.type = BodyType::DYNAMIC;
+			return getHandle((DynamicBody*)createBody(bd));
 		}
 
-		void step(float delta_t)
+		BodyHandle getHandle(DynamicBody* body)
 		{
-			float dt = delta_t / (float)iters;
-			for (unsigned int x = 0; x < iters; ++x)
+			return { body->slot, body_slots[body->slot].generation };
+		}
+
+		// the body the handle refers to, or null once it has been destroyed
+		DynamicBody* getBody(BodyHandle handle)
+		{
+			if (handle.slot >= body_slots.size() || body_slots[handle.slot].generation != handle.generation)
+				return nullptr;
+			return &dynamic_bodies[body_slots[handle.slot].body];
+		}
+
+		/**
+		Removes a dynamic body, the last body takes its place
+		Bodies connected by joints or articulations must not be destroyed, the world doesn't own those
+		*/
+		void destroyBody(BodyHandle handle)
+		{
+			DynamicBody* body = getBody(handle);
+			if (body == nullptr)
+				return;
+
+			// the bodies it was holding up fall once it is gone
+			for (unsigned int i = 0; i < contact_manifolds.size();)
 			{
-				// apply joint forces
-				for (unsigned int i = 0; i < joints.size(); ++i)
+				ContactManifold& manifold = contact_manifolds[i];
+				if (manifold.body_a != body && manifold.body_b != body)
 				{
-					joints[i]->applyForces();
+					++i;
+					continue;
 				}
+				Body* other = manifold.body_a == body ? manifold.body_b : manifold.body_a;
+				if (other != nullptr && other->type == BodyType::DYNAMIC)
+					((DynamicBody*)other)->setAwake();
+				removeManifold(i);
+			}
 
-				// update bodies
-				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
-				{
-					if (dynamic_bodies[i].is_awake)
-						dynamic_bodies[i].applyForce(gravity * dynamic_bodies[i].mass);
+			for (unsigned int i = 0; i < sensor_overlaps.size();)
+			{
+				if (sensor_overlaps[i].sensor == body || sensor_overlaps[i].body == body)
+					sensor_overlaps.erase(sensor_overlaps.begin() + i);
+				else
+					++i;
+			}
+			// events of the last step can't point at the body once its slot is reused
+			for (unsigned int i = 0; i < sensor_events.size();)
+			{
+				if (sensor_events[i].sensor == body || sensor_events[i].body == body)
+					sensor_events.erase(sensor_events.begin() + i);
+				else
+					++i;
+			}
 
-					dynamic_bodies[i].update(dt);
-				}
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				std::vector<Body*>& jointed = dynamic_bodies[i].jointed_bodies;
+				jointed.erase(std::remove(jointed.begin(), jointed.end(), (Body*)body), jointed.end());
+			}
 
-				// dynamic vs dynamic collision detection
-				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
-				{
-					if (dynamic_bodies[i].is_awake)
-					{
-						ContactInfo contact = checkCollisionGround(&dynamic_bodies[i]);
-						if (contact.collided)
-							contact.solveContactStatic();
-					}
+			++body_slots[handle.slot].generation;
+			free_body_slots.push_back(handle.slot);
 
-					for (unsigned int j = 0; j < i; ++j)
-					{
-						if (!dynamic_bodies[i].is_awake && !dynamic_bodies[j].is_awake)
-							continue;
+			unsigned int last = dynamic_bodies.size() - 1;
+			if (body != &dynamic_bodies[last])
+			{
+				*body = dynamic_bodies[last];
+				relocateBodies({ &dynamic_bodies[last], 1, body });
+				body_slots[body->slot].body = getDynamicIndex(body);
+			}
+			dynamic_bodies.pop_back();
+		}
 
-						if (!dynamic_bodies[i].aabb.intersects(dynamic_bodies[j].aabb))
-							continue;
+		void addJoint(Joint* joint)
+		{
+			joints.push_back(joint);
 
-						// check for collision between bodies
-						if (dynamic_bodies[i].shapes[0]->shape_type == ShapeType::SPHERE_TYPE &&
-							dynamic_bodies[j].shapes[0]->shape_type == ShapeType::SPHERE_TYPE)
-						{
-							ContactInfo contact = checkCollisionSphereSphere(&dynamic_bodies[i], &dynamic_bodies[j]);
-							if (contact.collided)
-							{
-								if (dynamic_dynamic_collision_listener != nullptr)
-									dynamic_dynamic_collision_listener(&contact);
-								contact.solveContactDynamic();
-							}
-						}
-						else
-						{
-							bool intersecting = GJK(&dynamic_bodies[i], &dynamic_bodies[j], glm::vec3(1.0f, 0.0f, 0.0f));
-							if (intersecting)
-							{
-								ContactInfo contact = EPA(&dynamic_bodies[i], &dynamic_bodies[j]);
-								if (contact.collided)
-								{
-									if (dynamic_dynamic_collision_listener != nullptr)
-										dynamic_dynamic_collision_listener(&contact);
-									contact.solveContactDynamic();
-								}
-							}
-						}
-					}
-				}
+			DynamicBody* a = joint->getBodyA();
+			DynamicBody* b = joint->getBodyB();
+			if (!joint->collide_connected && a != nullptr && b != nullptr)
+			{
+				a->jointed_bodies.push_back(b);
+				b->jointed_bodies.push_back(a);
+			}
+		}
 
-				if (static_bodies.size() > 0 && static_bvh.is_built)
-				{
-					for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
-					{
-						if (!dynamic_bodies[i].is_awake)
-							continue;
+		// the links of the articulation have to be added to it first, connected links don't collide
+		void addArticulation(Articulation* articulation)
+		{
+			articulations.push_back(articulation);
 
-						std::vector<int> bodies;
-						static_bvh.traverse(dynamic_bodies[i].aabb, bodies);
+			for (unsigned int i = 0; i < articulation->links.size(); ++i)
+			{
+				ArticulationLink& link = articulation->links[i];
+				if (link.parent < 0)
+					continue;
 
-						for (unsigned int x = 0; x < bodies.size(); ++x)
-						{
-							solveDynamicStatic(dynamic_bodies[i], static_bodies[bodies[x]]);
-						}
-					}
-				}
-				else
+				DynamicBody* parent = articulation->links[link.parent].body;
+				parent->jointed_bodies.push_back(link.body);
+				link.body->jointed_bodies.push_back(parent);
+			}
+		}
+
+		void step(float delta_t)
+		{
+			if (tgs_substepping)
+			{
+				stepSubstepped(delta_t);
+				updateSensors();
+				return;
+			}
+
+			float dt = delta_t / (float)iters;
+			substep_dt = dt;
+			for (unsigned int x = 0; x < iters; ++x)
+			{
+				applyJointForces();
+				integrateVelocities(dt);
+
+				// bounds of each body widened by its motion over the next substep
+				predictAABBs(dt);
+				detectCollisions();
+
+				removeStaleManifolds();
+				buildIslands();
+				solveContacts(dt);
+				applyArticulationImpulses();
+
+				// move the bodies with the solved velocities
+				sweeps.resize(dynamic_bodies.size());
+				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
 				{
-					// dynamic vs static collision detection
-					for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
-					{
-						if (!dynamic_bodies[i].is_awake)
-							continue;
+					DynamicBody& body = dynamic_bodies[i];
+					sweeps[i].pos0 = body.pos;
+					sweeps[i].orientation0 = body.orientation;
 
-						for (unsigned int j = 0; j < static_bodies.size(); ++j)
-						{
-							if (!dynamic_bodies[i].aabb.intersects(static_bodies[j].aabb))
-								continue;
-							
-							solveDynamicStatic(dynamic_bodies[i], static_bodies[j]);
-						}
-					}
+					body.integratePosition(dt);
+
+					sweeps[i].pos1 = body.pos;
+					sweeps[i].orientation1 = body.orientation;
+					sweeps[i].angle = body.rotation_locked ? 0.0f : glm::length(body.angular_vel) * dt;
 				}
+				integrateArticulationPositions(dt);
+
+				updateAABBs();
+				solveContinuous(dt);
 
 				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
 				{
 					dynamic_bodies[i].updateSleep(dt);
 				}
+				updateIslandSleep();
 				////std::cout << "contacts: " << contacts.size() << std::endl;
 				//sort(contacts.begin(), contacts.end(), [](ContactInfo& a, ContactInfo& b) {return a.depth > b.depth; });
 
@@ -213,79 +377,1460 @@ namespace fiz
 				//	contacts[i].solveContact2();
 				//}
 			}
+
+			updateSensors();
+		}
+
+		ContactManifold* getManifold(Body* a, Body* b, unsigned int child_a, unsigned int child_b)
+		{
+			ManifoldKey key = { a, b, child_a, child_b };
+			auto it = manifold_lookup.find(key);
+			if (it != manifold_lookup.end())
+				return &contact_manifolds[it->second];
+
+			manifold_lookup[key] = contact_manifolds.size();
+			contact_manifolds.emplace_back(a, b, child_a, child_b);
+			return &contact_manifolds[contact_manifolds.size() - 1];
 		}
+
 	private:
-		inline glm::vec3 intersectionNormal(Body* a, Body* b)
+		float substep_dt;
+
+		/**
+		Runs collision detection once for the whole step, with the bounds widened over the step,
+		then substeps only the joints, integration and contact solve. The manifolds keep their
+		points between substeps and their depths follow the bodies through the local anchors
+		Pairs that start touching during the step are found in the next one, or by speculative contacts
+		*/
+		void stepSubstepped(float delta_t)
 		{
-			Sphere* s_a = (Sphere*)a->shapes[0];
-			Sphere* s_b = (Sphere*)b->shapes[0];
-			glm::vec3 dist = b->pos - a->pos;
-			glm::vec3 normal = glm::normalize(dist);
-			float dist2 = dist.x * dist.x + dist.y * dist.y + dist.z * dist.z;
-			float r2 = s_a->rad + s_b->rad;
-			if (dist2 < r2 * r2 && a->pos != b->pos)
+			float dt = delta_t / (float)iters;
+
+			// the speculative contacts and bounds cover the whole step
+			substep_dt = delta_t;
+			predictAABBs(delta_t);
+			detectCollisions();
+			removeStaleManifolds();
+			buildIslands();
+			substep_dt = dt;
+
+			sweeps.resize(dynamic_bodies.size());
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
 			{
-				float len = r2 - std::sqrtf(dist2);
-				normal *= len;
-				return normal;
+				sweeps[i].pos0 = dynamic_bodies[i].pos;
+				sweeps[i].orientation0 = dynamic_bodies[i].orientation;
+				sweeps[i].angle = 0.0f;
 			}
-			return glm::vec3(0.0f, 0.0f, 0.0f);
+
+			for (unsigned int x = 0; x < iters; ++x)
+			{
+				applyJointForces();
+				integrateVelocities(dt);
+
+				if (x > 0)
+				{
+					for (unsigned int i = 0; i < contact_manifolds.size(); ++i)
+					{
+						if (!contact_manifolds[i].isAsleep())
+							contact_manifolds[i].updateDepths();
+					}
+				}
+				solveContacts(dt);
+				applyArticulationImpulses();
+
+				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+				{
+					DynamicBody& body = dynamic_bodies[i];
+					body.integratePosition(dt);
+					if (!body.rotation_locked)
+						sweeps[i].angle += glm::length(body.angular_vel) * dt;
+					body.updateSleep(dt);
+				}
+				integrateArticulationPositions(dt);
+			}
+
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				sweeps[i].pos1 = dynamic_bodies[i].pos;
+				sweeps[i].orientation1 = dynamic_bodies[i].orientation;
+			}
+
+			updateAABBs();
+			solveContinuous(delta_t);
+			updateIslandSleep();
 		}
-		inline void solveCollision(float m1, float m2, glm::vec3& v1, glm::vec3& v2, glm::vec3& normal)
+
+		// applies gravity and the forces to the velocities, positions move after the contacts are solved
+		void integrateVelocities(float dt)
 		{
-			static float friction = 0.0f;
-			static float restitution = 0.0f;
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				DynamicBody& body = dynamic_bodies[i];
+				if (body.is_awake)
+					body.applyForce(gravity * body.mass);
 
-			float fr = 1 - friction;
+				body.integrateVelocity(dt);
+			}
 
-			normal = normalize(normal);
-			glm::vec3 lat1 = glm::normalize(glm::cross(normal, glm::vec3(0.57f, 0.51f, 0.13f)));
-			glm::vec3 lat2 = glm::normalize(glm::cross(normal, lat1));
-			
-			float m1m2 = m1 + m2;
+			// the links were integrated as free bodies, the articulations turn that into joint motion
+			for (unsigned int i = 0; i < articulations.size(); ++i)
+				articulations[i]->integrateVelocities(dt);
+		}
 
-			float u1 = glm::dot(normal, v1);
-			float u2 = glm::dot(normal, v2);
-			float l1_1 = glm::dot(lat1, v1);
-			float l2_1 = glm::dot(lat1, v2);
-			float l1_2 = glm::dot(lat2, v1);
-			float l2_2 = glm::dot(lat2, v2);
+		// the contacts solved the links as free bodies, their impulses are applied to the whole articulation
+		void applyArticulationImpulses()
+		{
+			for (unsigned int i = 0; i < articulations.size(); ++i)
+				articulations[i]->applyImpulses();
+		}
 
-			float v_1 = ((m1 - m2) / m1m2) * u1 + ((m2 * 2) / m1m2) * u2;
-			float v_2 = ((m1 * 2) / m1m2) * u1 + ((m2 - m1) / m1m2) * u2;
+		// puts the links back on their joints after the bodies were moved
+		void integrateArticulationPositions(float dt)
+		{
+			for (unsigned int i = 0; i < articulations.size(); ++i)
+				articulations[i]->integratePositions(dt);
+		}
 
-			v1 = (normal * v_1 * restitution) + (lat1 * l1_1 * fr) + (lat2 * l1_2 * fr);
-			v2 = (normal * v_1 * restitution) + (lat1 * l2_1 * fr) + (lat2 * l2_2 * fr);
+		void predictAABBs(float dt)
+		{
+			predicted_aabbs.resize(dynamic_bodies.size());
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				DynamicBody& body = dynamic_bodies[i];
+				predicted_aabbs[i] = findsSpeculativeContacts() ? body.aabb.sweep(body.vel * dt) : body.aabb;
+			}
 		}
-		inline void solveDynamicStatic(DynamicBody& dynamic_body, StaticBody& static_body)
+
+		void detectCollisions()
 		{
-			if (dynamic_body.shapes[0]->shape_type == ShapeType::SPHERE_TYPE &&
-				static_body.shapes[0]->shape_type == ShapeType::SPHERE_TYPE)
+			// dynamic vs plane collision detection
+			collidePlanes();
+
+			// dynamic vs dynamic collision detection, sleeping islands only take part when an awake body reaches them
+			awake_bodies.clear();
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				if (dynamic_bodies[i].is_awake && !dynamic_bodies[i].is_sensor)
+					awake_bodies.push_back(i);
+			}
+			// the filters are tested before the bounds, sensors have an empty filter in the batch
+			bounds_batch.gather(predicted_aabbs, dynamic_bodies);
+			for (unsigned int x = 0; x < awake_bodies.size(); ++x)
+			{
+				unsigned int i = awake_bodies[x];
+				bounds_hits.clear();
+				bounds_batch.query(predicted_aabbs[i], dynamic_bodies[i].filter, bounds_hits);
+				for (unsigned int y = 0; y < bounds_hits.size(); ++y)
+				{
+					unsigned int j = bounds_hits[y];
+					if (j == i)
+						continue;
+
+					// a pair of awake bodies is tested once, from the body with the larger index
+					if (dynamic_bodies[j].is_awake && j > i)
+						continue;
+
+					if (dynamic_bodies[i].isJointedTo(&dynamic_bodies[j]))
+						continue;
+
+					// check for collision between bodies, larger index first so the manifold keys stay the same
+					unsigned int a = glm::max(i, j);
+					unsigned int b = glm::min(i, j);
+					collideBodies(&dynamic_bodies[a], &dynamic_bodies[b], dynamic_dynamic_collision_listener, true);
+				}
+			}
+
+			if (static_bodies.size() > 0 && static_bvh.is_built)
 			{
-				ContactInfo contact = checkCollisionSphereSphere(&static_body, &dynamic_body);
-				if (contact.collided)
+				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
 				{
-					if (static_dynamic_collision_listener != nullptr)
-						static_dynamic_collision_listener(&contact);
-					if (!static_body.is_sensor)
-						contact.solveContactStatic();
+					if (!dynamic_bodies[i].is_awake || dynamic_bodies[i].is_sensor)
+						continue;
+
+					DynamicBody& body = dynamic_bodies[i];
+					std::vector<int> bodies;
+					static_bvh.traverse(predicted_aabbs[i], bodies, [&body](StaticBody& other) { return body.shouldCollide(&other); });
+
+					for (unsigned int x = 0; x < bodies.size(); ++x)
+						solveDynamicStatic(body, static_bodies[bodies[x]]);
 				}
 			}
 			else
 			{
-				bool intersecting = GJK(&static_body, &dynamic_body, glm::vec3(1.0f, 0.0f, 0.0f));
-				if (intersecting)
+				// dynamic vs static collision detection
+				for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
 				{
-					ContactInfo contact = EPA(&static_body, &dynamic_body);
-					if (contact.collided)
+					if (!dynamic_bodies[i].is_awake || dynamic_bodies[i].is_sensor)
+						continue;
+
+					for (unsigned int j = 0; j < static_bodies.size(); ++j)
 					{
-						if (static_dynamic_collision_listener != nullptr)
-							static_dynamic_collision_listener(&contact);
-						if (!static_body.is_sensor)
-							contact.solveContactStatic();
+						if (!dynamic_bodies[i].shouldCollide(&static_bodies[j]))
+							continue;
+
+						if (!predicted_aabbs[i].intersects(static_bodies[j].aabb))
+							continue;
+						
+						solveDynamicStatic(dynamic_bodies[i], static_bodies[j]);
 					}
 				}
 			}
 		}
+
+		// update the bounds of the moving bodies from their local bounds in one pass
+		void updateAABBs()
+		{
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				if (dynamic_bodies[i].is_awake)
+					dynamic_bodies[i].updateLocalAABB();
+			}
+		}
+
+		// sweep fast bodies against static bodies so they can't tunnel through them
+		void solveContinuous(float dt)
+		{
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				DynamicBody& body = dynamic_bodies[i];
+				if (!body.ccd || !body.is_awake)
+					continue;
+
+				float radius = body.getBoundingRadius();
+				float motion = glm::length(sweeps[i].pos1 - sweeps[i].pos0) + sweeps[i].angle * radius;
+				if (motion > ccd_motion_threshold)
+					solveContinuous(body, sweeps[i], radius, dt);
+			}
+		}
+
+		// adds the contact to the persistent manifold of its pair, the manifolds are solved together after detection
+		inline void solveContact(ContactInfo& contact, unsigned int child_a, unsigned int child_b)
+		{
+			ContactManifold* manifold = getManifold(contact.body_a, contact.body_b, child_a, child_b);
+			manifold->updateContacts();
+			manifold->addContact(contact);
+		}
+
+		/**
+		Solves the contacts of the awake islands, with the wide solver unless it is off or block
+		contacts are on since it has no block rows, otherwise with the scalar solver island by island
+		*/
+		void solveContacts(float dt)
+		{
+			island_order.clear();
+			for (unsigned int i = 0; i < islands.size(); ++i)
+			{
+				if (islands[i].is_awake && islands[i].getConstraintCount() > 0)
+					island_order.push_back(i);
+			}
+			std::sort(island_order.begin(), island_order.end(), [this](unsigned int a, unsigned int b) {
+				if (islands[a].getConstraintCount() != islands[b].getConstraintCount())
+					return islands[a].getConstraintCount() > islands[b].getConstraintCount();
+				return a < b;
+			});
+
+			if (wide_contacts && !block_contacts)
+				solveContactsWide(dt);
+			else
+				solveContactsIslands(dt);
+		}
+
+		/**
+		Solves the contacts of each awake island with the scalar solver, on the thread pool when there is one
+		Large islands get a task each and small ones are batched, the result is the same
+		for any number of threads since the islands don't share any bodies
+		*/
+		void solveContactsIslands(float dt)
+		{
+			// the largest islands are solved one at a time with their constraints spread over the threads
+			unsigned int colored = 0;
+			while (colored < island_order.size() && islands[island_order[colored]].getConstraintCount() >= graph_color_size)
+				++colored;
+			for (unsigned int i = 0; i < colored; ++i)
+				solveIslandColored(islands[island_order[i]], dt);
+
+			island_batches.clear();
+			for (unsigned int i = colored; i < island_order.size();)
+			{
+				IslandBatch batch = { i, 0 };
+				unsigned int constraints = 0;
+				while (i < island_order.size() && constraints < island_batch_size)
+				{
+					constraints += islands[island_order[i]].getConstraintCount();
+					batch.count++;
+					++i;
+				}
+				island_batches.push_back(batch);
+			}
+
+			auto solve_batch = [this, dt](unsigned int index) {
+				IslandBatch& batch = island_batches[index];
+				for (unsigned int i = batch.start; i < batch.start + batch.count; ++i)
+					solveIsland(islands[island_order[i]], dt);
+			};
+
+			runTasks(island_batches.size(), solve_batch);
+		}
+
+		/**
+		Solves the contacts of an island color by color, the manifolds of a color
+		share no dynamic bodies so they are split into chunks over the threads
+		*/
+		void solveIslandColored(Island& island, float dt)
+		{
+			contact_coloring.reset(dynamic_bodies.size());
+			joint_coloring.reset(dynamic_bodies.size());
+			colorIsland(island);
+			contact_coloring.finish();
+			joint_coloring.finish();
+
+			forEachColored(contact_coloring, [this, dt](unsigned int i) {
+				ContactManifold& manifold = contact_manifolds[i];
+				if (!manifold.isAsleep())
+					manifold.prestep(dt, block_contacts);
+				else
+					manifold.solver_a = manifold.solver_b = nullptr;
+			});
+			forEachColored(joint_coloring, [this, dt](unsigned int i) {
+				prestepJoint(joints[i], dt);
+			});
+
+			forEachColored(contact_coloring, [this](unsigned int i) {
+				if (contact_manifolds[i].isActive())
+					contact_manifolds[i].warmStart();
+			});
+			forEachColored(joint_coloring, [this](unsigned int i) {
+				joints[i]->warmStart();
+			});
+
+			for (unsigned int x = 0; x < velocity_iters; ++x)
+			{
+				forEachColored(joint_coloring, [this](unsigned int i) {
+					joints[i]->solveVelocities();
+				});
+				forEachColored(contact_coloring, [this](unsigned int i) {
+					if (contact_manifolds[i].isActive())
+						contact_manifolds[i].solveVelocities(block_contacts);
+				});
+			}
+
+			for (unsigned int x = 0; x < position_iters; ++x)
+			{
+				forEachColored(contact_coloring, [this](unsigned int i) {
+					if (contact_manifolds[i].isActive())
+						contact_manifolds[i].solvePositions();
+				});
+			}
+		}
+
+		/**
+		Solves the contacts of every awake island with the wide solver, the islands share
+		no bodies so a single coloring covers all of them and fills the batches better
+		*/
+		void solveContactsWide(float dt)
+		{
+			contact_coloring.reset(dynamic_bodies.size());
+			joint_coloring.reset(dynamic_bodies.size());
+			for (unsigned int i = 0; i < island_order.size(); ++i)
+				colorIsland(islands[island_order[i]]);
+			contact_coloring.finish();
+			joint_coloring.finish();
+
+			forEachColored(contact_coloring, [this, dt](unsigned int i) {
+				ContactManifold& manifold = contact_manifolds[i];
+				if (!manifold.isAsleep())
+					manifold.prestep(dt);
+				else
+					manifold.solver_a = manifold.solver_b = nullptr;
+			});
+			forEachColored(joint_coloring, [this, dt](unsigned int i) {
+				prestepJoint(joints[i], dt);
+			});
+
+			forEachColored(contact_coloring, [this](unsigned int i) {
+				if (contact_manifolds[i].isActive())
+					contact_manifolds[i].warmStart();
+			});
+			forEachColored(joint_coloring, [this](unsigned int i) {
+				joints[i]->warmStart();
+			});
+
+			wide_solver.build(contact_coloring, contact_manifolds);
+
+			for (unsigned int x = 0; x < velocity_iters; ++x)
+			{
+				// the joints work on the body velocities the batches have scattered back
+				forEachColored(joint_coloring, [this](unsigned int i) {
+					joints[i]->solveVelocities();
+				});
+				forEachBatch([this](ContactBatch& batch) {
+					wide_solver.solveBatch(batch);
+				});
+			}
+
+			for (unsigned int x = 0; x < position_iters; ++x)
+			{
+				forEachBatch([this](ContactBatch& batch) {
+					wide_solver.solvePositionBatch(batch);
+				});
+			}
+
+			wide_solver.storeImpulses();
+		}
+
+		// calls solve(batch) for every batch of the wide solver, color by color like forEachColored
+		template<typename Function>
+		void forEachBatch(const Function& solve)
+		{
+			const unsigned int chunk_size = 16;
+			for (unsigned int c = 0; c + 1 < wide_solver.color_start.size(); ++c)
+			{
+				unsigned int start = wide_solver.color_start[c];
+				unsigned int size = wide_solver.color_start[c + 1] - start;
+				runTasks((size + chunk_size - 1) / chunk_size, [this, &solve, start, size, chunk_size](unsigned int chunk) {
+					unsigned int end = glm::min(start + (chunk + 1) * chunk_size, start + size);
+					for (unsigned int i = start + chunk * chunk_size; i < end; ++i)
+						solve(wide_solver.batches[i]);
+				});
+			}
+
+			for (unsigned int i = wide_solver.overflow_start; i < wide_solver.batches.size(); ++i)
+				solve(wide_solver.batches[i]);
+		}
+
+		void colorIsland(Island& island)
+		{
+			for (unsigned int i = island.manifold_start; i < island.manifold_start + island.manifold_count; ++i)
+			{
+				ContactManifold& manifold = contact_manifolds[island_manifolds[i]];
+				unsigned int a = manifold.body_a != nullptr && manifold.body_a->type == BodyType::DYNAMIC ? getDynamicIndex(manifold.body_a) : GraphColoring::no_body;
+				contact_coloring.add(island_manifolds[i], a, getDynamicIndex(manifold.body_b));
+			}
+
+			for (unsigned int i = island.joint_start; i < island.joint_start + island.joint_count; ++i)
+			{
+				Joint* joint = joints[island_joints[i]];
+				unsigned int a = getJointBodyIndex(joint->getBodyA());
+				unsigned int b = getJointBodyIndex(joint->getBodyB());
+				if (a == GraphColoring::no_body && b == GraphColoring::no_body)
+					joint_coloring.addOverflow(island_joints[i]);
+				else
+					joint_coloring.add(island_joints[i], a, b);
+			}
+		}
+
+		// a joint holds its bodies together, so it wakes both of them like a closing contact
+		void prestepJoint(Joint* joint, float dt)
+		{
+			unsigned int a = getJointBodyIndex(joint->getBodyA());
+			unsigned int b = getJointBodyIndex(joint->getBodyB());
+			if (a != GraphColoring::no_body && !dynamic_bodies[a].is_awake)
+				dynamic_bodies[a].setAwake();
+			if (b != GraphColoring::no_body && !dynamic_bodies[b].is_awake)
+				dynamic_bodies[b].setAwake();
+			joint->prestep(dt);
+		}
+
+		void applyJointForces()
+		{
+			if (joints.size() < graph_color_size)
+			{
+				for (unsigned int i = 0; i < joints.size(); ++i)
+					joints[i]->applyForces();
+				return;
+			}
+
+			joint_coloring.reset(dynamic_bodies.size());
+			for (unsigned int i = 0; i < joints.size(); ++i)
+			{
+				unsigned int a = getJointBodyIndex(joints[i]->getBodyA());
+				unsigned int b = getJointBodyIndex(joints[i]->getBodyB());
+				if (a == GraphColoring::no_body && b == GraphColoring::no_body)
+					joint_coloring.addOverflow(i);
+				else
+					joint_coloring.add(i, a, b);
+			}
+			joint_coloring.finish();
+
+			forEachColored(joint_coloring, [this](unsigned int i) {
+				joints[i]->applyForces();
+			});
+		}
+
+		/**
+		Calls constraint(i) for every constraint of a coloring, running the colors in order
+		with each one split into chunks over the threads, then the overflow set on this thread
+		*/
+		template<typename Function>
+		void forEachColored(GraphColoring& coloring, const Function& constraint)
+		{
+			const unsigned int chunk_size = 64;
+			for (unsigned int c = 0; c < coloring.num_colors; ++c)
+			{
+				unsigned int start = coloring.getColorStart(c);
+				unsigned int size = coloring.getColorSize(c);
+				runTasks((size + chunk_size - 1) / chunk_size, [&coloring, &constraint, start, size, chunk_size](unsigned int chunk) {
+					unsigned int end = glm::min(start + (chunk + 1) * chunk_size, start + size);
+					for (unsigned int i = start + chunk * chunk_size; i < end; ++i)
+						constraint(coloring.constraints[i]);
+				});
+			}
+
+			unsigned int start = coloring.getOverflowStart();
+			for (unsigned int i = start; i < start + coloring.getOverflowSize(); ++i)
+				constraint(coloring.constraints[i]);
+		}
+
+		// runs task(i) for every i below count, on the thread pool when there is one
+		template<typename Function>
+		void runTasks(unsigned int count, const Function& task)
+		{
+			if (thread_pool)
+				thread_pool->run(count, task);
+			else
+			{
+				for (unsigned int i = 0; i < count; ++i)
+					task(i);
+			}
+		}
+
+		void solveIsland(Island& island, float dt)
+		{
+			unsigned int* manifolds = island_manifolds.data() + island.manifold_start;
+			unsigned int* island_joint = island_joints.data() + island.joint_start;
+
+			for (unsigned int i = 0; i < island.manifold_count; ++i)
+			{
+				ContactManifold& manifold = contact_manifolds[manifolds[i]];
+				if (!manifold.isAsleep())
+					manifold.prestep(dt, block_contacts);
+				else
+					manifold.solver_a = manifold.solver_b = nullptr;
+			}
+			for (unsigned int i = 0; i < island.joint_count; ++i)
+				prestepJoint(joints[island_joint[i]], dt);
+
+			for (unsigned int i = 0; i < island.manifold_count; ++i)
+			{
+				if (contact_manifolds[manifolds[i]].isActive())
+					contact_manifolds[manifolds[i]].warmStart();
+			}
+			for (unsigned int i = 0; i < island.joint_count; ++i)
+				joints[island_joint[i]]->warmStart();
+
+			for (unsigned int x = 0; x < velocity_iters; ++x)
+			{
+				for (unsigned int i = 0; i < island.joint_count; ++i)
+					joints[island_joint[i]]->solveVelocities();
+				for (unsigned int i = 0; i < island.manifold_count; ++i)
+				{
+					if (contact_manifolds[manifolds[i]].isActive())
+						contact_manifolds[manifolds[i]].solveVelocities(block_contacts);
+				}
+			}
+
+			for (unsigned int x = 0; x < position_iters; ++x)
+			{
+				for (unsigned int i = 0; i < island.manifold_count; ++i)
+				{
+					if (contact_manifolds[manifolds[i]].isActive())
+						contact_manifolds[manifolds[i]].solvePositions();
+				}
+			}
+		}
+
+		// a pair that is apart but closing becomes a manifold point with a negative depth,
+		// the solver iterations then only remove the closing velocity that would cross the gap in a substep
+		inline void solveSpeculative(ContactInfo contact, unsigned int child_a, unsigned int child_b)
+		{
+			if (contact.depth < 0.0f)
+				solveContact(contact, child_a, child_b);
+		}
+
+		// substepping the solver relies on speculative points for the pairs that touch during the step
+		inline bool findsSpeculativeContacts()
+		{
+			return speculative_contacts || tgs_substepping;
+		}
+
+		/**
+		Motion of b relative to a over the next substep
+		Bounds are widened by it to find pairs for speculative contacts
+		*/
+		glm::vec3 getRelativeMotion(Body* a, Body* b)
+		{
+			if (!findsSpeculativeContacts())
+				return glm::vec3(0.0f);
+
+			glm::vec3 vel = ((DynamicBody*)b)->vel;
+			if (a->type == BodyType::DYNAMIC)
+				vel -= ((DynamicBody*)a)->vel;
+			return vel * substep_dt;
+		}
+
+		/**
+		Joins the dynamic bodies into islands through their contacts and joints,
+		then groups the bodies and manifolds of each island with a counting sort
+		*/
+		void buildIslands()
+		{
+			unsigned int count = dynamic_bodies.size();
+			island_set.reset(count);
+
+			for (unsigned int i = 0; i < contact_manifolds.size(); ++i)
+			{
+				ContactManifold& manifold = contact_manifolds[i];
+				if (manifold.num_contacts == 0 || manifold.body_a == nullptr || manifold.body_a->type != BodyType::DYNAMIC)
+					continue;
+
+				island_set.join(getDynamicIndex(manifold.body_a), getDynamicIndex(manifold.body_b));
+			}
+
+			for (unsigned int i = 0; i < joints.size(); ++i)
+			{
+				unsigned int a = getJointBodyIndex(joints[i]->getBodyA());
+				unsigned int b = getJointBodyIndex(joints[i]->getBodyB());
+				if (a != GraphColoring::no_body && b != GraphColoring::no_body)
+					island_set.join(a, b);
+			}
+
+			for (unsigned int i = 0; i < articulations.size(); ++i)
+			{
+				Articulation* articulation = articulations[i];
+				for (unsigned int j = 0; j < articulation->links.size(); ++j)
+				{
+					int parent = articulation->links[j].parent;
+					if (parent >= 0)
+						island_set.join(getDynamicIndex(articulation->links[parent].body), getDynamicIndex(articulation->links[j].body));
+				}
+			}
+
+			std::vector<unsigned int> body_island(count);
+			std::vector<unsigned int> island_index(count, (unsigned int)-1); // island of each root
+			islands.clear();
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				unsigned int root = island_set.find(i);
+				if (island_index[root] == (unsigned int)-1)
+				{
+					island_index[root] = islands.size();
+					islands.push_back({ 0, 0, 0, 0, 0, 0, false });
+				}
+				body_island[i] = island_index[root];
+
+				Island& island = islands[body_island[i]];
+				island.count++;
+				island.is_awake |= dynamic_bodies[i].is_awake;
+			}
+
+			// every manifold has a dynamic body b, which decides its island
+			std::vector<unsigned int> manifold_island(contact_manifolds.size());
+			for (unsigned int i = 0; i < contact_manifolds.size(); ++i)
+			{
+				manifold_island[i] = body_island[getDynamicIndex(contact_manifolds[i].body_b)];
+				islands[manifold_island[i]].manifold_count++;
+			}
+
+			// and so does the body b of every joint, or its body a when b is anchored like the ground,
+			// joints that move no dynamic body are left out of the islands
+			std::vector<unsigned int> joint_island(joints.size(), (unsigned int)-1);
+			unsigned int island_joint_count = 0;
+			for (unsigned int i = 0; i < joints.size(); ++i)
+			{
+				unsigned int body = getJointBodyIndex(joints[i]->getBodyB());
+				if (body == GraphColoring::no_body)
+					body = getJointBodyIndex(joints[i]->getBodyA());
+				if (body == GraphColoring::no_body)
+					continue;
+
+				joint_island[i] = body_island[body];
+				islands[joint_island[i]].joint_count++;
+				island_joint_count++;
+			}
+
+			unsigned int start = 0;
+			unsigned int manifold_start = 0;
+			unsigned int joint_start = 0;
+			for (unsigned int i = 0; i < islands.size(); ++i)
+			{
+				islands[i].start = start;
+				islands[i].manifold_start = manifold_start;
+				islands[i].joint_start = joint_start;
+				start += islands[i].count;
+				manifold_start += islands[i].manifold_count;
+				joint_start += islands[i].joint_count;
+				islands[i].count = 0;
+				islands[i].manifold_count = 0;
+				islands[i].joint_count = 0;
+			}
+
+			island_bodies.resize(count);
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				Island& island = islands[body_island[i]];
+				island_bodies[island.start + island.count++] = i;
+			}
+			island_manifolds.resize(contact_manifolds.size());
+			for (unsigned int i = 0; i < contact_manifolds.size(); ++i)
+			{
+				Island& island = islands[manifold_island[i]];
+				island_manifolds[island.manifold_start + island.manifold_count++] = i;
+			}
+			island_joints.resize(island_joint_count);
+			for (unsigned int i = 0; i < joints.size(); ++i)
+			{
+				if (joint_island[i] == (unsigned int)-1)
+					continue;
+				Island& island = islands[joint_island[i]];
+				island_joints[island.joint_start + island.joint_count++] = i;
+			}
+		}
+
+		/**
+		An island falls asleep once all of its bodies are still, and a sleeping island
+		wakes as a whole when any of its bodies was woken or touched by an awake body
+		*/
+		void updateIslandSleep()
+		{
+			for (unsigned int i = 0; i < islands.size(); ++i)
+			{
+				Island& island = islands[i];
+				bool awake = false;
+				bool still = true;
+				for (unsigned int j = island.start; j < island.start + island.count; ++j)
+				{
+					DynamicBody& body = dynamic_bodies[island_bodies[j]];
+					awake |= body.is_awake;
+					still &= body.isStill();
+				}
+
+				if (!awake)
+					continue;
+
+				island.is_awake = !still;
+				for (unsigned int j = island.start; j < island.start + island.count; ++j)
+				{
+					DynamicBody& body = dynamic_bodies[island_bodies[j]];
+					if (still)
+						body.setAsleep();
+					else if (!body.is_awake)
+						body.setAwake();
+				}
+			}
+		}
+
+		inline unsigned int getDynamicIndex(Body* body)
+		{
+			return (unsigned int)((DynamicBody*)body - dynamic_bodies.data());
+		}
+
+		// a joint body that is null or static is left alone by the solver like the ground
+		inline unsigned int getJointBodyIndex(DynamicBody* body)
+		{
+			return body != nullptr && body->type == BodyType::DYNAMIC ? getDynamicIndex(body) : GraphColoring::no_body;
+		}
+
+		unsigned int createBodySlot(unsigned int body)
+		{
+			if (free_body_slots.empty())
+			{
+				body_slots.push_back({ body, 0 });
+				return body_slots.size() - 1;
+			}
+			unsigned int slot = free_body_slots.back();
+			free_body_slots.pop_back();
+			body_slots[slot].body = body;
+			return slot;
+		}
+
+		/**
+		Moves the dynamic bodies to storage twice the size
+		The old storage is kept until every pointer into it has been moved
+		*/
+		void growDynamicBodies()
+		{
+			std::vector<DynamicBody> bodies;
+			bodies.reserve(std::max(dynamic_bodies.capacity() * 2, (size_t)16));
+			bodies.insert(bodies.end(), dynamic_bodies.begin(), dynamic_bodies.end());
+			dynamic_bodies.swap(bodies);
+
+			// bodies holds the old storage now
+			relocateBodies({ bodies.data(), (unsigned int)bodies.size(), dynamic_bodies.data() });
+		}
+
+		// points everything the world keeps at the moved bodies
+		void relocateBodies(const BodyRelocation& relocation)
+		{
+			manifold_lookup.clear();
+			for (unsigned int i = 0; i < contact_manifolds.size(); ++i)
+			{
+				ContactManifold& manifold = contact_manifolds[i];
+				relocation.apply(manifold.body_a);
+				relocation.apply(manifold.body_b);
+				relocation.apply(manifold.solver_a);
+				relocation.apply(manifold.solver_b);
+				manifold_lookup[{ manifold.body_a, manifold.body_b, manifold.child_a, manifold.child_b }] = i;
+			}
+
+			for (unsigned int i = 0; i < joints.size(); ++i)
+				joints[i]->relocateBodies(relocation);
+			for (unsigned int i = 0; i < articulations.size(); ++i)
+				articulations[i]->relocateBodies(relocation);
+
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				std::vector<Body*>& jointed = dynamic_bodies[i].jointed_bodies;
+				for (unsigned int j = 0; j < jointed.size(); ++j)
+					relocation.apply(jointed[j]);
+			}
+
+			// pairs are ordered by address, which the move can change
+			for (unsigned int i = 0; i < sensor_overlaps.size(); ++i)
+			{
+				relocation.apply(sensor_overlaps[i].sensor);
+				relocation.apply(sensor_overlaps[i].body);
+			}
+			std::sort(sensor_overlaps.begin(), sensor_overlaps.end());
+
+			for (unsigned int i = 0; i < sensor_events.size(); ++i)
+			{
+				relocation.apply(sensor_events[i].sensor);
+				relocation.apply(sensor_events[i].body);
+			}
+		}
+
+		// removes manifolds of pairs that were not touching this step
+		void removeStaleManifolds()
+		{
+			for (unsigned int i = 0; i < contact_manifolds.size();)
+			{
+				// the manifolds of a sleeping island are kept so it wakes as a unit
+				if (contact_manifolds[i].collided || contact_manifolds[i].isAsleep())
+				{
+					contact_manifolds[i].collided = false;
+					++i;
+					continue;
+				}
+				removeManifold(i);
+			}
+		}
+
+		// the last manifold takes the place of the removed one
+		void removeManifold(unsigned int i)
+		{
+			ContactManifold& removed = contact_manifolds[i];
+			manifold_lookup.erase({ removed.body_a, removed.body_b, removed.child_a, removed.child_b });
+
+			unsigned int last = contact_manifolds.size() - 1;
+			if (i != last)
+			{
+				contact_manifolds[i] = contact_manifolds[last];
+				ContactManifold& moved = contact_manifolds[i];
+				manifold_lookup[{ moved.body_a, moved.body_b, moved.child_a, moved.child_b }] = i;
+			}
+			contact_manifolds.pop_back();
+		}
+
+		inline glm::vec3 intersectionNormal(Body* a, Body* b)
+		{
+			Sphere* s_a = (Sphere*)a->shapes[0];
+			Sphere* s_b = (Sphere*)b->shapes[0];
+			glm::vec3 dist = b->pos - a->pos;
+			glm::vec3 normal = glm::normalize(dist);
+			float dist2 = dist.x * dist.x + dist.y * dist.y + dist.z * dist.z;
+			float r2 = s_a->rad + s_b->rad;
+			if (dist2 < r2 * r2 && a->pos != b->pos)
+			{
+				float len = r2 - std::sqrtf(dist2);
+				normal *= len;
+				return normal;
+			}
+			return glm::vec3(0.0f, 0.0f, 0.0f);
+		}
+		inline void solveCollision(float m1, float m2, glm::vec3& v1, glm::vec3& v2, glm::vec3& normal)
+		{
+			static float friction = 0.0f;
+			static float restitution = 0.0f;
+
+			float fr = 1 - friction;
+
+			normal = normalize(normal);
+			glm::vec3 lat1 = glm::normalize(glm::cross(normal, glm::vec3(0.57f, 0.51f, 0.13f)));
+			glm::vec3 lat2 = glm::normalize(glm::cross(normal, lat1));
+			
+			float m1m2 = m1 + m2;
+
+			float u1 = glm::dot(normal, v1);
+			float u2 = glm::dot(normal, v2);
+			float l1_1 = glm::dot(lat1, v1);
+			float l2_1 = glm::dot(lat1, v2);
+			float l1_2 = glm::dot(lat2, v1);
+			float l2_2 = glm::dot(lat2, v2);
+
+			float v_1 = ((m1 - m2) / m1m2) * u1 + ((m2 * 2) / m1m2) * u2;
+			float v_2 = ((m1 * 2) / m1m2) * u1 + ((m2 - m1) / m1m2) * u2;
+
+			v1 = (normal * v_1 * restitution) + (lat1 * l1_1 * fr) + (lat2 * l1_2 * fr);
+			v2 = (normal * v_1 * restitution) + (lat1 * l2_1 * fr) + (lat2 * l2_2 * fr);
+		}
+		struct ContinuousImpact
+		{
+			TimeOfImpact toi;
+			Body* body; // static body that was hit, nullptr for the ground
+		};
+
+		/**
+		Moves a fast body back to its first impact with a static body in the substep,
+		resolves the impact, and continues along the new velocity for the rest of the substep
+		Stays at the last impact after ccd_max_impacts
+		*/
+		void solveContinuous(DynamicBody& body, Sweep& sweep, float radius, float dt)
+		{
+			for (unsigned int n = 0; n < ccd_max_impacts; ++n)
+			{
+				ContinuousImpact impact;
+				impact.toi.t = 1.0f;
+				impact.body = nullptr;
+				findFirstImpact(body, sweep, radius, impact);
+
+				if (impact.toi.t >= 1.0f)
+				{
+					sweep.apply(&body, 1.0f);
+					body.updateAABB();
+					return;
+				}
+
+				sweep.apply(&body, impact.toi.t);
+				body.updateInverseInertiaWorld();
+				body.updateAABB();
+
+				ContactInfo contact;
+				contact.collided = true;
+				contact.body_a = impact.body;
+				contact.body_b = &body;
+				contact.normal = impact.toi.normal;
+				contact.poc_a = impact.toi.point_a;
+				contact.poc_b = impact.toi.point_b;
+				contact.poc = (contact.poc_a + contact.poc_b) * 0.5f;
+				contact.depth = 0.0f;
+				if (impact.body == nullptr)
+				{
+					contact.restitution = glm::max(ground_restitution, body.restitution);
+					contact.friction = glm::min(ground_friction, body.friction);
+				}
+				else
+				{
+					contact.restitution = glm::max(impact.body->restitution, body.restitution);
+					contact.friction = glm::min(impact.body->friction, body.friction);
+				}
+
+				// the bodies are still apart at the impact, so it is solved here instead of in a manifold
+				if (static_dynamic_collision_listener != nullptr)
+					static_dynamic_collision_listener(&contact);
+				contact.solveContactStatic();
+
+				// sweep the rest of the substep with the velocity after the impact
+				dt *= 1.0f - impact.toi.t;
+				sweep.pos0 = body.pos;
+				sweep.orientation0 = body.orientation;
+				sweep.pos1 = body.pos + body.vel * dt;
+				sweep.orientation1 = body.orientation;
+				sweep.angle = 0.0f;
+				float angular_speed = glm::length(body.angular_vel);
+				if (!body.rotation_locked && angular_speed > 0.0f)
+				{
+					sweep.angle = angular_speed * dt;
+					sweep.orientation1 = glm::normalize(glm::angleAxis(sweep.angle, body.angular_vel / angular_speed) * body.orientation);
+				}
+			}
+		}
+
+		/**
+		Finds the earliest time of impact of each shape of the body with the planes
+		and the static bodies under its swept bounds
+		*/
+		void findFirstImpact(DynamicBody& body, Sweep& sweep, float radius, ContinuousImpact& impact)
+		{
+			sweep.apply(&body, 0.0f);
+			body.updateAABB();
+			AABB swept = body.aabb;
+			sweep.apply(&body, 1.0f);
+			body.updateAABB();
+			swept.combine(body.aabb);
+
+			for (unsigned int k = 0; k < body.shapes.size(); ++k)
+			{
+				Shape* shape = body.shapes[k];
+
+				if (ground_enabled)
+				{
+					TimeOfImpact toi = timeOfImpactPlane(ground_plane.normal, ground_plane.offset, &body, shape, sweep, radius, impact.toi.t);
+					if (toi.t < impact.toi.t)
+						impact = { toi, nullptr };
+				}
+
+				for (unsigned int i = 0; i < plane_bodies.size(); ++i)
+				{
+					StaticBody& plane_body = plane_bodies[i];
+					if (plane_body.is_sensor || !body.shouldCollide(&plane_body))
+						continue;
+
+					Plane* plane = (Plane*)plane_body.shapes[0];
+					glm::vec3 normal = plane_body.getWorldVec(plane->normal);
+					float offset = plane->offset + glm::dot(normal, plane_body.pos);
+					TimeOfImpact toi = timeOfImpactPlane(normal, offset, &body, shape, sweep, radius, impact.toi.t);
+					if (toi.t < impact.toi.t)
+						impact = { toi, &plane_body };
+				}
+			}
+
+			std::vector<int> hits;
+			if (static_bvh.is_built)
+			{
+				static_bvh.traverse(swept, hits, [&body](StaticBody& other) { return body.shouldCollide(&other); });
+			}
+			else
+			{
+				for (unsigned int i = 0; i < static_bodies.size(); ++i)
+				{
+					if (body.shouldCollide(&static_bodies[i]) && swept.intersects(static_bodies[i].aabb))
+						hits.push_back(i);
+				}
+			}
+
+			std::vector<int> pieces;
+			for (unsigned int i = 0; i < hits.size(); ++i)
+			{
+				StaticBody& static_body = static_bodies[hits[i]];
+
+				AABB local = swept.transform(static_body.orientation_mat_inv, static_body.orientation_mat_inv * -static_body.pos);
+				Shape* static_shape = static_body.shapes[0];
+
+				pieces.clear();
+				if (static_shape->shape_type == ShapeType::TRIANGLE_MESH_TYPE)
+				{
+					((TriangleMesh*)static_shape)->query(local, pieces);
+				}
+				else if (static_shape->shape_type == ShapeType::HEIGHTFIELD_TYPE)
+				{
+					int min_x, min_y, max_x, max_y;
+					Heightfield* heightfield = (Heightfield*)static_shape;
+					if (heightfield->getCellRange(local, min_x, min_y, max_x, max_y))
+					{
+						for (int y = min_y; y <= max_y; ++y)
+						{
+							for (int x = min_x; x <= max_x; ++x)
+							{
+								pieces.push_back((y * heightfield->columns + x) * 2);
+								pieces.push_back((y * heightfield->columns + x) * 2 + 1);
+							}
+						}
+					}
+				}
+				else
+				{
+					std::vector<int> children;
+					static_body.traverseChildren(local, children);
+					for (unsigned int c = 0; c < children.size(); ++c)
+						pieces.push_back(static_body.children[children[c]].index);
+				}
+
+				for (unsigned int j = 0; j < pieces.size(); ++j)
+				{
+					for (unsigned int k = 0; k < body.shapes.size(); ++k)
+					{
+						TimeOfImpact toi;
+						if (static_shape->shape_type == ShapeType::TRIANGLE_MESH_TYPE)
+						{
+							Triangle triangle = ((TriangleMesh*)static_shape)->getTriangle(pieces[j]);
+							toi = timeOfImpact(&static_body, &triangle, &body, body.shapes[k], sweep, radius, impact.toi.t);
+						}
+						else if (static_shape->shape_type == ShapeType::HEIGHTFIELD_TYPE)
+						{
+							Triangle triangle = ((Heightfield*)static_shape)->getTriangle(pieces[j]);
+							toi = timeOfImpact(&static_body, &triangle, &body, body.shapes[k], sweep, radius, impact.toi.t);
+						}
+						else
+						{
+							toi = timeOfImpact(&static_body, static_body.shapes[pieces[j]], &body, body.shapes[k], sweep, radius, impact.toi.t);
+						}
+
+						if (toi.t < impact.toi.t)
+							impact = { toi, &static_body };
+					}
+				}
+			}
+		}
+
+		/**
+		Collides every awake dynamic body with the ground and the plane bodies
+		The bounds of the bodies are gathered once and tested against each plane together
+		*/
+		void collidePlanes()
+		{
+			if (!ground_enabled && plane_bodies.empty())
+				return;
+
+			plane_batch.gather(dynamic_bodies, predicted_aabbs);
+
+			if (ground_enabled)
+				collidePlane(nullptr, ground_plane.normal, ground_plane.offset, nullptr, true);
+
+			for (unsigned int i = 0; i < plane_bodies.size(); ++i)
+			{
+				StaticBody& body = plane_bodies[i];
+				if (body.is_sensor)
+					continue;
+
+				Plane* plane = (Plane*)body.shapes[0];
+				glm::vec3 normal = body.getWorldVec(plane->normal);
+				float offset = plane->offset + glm::dot(normal, body.pos);
+				collidePlane(&body, normal, offset, static_dynamic_collision_listener, true);
+			}
+		}
+
+		void collidePlane(Body* a, const glm::vec3& normal, float offset, void (*listener)(ContactInfo*), bool solve)
+		{
+			std::vector<unsigned int> hits;
+			plane_batch.query(normal, offset, hits);
+
+			for (unsigned int i = 0; i < hits.size(); ++i)
+			{
+				DynamicBody* b = &dynamic_bodies[hits[i]];
+				if (a != nullptr && !b->shouldCollide(a))
+					continue;
+
+				for (unsigned int k = 0; k < b->shapes.size(); ++k)
+				{
+					ContactInfo contact = checkCollisionPlane(a, normal, offset, b, b->shapes[k]);
+					if (!contact.collided)
+					{
+						if (solve && findsSpeculativeContacts())
+							solveSpeculative(contact, 0, k);
+						continue;
+					}
+
+					if (listener != nullptr)
+						listener(&contact);
+					if (solve)
+						solveContact(contact, 0, k);
+				}
+			}
+		}
+
+		inline void solveDynamicStatic(DynamicBody& dynamic_body, StaticBody& static_body)
+		{
+			collideBodies(&static_body, &dynamic_body, static_dynamic_collision_listener, true);
+		}
+
+		/**
+		Finds the bodies overlapping each sensor and buffers enter, stay and exit events
+		Runs once per step after the substeps, so a listener hears of each overlap once per step
+		Pairs where neither side is awake keep their overlap from the last step
+		*/
+		void updateSensors()
+		{
+			sensor_events.clear();
+
+			std::vector<unsigned int> dynamic_sensors;
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				if (dynamic_bodies[i].is_sensor)
+					dynamic_sensors.push_back(i);
+			}
+			std::vector<StaticBody*> plane_sensors;
+			for (unsigned int i = 0; i < plane_bodies.size(); ++i)
+			{
+				if (plane_bodies[i].is_sensor)
+					plane_sensors.push_back(&plane_bodies[i]);
+			}
+
+			if (sensor_bodies.empty() && dynamic_sensors.empty() && plane_sensors.empty() && sensor_overlaps.empty())
+				return;
+
+			std::vector<SensorPair> overlaps;
+			std::vector<int> hits;
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				DynamicBody& body = dynamic_bodies[i];
+				if (body.is_sensor)
+					continue;
+
+				hits.clear();
+				if (sensor_bvh.is_built)
+				{
+					sensor_bvh.traverse(body.aabb, hits);
+				}
+				else
+				{
+					for (unsigned int j = 0; j < sensor_bodies.size(); ++j)
+					{
+						if (body.aabb.intersects(sensor_bodies[j].aabb))
+							hits.push_back(j);
+					}
+				}
+				for (unsigned int j = 0; j < hits.size(); ++j)
+					addSensorOverlap(&sensor_bodies[hits[j]], &body, body.is_awake, overlaps);
+
+				for (unsigned int j = 0; j < plane_sensors.size(); ++j)
+					addSensorOverlap(plane_sensors[j], &body, body.is_awake, overlaps);
+
+				for (unsigned int j = 0; j < dynamic_sensors.size(); ++j)
+				{
+					DynamicBody& sensor = dynamic_bodies[dynamic_sensors[j]];
+					if (body.aabb.intersects(sensor.aabb))
+						addSensorOverlap(&sensor, &body, body.is_awake || sensor.is_awake, overlaps);
+				}
+			}
+
+			// merge with the overlaps of the last step, both are sorted
+			std::sort(overlaps.begin(), overlaps.end());
+			unsigned int i = 0;
+			unsigned int j = 0;
+			while (i < overlaps.size() || j < sensor_overlaps.size())
+			{
+				if (j == sensor_overlaps.size() || (i < overlaps.size() && overlaps[i] < sensor_overlaps[j]))
+				{
+					sensor_events.push_back({ SENSOR_ENTER, overlaps[i].sensor, overlaps[i].body });
+					++i;
+				}
+				else if (i == overlaps.size() || sensor_overlaps[j] < overlaps[i])
+				{
+					sensor_events.push_back({ SENSOR_EXIT, sensor_overlaps[j].sensor, sensor_overlaps[j].body });
+					++j;
+				}
+				else
+				{
+					sensor_events.push_back({ SENSOR_STAY, overlaps[i].sensor, overlaps[i].body });
+					++i;
+					++j;
+				}
+			}
+			sensor_overlaps.swap(overlaps);
+
+			if (sensor_listener != nullptr)
+			{
+				for (unsigned int k = 0; k < sensor_events.size(); ++k)
+					sensor_listener(&sensor_events[k]);
+			}
+		}
+
+		inline void addSensorOverlap(Body* sensor, Body* body, bool moved, std::vector<SensorPair>& overlaps)
+		{
+			if (!body->shouldCollide(sensor))
+				return;
+
+			SensorPair pair = { sensor, body };
+			bool overlapping = moved ? sensorOverlaps(sensor, body) : std::binary_search(sensor_overlaps.begin(), sensor_overlaps.end(), pair);
+			if (overlapping)
+				overlaps.push_back(pair);
+		}
+
+		/**
+		Whether any shape of the body overlaps a shape of the sensor
+		Compound bodies are culled with the child trees like in collideBodies
+		*/
+		bool sensorOverlaps(Body* sensor, Body* body)
+		{
+			if (sensor->shapes[0]->shape_type == ShapeType::PLANE_TYPE)
+			{
+				for (unsigned int k = 0; k < body->shapes.size(); ++k)
+				{
+					if (testOverlap(sensor, sensor->shapes[0], body, body->shapes[k]))
+						return true;
+				}
+				return false;
+			}
+
+			if (sensor->shapes.size() == 1 && body->shapes.size() == 1)
+				return testOverlap(sensor, sensor->shapes[0], body, body->shapes[0]);
+
+			AABB body_in_sensor = body->aabb.transform(sensor->orientation_mat_inv, sensor->orientation_mat_inv * -sensor->pos);
+			std::vector<int> children_sensor;
+			sensor->traverseChildren(body_in_sensor, children_sensor);
+
+			glm::mat3 sensor_to_body = body->orientation_mat_inv * sensor->orientation_mat;
+			glm::vec3 sensor_to_body_pos = body->orientation_mat_inv * (sensor->pos - body->pos);
+
+			std::vector<int> children_body;
+			for (unsigned int i = 0; i < children_sensor.size(); ++i)
+			{
+				ChildShape& child_sensor = sensor->children[children_sensor[i]];
+				AABB child_in_body = child_sensor.aabb.transform(sensor_to_body, sensor_to_body_pos);
+
+				children_body.clear();
+				body->traverseChildren(child_in_body, children_body);
+
+				for (unsigned int j = 0; j < children_body.size(); ++j)
+				{
+					if (testOverlap(sensor, sensor->shapes[child_sensor.index], body, body->shapes[body->children[children_body[j]].index]))
+						return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		Runs narrow phase on each pair of child shapes whose bounds overlap
+		Single shape bodies skip the child trees
+		*/
+		void collideBodies(Body* a, Body* b, void (*listener)(ContactInfo*), bool solve)
+		{
+			if (a->shapes[0]->shape_type == ShapeType::TRIANGLE_MESH_TYPE)
+			{
+				collideMesh(a, (TriangleMesh*)a->shapes[0], b, listener, solve);
+				return;
+			}
+			if (a->shapes[0]->shape_type == ShapeType::HEIGHTFIELD_TYPE)
+			{
+				collideHeightfield(a, (Heightfield*)a->shapes[0], b, listener, solve);
+				return;
+			}
+
+			if (a->shapes.size() == 1 && b->shapes.size() == 1)
+			{
+				collideShapes(a, 0, b, 0, listener, solve);
+				return;
+			}
+
+			glm::vec3 motion = getRelativeMotion(a, b);
+
+			// bounds of b in the coordinates of a
+			AABB b_in_a = b->aabb.sweep(motion).transform(a->orientation_mat_inv, a->orientation_mat_inv * -a->pos);
+			std::vector<int> children_a;
+			a->traverseChildren(b_in_a, children_a);
+
+			// transform from the coordinates of a to the coordinates of b
+			glm::mat3 a_to_b = b->orientation_mat_inv * a->orientation_mat;
+			glm::vec3 a_to_b_pos = b->orientation_mat_inv * (a->pos - b->pos);
+
+			std::vector<int> children_b;
+			for (unsigned int i = 0; i < children_a.size(); ++i)
+			{
+				ChildShape& child_a = a->children[children_a[i]];
+				AABB child_in_b = child_a.aabb.transform(a_to_b, a_to_b_pos).sweep(b->orientation_mat_inv * -motion);
+
+				children_b.clear();
+				b->traverseChildren(child_in_b, children_b);
+
+				for (unsigned int j = 0; j < children_b.size(); ++j)
+					collideShapes(a, child_a.index, b, b->children[children_b[j]].index, listener, solve);
+			}
+		}
+
+		/**
+		Runs narrow phase between each child of b and the mesh triangles under it
+		Manifolds are kept per triangle
+		*/
+		void collideMesh(Body* a, TriangleMesh* mesh, Body* b, void (*listener)(ContactInfo*), bool solve)
+		{
+			// transform from the coordinates of b to the coordinates of the mesh
+			glm::mat3 b_to_a = a->orientation_mat_inv * b->orientation_mat;
+			glm::vec3 b_to_a_pos = a->orientation_mat_inv * (b->pos - a->pos);
+			glm::vec3 motion = a->orientation_mat_inv * getRelativeMotion(a, b);
+
+			std::vector<int> triangles;
+			for (unsigned int i = 0; i < b->children.size(); ++i)
+			{
+				unsigned int child_b = b->children[i].index;
+				AABB child_in_a = b->children[i].aabb.transform(b_to_a, b_to_a_pos).sweep(motion);
+
+				triangles.clear();
+				mesh->query(child_in_a, triangles);
+
+				for (unsigned int j = 0; j < triangles.size(); ++j)
+				{
+					ContactInfo contact = checkCollisionTriangle(a, mesh, triangles[j], b, b->shapes[child_b]);
+					if (!contact.collided)
+					{
+						if (solve && findsSpeculativeContacts())
+							solveSpeculative(checkSeparationTriangle(a, mesh, triangles[j], b, b->shapes[child_b]), triangles[j], child_b);
+						continue;
+					}
+
+					if (listener != nullptr)
+						listener(&contact);
+					if (solve)
+						solveContact(contact, triangles[j], child_b);
+				}
+			}
+		}
+
+		/**
+		Runs narrow phase between each child of b and the cell triangles under it
+		Manifolds are kept per cell triangle
+		*/
+		void collideHeightfield(Body* a, Heightfield* heightfield, Body* b, void (*listener)(ContactInfo*), bool solve)
+		{
+			// transform from the coordinates of b to the coordinates of the heightfield
+			glm::mat3 b_to_a = a->orientation_mat_inv * b->orientation_mat;
+			glm::vec3 b_to_a_pos = a->orientation_mat_inv * (b->pos - a->pos);
+			glm::vec3 motion = a->orientation_mat_inv * getRelativeMotion(a, b);
+
+			for (unsigned int i = 0; i < b->children.size(); ++i)
+			{
+				unsigned int child_b = b->children[i].index;
+				AABB child_in_a = b->children[i].aabb.transform(b_to_a, b_to_a_pos).sweep(motion);
+
+				int min_x, min_y, max_x, max_y;
+				if (!heightfield->getCellRange(child_in_a, min_x, min_y, max_x, max_y))
+					continue;
+
+				for (int y = min_y; y <= max_y; ++y)
+				{
+					for (int x = min_x; x <= max_x; ++x)
+					{
+						for (unsigned int k = 0; k < 2; ++k)
+						{
+							unsigned int triangle = (y * heightfield->columns + x) * 2 + k;
+							ContactInfo contact = checkCollisionHeightfield(a, heightfield, triangle, b, b->shapes[child_b]);
+							if (!contact.collided)
+							{
+								if (solve && findsSpeculativeContacts())
+									solveSpeculative(checkSeparationHeightfield(a, heightfield, triangle, b, b->shapes[child_b]), triangle, child_b);
+								continue;
+							}
+
+							if (listener != nullptr)
+								listener(&contact);
+							if (solve)
+								solveContact(contact, triangle, child_b);
+						}
+					}
+				}
+			}
+		}
+
+		inline void collideShapes(Body* a, unsigned int child_a, Body* b, unsigned int child_b, void (*listener)(ContactInfo*), bool solve)
+		{
+			Shape* shape_a = a->shapes[child_a];
+			Shape* shape_b = b->shapes[child_b];
+
+			ContactInfo contact;
+			contact.collided = false;
+			if (shape_a->shape_type == ShapeType::SPHERE_TYPE &&
+				shape_b->shape_type == ShapeType::SPHERE_TYPE)
+			{
+				contact = checkCollisionSphereSphere(a, (Sphere*)shape_a, b, (Sphere*)shape_b);
+			}
+			else
+			{
+				bool intersecting = GJK(a, shape_a, b, shape_b, glm::vec3(1.0f, 0.0f, 0.0f));
+				if (intersecting)
+					contact = EPA(a, shape_a, b, shape_b);
+			}
+
+			if (contact.collided)
+			{
+				if (listener != nullptr)
+					listener(&contact);
+				if (solve)
+					solveContact(contact, child_a, child_b);
+			}
+			else if (solve && findsSpeculativeContacts())
+			{
+				solveSpeculative(checkSeparation(a, shape_a, b, shape_b), child_a, child_b);
+			}
+		}
 	};
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 
@@ -220,6 +221,16 @@ namespace fiz
 		}
 
 		void traverse(AABB& aabb, std::vector<int>& collisions)
+		{
+			traverse(aabb, collisions, [](T&) { return true; });
+		}
+
+		/**
+		Finds the primitives whose bounds intersect the AABB and that pass the filter,
+		the filter is called before the bounds of a primitive are tested
+		*/
+		template<typename Filter>
+		void traverse(AABB& aabb, std::vector<int>& collisions, Filter filter)
 		{
 			int to_visit[64];
 			int to_visit_offset = 0;
@@ -236,7 +247,8 @@ namespace fiz
 						// intersect AABB with primitives in leaf node
 						for (unsigned int i = 0; i < node->primitive_count; ++i)
 						{
-							if (aabb.intersects((*primitives)[i + node->primitive_offset].aabb))
+							T& primitive = (*primitives)[i + node->primitive_offset];
+							if (filter(primitive) && aabb.intersects(primitive.aabb))
 							{
 								collisions.push_back(i + node->primitive_offset);
 							}
@@ -261,10 +273,52 @@ namespace fiz
 			}
 		}
 
+		/**
+		Finds the primitives whose bounds the ray passes through
+		*/
+		void traverse(const Ray* ray, std::vector<int>& hits)
+		{
+			glm::vec3 inv_dir = { 1.0f / ray->dir.x, 1.0f / ray->dir.y, 1.0f / ray->dir.z };
+			int is_neg[3] = { inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0 };
+
+			int to_visit_offset = 0;
+			int current_node_index = 0;
+			int to_visit[64];
+			while (true)
+			{
+				const LinearBVHNode* node = &nodes[current_node_index];
+
+				if (node->aabb.intersects(ray, inv_dir, is_neg))
+				{
+					if (node->primitive_count > 0)
+					{
+						for (int i = 0; i < node->primitive_count; ++i)
+						{
+							if ((*primitives)[i + node->primitive_offset].aabb.intersects(ray, inv_dir, is_neg))
+								hits.push_back(i + node->primitive_offset);
+						}
+						if (to_visit_offset == 0)
+							break;
+						current_node_index = to_visit[--to_visit_offset];
+					}
+					else
+					{
+						to_visit[to_visit_offset++] = node->second_child_offset;
+						current_node_index = current_node_index + 1;
+					}
+				}
+				else
+				{
+					if (to_visit_offset == 0)
+						break;
+					current_node_index = to_visit[--to_visit_offset];
+				}
+			}
+		}
+
 		float traverse(Ray* ray)
 		{
 			float closest_hit = 9999999.9f;
-			bool hit = false;
 			glm::vec3 inv_dir = { 1.0f / ray->dir.x, 1.0f / ray->dir.y, 1.0f / ray->dir.z };
 			int is_neg[3] = { inv_dir.x < 0, inv_dir.y < 0, inv_dir.z < 0 };
 
@@ -283,13 +337,14 @@ namespace fiz
 						// intersect ray with primitives in leaf
 						for (int i = 0; i < node->primitive_count; ++i)
 						{
-							Ray r = { (*primitives)[i + node->primitive_offset].getLocalPos(ray->start),
-									  (*primitives)[i + node->primitive_offset].getLocalVec(ray->dir) };
-							float dist = (*primitives)[i + node->primitive_offset].shapes[0]->castRay(r);
-							if (dist > 0)
+							T& primitive = (*primitives)[i + node->primitive_offset];
+							Ray r = { primitive.getLocalPos(ray->start),
+									  primitive.getLocalVec(ray->dir) };
+							for (unsigned int j = 0; j < primitive.shapes.size(); ++j)
 							{
-								closest_hit = fmin(closest_hit, dist);
-								hit = true; // change to check against shape, update closest hit
+								float dist = primitive.shapes[j]->castRay(r);
+								if (dist > 0)
+									closest_hit = fmin(closest_hit, dist);
 							}
 						}
 						if (to_visit_offset == 0)
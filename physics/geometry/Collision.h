@@ -1,9 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "../Body.h"
 #include "Shape.h"
+#include "TriangleMesh.h"
+#include "Heightfield.h"
 
 #define trip(a, b) glm::cross(glm::cross(a, b), a)
 
@@ -37,194 +40,90 @@ namespace fiz
 			depth = other.depth;
 		}
 
-		inline glm::mat3 createSkew(glm::vec3 v)
+		// solves a contact against a static body or the ground in a single impulse
+		// penetration is left to the position correction of the manifolds
+		void solveContactStatic()
 		{
-			return { 0.0f,   v.z, -v.y,
-					- v.z,  0.0f,  v.x,
-					  v.y,  -v.x, 0.0f };
+			DynamicBody* b = (DynamicBody*)body_b;
+			solveImpulse(nullptr, b);
 		}
 
-		void solveContactStatic()
+		// solves a contact between two dynamic bodies in a single impulse
+		void solveContactDynamic()
 		{
+			DynamicBody* a = (DynamicBody*)body_a;
 			DynamicBody* b = (DynamicBody*)body_b;
-
-			glm::vec3 rel_poc_b = poc - b->pos;
-
-			float inv_mass = 1.0f / b->mass;
-
-			// create contact transform basis
-			glm::vec3 tangent;
-			if (glm::abs(normal.x) > glm::abs(normal.y))
-				tangent = glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
-			else
-				tangent = glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f));
-			tangent = glm::normalize(tangent);
-			glm::vec3 bitangent = glm::cross(normal, tangent);
-			glm::mat3 contact_to_world = glm::mat3(tangent, bitangent, normal);
-
-			// change in linear velocity
-			glm::mat3 delta_vel_contact = glm::mat3(inv_mass);
-
-			if (!b->rotation_locked)
-			{
-				// create matrix that converts impulse to velocity in world coordinates
-				glm::mat3 impulse_to_torque = createSkew(rel_poc_b);
-				glm::mat3 delta_vel_world = b->inertia_inv_world * impulse_to_torque;
-				delta_vel_world = impulse_to_torque * delta_vel_world;
-				delta_vel_world *= -1.0f;
-
-				// convert change in velocity to contact coordinates
-				delta_vel_contact += glm::transpose(contact_to_world) * delta_vel_world * contact_to_world;
-			}
-
-			// invert to get impulse per unit velocity
-			glm::mat3 impulse_unit_velocity = glm::inverse(delta_vel_contact);
-
-			// get closing velocity at contact
-			glm::vec3 closing_vel = b->getVelocityWorld(poc);
-
-			// closing velocity in contact coordinates
-			glm::vec3 contact_closing_vel = glm::transpose(contact_to_world) * closing_vel;
-
-			// make sure bodies are moving towards each other
-			if (contact_closing_vel.z > 0.0f)
+			if (!solveImpulse(a, b))
 				return;
 
-			// find desired velocity change
-			float d_vel = -contact_closing_vel.z * (1 + restitution);
-
-			// find the target velocity
-			glm::vec3 desired_vel = glm::vec3(-contact_closing_vel.x, -contact_closing_vel.y, d_vel);
-
-			// find the impulse to get target velocity
-			glm::vec3 impulse_contact = impulse_unit_velocity * desired_vel;
-
-			// find impulse on plane
-			float planar_impulse = glm::sqrt(impulse_contact.x * impulse_contact.x + impulse_contact.y * impulse_contact.y);
-
-			// check if it exceeds static friction
-			if (planar_impulse > impulse_contact.z * friction)
-			{
-				// do dynamic friction
-				impulse_contact.x /= planar_impulse;
-				impulse_contact.y /= planar_impulse;
-
-				impulse_contact.z = delta_vel_contact[2].z +
-					delta_vel_contact[2].x * friction * impulse_contact.x +
-					delta_vel_contact[2].y * friction * impulse_contact.y;
-				impulse_contact.z = d_vel / impulse_contact.z;
-				impulse_contact.x *= friction * impulse_contact.z;
-				impulse_contact.y *= friction * impulse_contact.z;
-			}
-
-			// convert impulse to world vector
-			glm::vec3 impulse_world = contact_to_world * impulse_contact;
-
-			// apply impulse
-			b->applyImpulse(impulse_world, poc);
-			b->pos += depth * normal;
+			a->setAwake();
+			b->setAwake();
 		}
 
-		void solveContactDynamic()
+		/**
+		Applies the impulse that stops the closing velocity with restitution, and friction
+		inside the cone it allows, using the scalar effective mass of each row instead of
+		inverting the contact mass matrix. Returns false if the bodies are separating
+		*/
+		bool solveImpulse(DynamicBody* a, DynamicBody* b)
 		{
-			DynamicBody* a = (DynamicBody*)body_a;
-			DynamicBody* b = (DynamicBody*)body_b;
+			glm::vec3 closing_vel = b->getVelocityWorld(poc);
+			if (a)
+				closing_vel -= a->getVelocityWorld(poc);
 
-			glm::vec3 rel_poc_b = poc - b->pos;
+			float normal_vel = glm::dot(normal, closing_vel);
+			if (normal_vel > 0.0f)
+				return false;
 
-			float inv_mass = 1.0f / b->mass + 1.0f / a->mass;
+			float normal_impulse = -normal_vel * (1.0f + restitution) / getInverseMass(a, b, normal);
+			glm::vec3 impulse_world = normal * normal_impulse;
 
-			// create contact transform basis
 			glm::vec3 tangent;
 			if (glm::abs(normal.x) > glm::abs(normal.y))
-				tangent = glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+				tangent = glm::normalize(glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f)));
 			else
-				tangent = glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f));
-			tangent = glm::normalize(tangent);
+				tangent = glm::normalize(glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)));
 			glm::vec3 bitangent = glm::cross(normal, tangent);
-			glm::mat3 contact_to_world = glm::mat3(tangent, bitangent, normal);
-
-			// change in velocity
-			glm::mat3 delta_vel_contact = glm::mat3(inv_mass); // linear component
 
-			glm::mat3 delta_vel_world = glm::mat3(0.0f);
-			if (!b->rotation_locked)
+			float tangent_impulse = -glm::dot(tangent, closing_vel) / getInverseMass(a, b, tangent);
+			float bitangent_impulse = -glm::dot(bitangent, closing_vel) / getInverseMass(a, b, bitangent);
+			float friction_impulse = glm::sqrt(tangent_impulse * tangent_impulse + bitangent_impulse * bitangent_impulse);
+			float max_friction = friction * normal_impulse;
+			if (friction_impulse > max_friction)
 			{
-				// create matrix that converts impulse at poc to velocity in world coordinates
-				glm::mat3 impulse_to_torque = createSkew(rel_poc_b);
-				delta_vel_world = b->inertia_inv_world * impulse_to_torque;
-				delta_vel_world = impulse_to_torque * delta_vel_world;
-				delta_vel_world *= -1.0f;
+				float scale = max_friction / friction_impulse;
+				tangent_impulse *= scale;
+				bitangent_impulse *= scale;
 			}
+			impulse_world += tangent * tangent_impulse + bitangent * bitangent_impulse;
 
-			glm::vec3 rel_poc_a = poc - a->pos;
+			b->applyImpulse(impulse_world, poc);
+			if (a)
+				a->applyImpulse(-impulse_world, poc);
+			return true;
+		}
 
-			if (!a->rotation_locked)
+		/**
+		Change in relative velocity at the contact along dir per unit impulse
+		*/
+		float getInverseMass(DynamicBody* a, DynamicBody* b, const glm::vec3& dir)
+		{
+			float inv_mass = 1.0f / b->mass;
+			if (!b->rotation_locked)
 			{
-				// create matrix that converts impulse to velocity in world coordinates
-				glm::mat3 impulse_to_torque = createSkew(rel_poc_a);
-				glm::mat3 delta_vel_world2 = a->inertia_inv_world * impulse_to_torque;
-				delta_vel_world2 = impulse_to_torque * delta_vel_world2;
-				delta_vel_world2 *= -1.0f;
-
-				// add total change in velocity
-				delta_vel_world += delta_vel_world2;
+				glm::vec3 torque = glm::cross(poc - b->pos, dir);
+				inv_mass += glm::dot(torque, b->inertia_inv_world * torque);
 			}
-
-			// convert change in velocity to contact coordinates
-			delta_vel_contact += glm::transpose(contact_to_world) * delta_vel_world * contact_to_world;
-
-			// invert to get impulse per unit velocity
-			glm::mat3 impulse_unit_velocity = glm::inverse(delta_vel_contact);
-
-			// get closing velocity at contact
-			glm::vec3 closing_vel = b->getVelocityWorld(poc);
-			closing_vel -= a->getVelocityWorld(poc);
-
-			// closing velocity in contact coordinates (transpose = inverse)
-			glm::vec3 contact_closing_vel = glm::transpose(contact_to_world) * closing_vel;
-
-			// make sure bodies are moving towards each other
-			if (contact_closing_vel.z > 0.0f)
-				return;
-
-			// find desired velocity change
-			float d_vel = -contact_closing_vel.z * (1 + restitution);
-
-			// find the target velocity
-			glm::vec3 desired_vel = glm::vec3(-contact_closing_vel.x, -contact_closing_vel.y, d_vel);
-
-			// find the impulse to get target velocity
-			glm::vec3 impulse_contact = impulse_unit_velocity * desired_vel;
-
-			// find impulse on plane
-			float planar_impulse = glm::sqrt(impulse_contact.x * impulse_contact.x + impulse_contact.y * impulse_contact.y);
-
-			// check if it exceeds static friction
-			if (planar_impulse > impulse_contact.z * friction)
+			if (a)
 			{
-				// do dynamic friction
-				impulse_contact.x /= planar_impulse;
-				impulse_contact.y /= planar_impulse;
-
-				impulse_contact.z = delta_vel_contact[2].z +
-					delta_vel_contact[2].x * friction * impulse_contact.x +
-					delta_vel_contact[2].y * friction * impulse_contact.y;
-				impulse_contact.z = d_vel / impulse_contact.z;
-				impulse_contact.x *= friction * impulse_contact.z;
-				impulse_contact.y *= friction * impulse_contact.z;
+				inv_mass += 1.0f / a->mass;
+				if (!a->rotation_locked)
+				{
+					glm::vec3 torque = glm::cross(poc - a->pos, dir);
+					inv_mass += glm::dot(torque, a->inertia_inv_world * torque);
+				}
 			}
-
-			// convert impulse to world vector
-			glm::vec3 impulse_world = contact_to_world * impulse_contact;
-
-			a->setAwake();
-			b->setAwake();
-			// apply impulse
-			b->applyImpulse(impulse_world, poc);
-			a->applyImpulse(-impulse_world, poc);
-			b->pos += depth * normal * 0.5f;
-			a->pos -= depth * normal * 0.5f;
+			return inv_mass;
 		}
 
 		//void solveContact()
@@ -300,28 +199,639 @@ namespace fiz
 		//}
 	};
 
+	// contact points further apart than this are considered separate points
+	inline float contact_matching_threshold = 0.02f;
+	// contact points that drift further than this from their original position are removed
+	inline float contact_breaking_threshold = 0.02f;
+
+	// penetration left alone by the solver so resting contacts don't jitter
+	inline float contact_slop = 0.005f;
+	// fraction of the penetration beyond the slop removed in each substep by the position correction
+	inline float contact_correction = 0.8f;
+	// most penetration removed from a point in one substep, so deep overlaps separate over a few substeps
+	inline float contact_max_correction = 0.02f;
+	// contacts closing slower than this don't bounce, so resting bodies come to rest
+	inline float restitution_threshold = 1.0f;
+	// added to the diagonal of the block solver matrix relative to its size, the 4 points of a face
+	// only have 3 degrees of freedom between them so without it the matrix is singular
+	inline float block_regularization = 0.001f;
+
+	/**
+	Persistent set of up to 4 contact points between a pair of bodies
+	Points are stored in the local coordinates of each body so they can be
+	refreshed as the bodies move instead of being regenerated every step
+	*/
 	struct ContactManifold
 	{
-		bool collided;
+		bool collided; // a contact was added this step
 
-		Body* body_a;
-		Body* body_b;
+		Body* body_a; // may be static, dynamic, or nullptr for the ground
+		Body* body_b; // always dynamic
+
+		// index of the touching shape in each body
+		unsigned int child_a;
+		unsigned int child_b;
 
-		glm::vec3 normal;
+		glm::vec3 normal; // from a to b
+
+		float friction;
+		float restitution;
 
 		unsigned int num_contacts;
 		glm::vec3 local_a[4];
 		glm::vec3 local_b[4];
+		float depth[4];
+
+		// impulses accumulated by the solver, kept while a point persists to warm start the next step
+		float normal_impulse[4];
+		float tangent_impulse[4];
+		float bitangent_impulse[4];
+		float push_impulse[4]; // accumulated by the position correction
+
+		// solver data computed once per substep by prestep
+		DynamicBody* solver_a; // null for static or sleeping bodies, which don't move
+		DynamicBody* solver_b;
+		glm::vec3 tangent;
+		glm::vec3 bitangent;
+		glm::vec3 r_a[4]; // from each center of mass to the point
+		glm::vec3 r_b[4];
+		float normal_mass[4];
+		float tangent_mass[4];
+		float bitangent_mass[4];
+		float velocity_bias[4];
+		float position_bias[4]; // pseudo velocity that removes the penetration, kept out of the real velocities
+		float normal_block[4][4]; // change in normal velocity at each point per unit impulse at each point, for block solving
+
+		ContactManifold(Body* body_a, Body* body_b, unsigned int child_a, unsigned int child_b) : collided(false), body_a(body_a), body_b(body_b), child_a(child_a), child_b(child_b), normal(0.0f, 0.0f, 1.0f), friction(0.2f), restitution(0.2f), num_contacts(0), solver_a(nullptr), solver_b(nullptr)
+		{
+
+		}
+
+		glm::vec3 getWorldA(unsigned int i)
+		{
+			return body_a ? body_a->getWorldPos(local_a[i]) : local_a[i];
+		}
+
+		glm::vec3 getWorldB(unsigned int i)
+		{
+			return body_b->getWorldPos(local_b[i]);
+		}
 
 		void addContact(ContactInfo& contact)
 		{
-			// find contact point with deepest penetration
-			// try to maximize surface area
+			collided = true;
+			friction = contact.friction;
+			restitution = contact.restitution;
+
+			// a large change in normal means a different feature is touching
+			if (num_contacts > 0 && glm::dot(normal, contact.normal) < 0.95f)
+				num_contacts = 0;
+			normal = contact.normal;
+
+			glm::vec3 new_local_a = body_a ? body_a->getLocalPos(contact.poc_a) : contact.poc_a;
+			glm::vec3 new_local_b = body_b->getLocalPos(contact.poc_b);
+
+			// replace the closest existing point if the new point is close enough
+			int index = -1;
+			float closest = contact_matching_threshold * contact_matching_threshold;
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				glm::vec3 diff = local_b[i] - new_local_b;
+				float dist2 = glm::dot(diff, diff);
+				if (dist2 < closest)
+				{
+					closest = dist2;
+					index = i;
+				}
+			}
+
+			if (index < 0)
+			{
+				if (num_contacts < 4)
+					index = num_contacts++;
+				else
+					index = findReplacedContact(contact.poc_b, contact.depth);
+
+				normal_impulse[index] = 0.0f;
+				tangent_impulse[index] = 0.0f;
+				bitangent_impulse[index] = 0.0f;
+				push_impulse[index] = 0.0f;
+			}
+
+			local_a[index] = new_local_a;
+			local_b[index] = new_local_b;
+			depth[index] = contact.depth;
+		}
+
+		void updateContacts()
+		{
+			// remove contact if too far away
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				glm::vec3 world_a = getWorldA(i);
+				glm::vec3 world_b = getWorldB(i);
+				glm::vec3 diff = world_a - world_b;
+				depth[i] = glm::dot(diff, normal);
+
+				// drifted apart along the normal
+				bool remove = depth[i] < -contact_breaking_threshold;
+
+				// drifted apart along the contact plane
+				glm::vec3 planar = diff - normal * depth[i];
+				if (glm::dot(planar, planar) > contact_breaking_threshold * contact_breaking_threshold)
+					remove = true;
+
+				if (remove)
+				{
+					removeContact(i);
+					i--;
+				}
+			}
+		}
+
+		/**
+		Moves the depths along with the bodies through the local anchors, without dropping points
+		Used between substeps that reuse the contacts of one detection pass
+		*/
+		void updateDepths()
+		{
+			for (unsigned int i = 0; i < num_contacts; ++i)
+				depth[i] = glm::dot(getWorldA(i) - getWorldB(i), normal);
+		}
+
+		ContactInfo getContact(unsigned int i)
+		{
+			ContactInfo contact;
+			contact.collided = true;
+			contact.body_a = body_a;
+			contact.body_b = body_b;
+			contact.poc_a = getWorldA(i);
+			contact.poc_b = getWorldB(i);
+			contact.poc = (contact.poc_a + contact.poc_b) * 0.5f;
+			contact.normal = normal;
+			contact.depth = glm::dot(contact.poc_a - contact.poc_b, normal);
+			contact.friction = friction;
+			contact.restitution = restitution;
+			return contact;
+		}
+
+		/**
+		Computes the lever arms, effective masses and target velocities of each point
+		Run once per substep before the velocity and position iterations, which then only apply impulses
+		A sleeping body is treated as static unless the other body is closing on it
+		block also fills normal_block for solveVelocities to solve the normals together
+		*/
+		void prestep(float dt, bool block = false)
+		{
+			solver_a = body_a != nullptr && body_a->type == BodyType::DYNAMIC ? (DynamicBody*)body_a : nullptr;
+			solver_b = (DynamicBody*)body_b;
+
+			if (glm::abs(normal.x) > glm::abs(normal.y))
+				tangent = glm::normalize(glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f)));
+			else
+				tangent = glm::normalize(glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)));
+			bitangent = glm::cross(normal, tangent);
+
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				glm::vec3 poc = (getWorldA(i) + getWorldB(i)) * 0.5f;
+				r_a[i] = solver_a ? poc - solver_a->pos : glm::vec3(0.0f);
+				r_b[i] = poc - solver_b->pos;
+			}
+
+			// wake a sleeping body only when it is being hit
+			if (solver_a && (!solver_a->is_awake || !solver_b->is_awake))
+			{
+				bool closing = false;
+				for (unsigned int i = 0; i < num_contacts; ++i)
+					closing |= glm::dot(getRelativeVelocity(i), normal) < 0.0f;
+
+				if (closing)
+				{
+					solver_a->setAwake();
+					solver_b->setAwake();
+				}
+			}
+			if (solver_a && !solver_a->is_awake)
+				solver_a = nullptr;
+			if (!solver_b->is_awake)
+				solver_b = nullptr;
+
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				normal_mass[i] = 1.0f / getInverseMass(i, normal);
+				tangent_mass[i] = 1.0f / getInverseMass(i, tangent);
+				bitangent_mass[i] = 1.0f / getInverseMass(i, bitangent);
+
+				// points that are still apart may close the gap within the substep,
+				// penetration is left to the position correction so it adds no energy
+				velocity_bias[i] = glm::min(depth[i], 0.0f) / dt;
+				position_bias[i] = glm::min(contact_correction * glm::max(depth[i] - contact_slop, 0.0f), contact_max_correction) / dt;
+
+				float normal_vel = glm::dot(getRelativeVelocity(i), normal);
+				if (normal_vel < -restitution_threshold)
+					velocity_bias[i] = glm::max(velocity_bias[i], -restitution * normal_vel);
+			}
+
+			if (block && num_contacts > 1)
+			{
+				for (unsigned int i = 0; i < num_contacts; ++i)
+				{
+					for (unsigned int j = i; j < num_contacts; ++j)
+					{
+						normal_block[i][j] = getCrossInverseMass(i, j);
+						normal_block[j][i] = normal_block[i][j];
+					}
+					normal_block[i][i] *= 1.0f + block_regularization;
+				}
+			}
+		}
+
+		/**
+		Applies the impulses accumulated in the last step so the iterations start near the solution
+		The pushes are warm started too, a resting stack keeps needing about the same
+		correction each substep and the colored order is too slow to find it from zero
+		*/
+		void warmStart()
+		{
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				glm::vec3 impulse = normal * normal_impulse[i] + tangent * tangent_impulse[i] + bitangent * bitangent_impulse[i];
+				applyImpulse(i, impulse);
+				applyPseudoImpulse(i, normal * push_impulse[i]);
+			}
+		}
+
+		/**
+		One iteration of sequential impulses over the points
+		The accumulated normal impulse is kept positive and friction is kept inside the cone it allows
+		block solves the normals of all points together after their friction, see solveNormalsBlock
+		*/
+		void solveVelocities(bool block = false)
+		{
+			if (block && num_contacts > 1)
+			{
+				for (unsigned int i = 0; i < num_contacts; ++i)
+					solveFriction(i);
+				if (!solveNormalsBlock())
+				{
+					for (unsigned int i = 0; i < num_contacts; ++i)
+						solveNormal(i);
+				}
+				return;
+			}
+
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				solveFriction(i);
+				solveNormal(i);
+			}
+		}
+
+		/**
+		Solves the normal impulses of all points at once as a small LCP by total enumeration
+		Each subset of the points is tried as the touching set, and the answer is the one where the
+		touching points all push and the others are all separating. Points that rock a box from
+		corner to corner settle in one iteration instead of passing the load back and forth
+		Returns false when no subset works, which only rounding on a badly conditioned matrix causes
+		*/
+		bool solveNormalsBlock()
+		{
+			// velocity each point would have with no normal impulse at all, minus its target
+			float free_vel[4];
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				free_vel[i] = glm::dot(getRelativeVelocity(i), normal) - velocity_bias[i];
+				for (unsigned int j = 0; j < num_contacts; ++j)
+					free_vel[i] -= normal_block[i][j] * normal_impulse[j];
+			}
+
+			// the matrix is positive definite so exactly one subset works, the whole set is tried first since it is the most common
+			for (unsigned int set = (1u << num_contacts) - 1; set != (unsigned int)-1; --set)
+			{
+				float impulse[4];
+				if (!solveBlockSubset(set, free_vel, impulse))
+					continue;
+
+				bool valid = true;
+				for (unsigned int i = 0; i < num_contacts && valid; ++i)
+				{
+					if (set & (1u << i))
+						valid = impulse[i] >= 0.0f;
+					else
+					{
+						float vel = free_vel[i];
+						for (unsigned int j = 0; j < num_contacts; ++j)
+							vel += normal_block[i][j] * impulse[j];
+						valid = vel >= -0.00001f;
+					}
+				}
+				if (!valid)
+					continue;
+
+				for (unsigned int i = 0; i < num_contacts; ++i)
+				{
+					applyImpulse(i, normal * (impulse[i] - normal_impulse[i]));
+					normal_impulse[i] = impulse[i];
+				}
+				return true;
+			}
+			return false;
+		}
+
+		/**
+		One iteration of the position correction, the normal rows solved again on the pseudo velocities
+		Pushes penetrating points apart without changing the momentum of the bodies, so resting
+		contacts don't bounce and deep overlaps don't launch the bodies
+		*/
+		void solvePositions()
+		{
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				float lambda = normal_mass[i] * (position_bias[i] - glm::dot(getRelativePseudoVelocity(i), normal));
+				float old_push = push_impulse[i];
+				push_impulse[i] = glm::max(old_push + lambda, 0.0f);
+				applyPseudoImpulse(i, normal * (push_impulse[i] - old_push));
+			}
+		}
+
+		bool isActive()
+		{
+			return num_contacts > 0 && (solver_a != nullptr || solver_b != nullptr);
+		}
+
+		// both bodies are sleeping or static, the manifold is left alone until its island wakes
+		bool isAsleep()
+		{
+			bool asleep_a = body_a == nullptr || body_a->type != BodyType::DYNAMIC || !((DynamicBody*)body_a)->is_awake;
+			return asleep_a && !((DynamicBody*)body_b)->is_awake;
+		}
+
+	private:
+		// one friction row of a point, kept inside the cone of its normal impulse
+		void solveFriction(unsigned int i)
+		{
+			glm::vec3 rel_vel = getRelativeVelocity(i);
+			float max_friction = friction * normal_impulse[i];
+			float old_tangent = tangent_impulse[i];
+			float old_bitangent = bitangent_impulse[i];
+			tangent_impulse[i] -= glm::dot(rel_vel, tangent) * tangent_mass[i];
+			bitangent_impulse[i] -= glm::dot(rel_vel, bitangent) * bitangent_mass[i];
+
+			float friction_impulse = glm::sqrt(tangent_impulse[i] * tangent_impulse[i] + bitangent_impulse[i] * bitangent_impulse[i]);
+			if (friction_impulse > max_friction)
+			{
+				float scale = max_friction / friction_impulse;
+				tangent_impulse[i] *= scale;
+				bitangent_impulse[i] *= scale;
+			}
+			applyImpulse(i, tangent * (tangent_impulse[i] - old_tangent) + bitangent * (bitangent_impulse[i] - old_bitangent));
+		}
+
+		// one normal row of a point, the accumulated impulse is kept positive
+		void solveNormal(unsigned int i)
+		{
+			glm::vec3 rel_vel = getRelativeVelocity(i);
+			float lambda = normal_mass[i] * (velocity_bias[i] - glm::dot(rel_vel, normal));
+			float old_normal = normal_impulse[i];
+			normal_impulse[i] = glm::max(old_normal + lambda, 0.0f);
+			applyImpulse(i, normal * (normal_impulse[i] - old_normal));
+		}
+
+		/**
+		Finds the impulses that stop the points in set, with the other points getting none
+		Gaussian elimination on the rows and columns of normal_block picked by set
+		*/
+		bool solveBlockSubset(unsigned int set, const float* free_vel, float* impulse)
+		{
+			unsigned int index[4];
+			unsigned int n = 0;
+			for (unsigned int i = 0; i < num_contacts; ++i)
+			{
+				impulse[i] = 0.0f;
+				if (set & (1u << i))
+					index[n++] = i;
+			}
+
+			float m[4][5];
+			for (unsigned int r = 0; r < n; ++r)
+			{
+				for (unsigned int c = 0; c < n; ++c)
+					m[r][c] = normal_block[index[r]][index[c]];
+				m[r][n] = -free_vel[index[r]];
+			}
+
+			for (unsigned int c = 0; c < n; ++c)
+			{
+				unsigned int pivot = c;
+				for (unsigned int r = c + 1; r < n; ++r)
+				{
+					if (glm::abs(m[r][c]) > glm::abs(m[pivot][c]))
+						pivot = r;
+				}
+				if (glm::abs(m[pivot][c]) < 1e-12f)
+					return false;
+				if (pivot != c)
+				{
+					for (unsigned int k = c; k <= n; ++k)
+						std::swap(m[c][k], m[pivot][k]);
+				}
+
+				for (unsigned int r = c + 1; r < n; ++r)
+				{
+					float factor = m[r][c] / m[c][c];
+					for (unsigned int k = c; k <= n; ++k)
+						m[r][k] -= factor * m[c][k];
+				}
+			}
+
+			for (unsigned int r = n; r-- > 0;)
+			{
+				float sum = m[r][n];
+				for (unsigned int c = r + 1; c < n; ++c)
+					sum -= m[r][c] * impulse[index[c]];
+				impulse[index[r]] = sum / m[r][r];
+			}
+			return true;
+		}
+
+		// velocity of b relative to a at a point
+		inline glm::vec3 getRelativeVelocity(unsigned int i)
+		{
+			glm::vec3 vel(0.0f);
+			if (solver_b)
+				vel += solver_b->vel + glm::cross(solver_b->angular_vel, r_b[i]);
+			if (solver_a)
+				vel -= solver_a->vel + glm::cross(solver_a->angular_vel, r_a[i]);
+			return vel;
+		}
+
+		inline glm::vec3 getRelativePseudoVelocity(unsigned int i)
+		{
+			glm::vec3 vel(0.0f);
+			if (solver_b)
+				vel += solver_b->pseudo_vel + glm::cross(solver_b->pseudo_angular_vel, r_b[i]);
+			if (solver_a)
+				vel -= solver_a->pseudo_vel + glm::cross(solver_a->pseudo_angular_vel, r_a[i]);
+			return vel;
+		}
+
+		// change in relative velocity at a point along dir per unit impulse
+		float getInverseMass(unsigned int i, const glm::vec3& dir)
+		{
+			float inv_mass = 0.0f;
+			if (solver_b)
+			{
+				inv_mass += 1.0f / solver_b->mass;
+				if (!solver_b->rotation_locked)
+				{
+					glm::vec3 torque = glm::cross(r_b[i], dir);
+					inv_mass += glm::dot(torque, solver_b->inertia_inv_world * torque);
+				}
+			}
+			if (solver_a)
+			{
+				inv_mass += 1.0f / solver_a->mass;
+				if (!solver_a->rotation_locked)
+				{
+					glm::vec3 torque = glm::cross(r_a[i], dir);
+					inv_mass += glm::dot(torque, solver_a->inertia_inv_world * torque);
+				}
+			}
+			return inv_mass;
+		}
+
+		// change in normal velocity at point i per unit normal impulse at point j
+		float getCrossInverseMass(unsigned int i, unsigned int j)
+		{
+			float inv_mass = 0.0f;
+			if (solver_b)
+			{
+				inv_mass += 1.0f / solver_b->mass;
+				if (!solver_b->rotation_locked)
+					inv_mass += glm::dot(glm::cross(r_b[i], normal), solver_b->inertia_inv_world * glm::cross(r_b[j], normal));
+			}
+			if (solver_a)
+			{
+				inv_mass += 1.0f / solver_a->mass;
+				if (!solver_a->rotation_locked)
+					inv_mass += glm::dot(glm::cross(r_a[i], normal), solver_a->inertia_inv_world * glm::cross(r_a[j], normal));
+			}
+			return inv_mass;
+		}
+
+		// applies an impulse to b at a point and the opposite impulse to a
+		inline void applyImpulse(unsigned int i, const glm::vec3& impulse)
+		{
+			if (solver_b)
+			{
+				solver_b->vel += impulse / solver_b->mass;
+				if (!solver_b->rotation_locked)
+					solver_b->angular_vel += solver_b->inertia_inv_world * glm::cross(r_b[i], impulse);
+			}
+			if (solver_a)
+			{
+				solver_a->vel -= impulse / solver_a->mass;
+				if (!solver_a->rotation_locked)
+					solver_a->angular_vel -= solver_a->inertia_inv_world * glm::cross(r_a[i], impulse);
+			}
+		}
+
+		inline void applyPseudoImpulse(unsigned int i, const glm::vec3& impulse)
+		{
+			if (solver_b)
+			{
+				solver_b->pseudo_vel += impulse / solver_b->mass;
+				if (!solver_b->rotation_locked)
+					solver_b->pseudo_angular_vel += solver_b->inertia_inv_world * glm::cross(r_b[i], impulse);
+			}
+			if (solver_a)
+			{
+				solver_a->pseudo_vel -= impulse / solver_a->mass;
+				if (!solver_a->rotation_locked)
+					solver_a->pseudo_angular_vel -= solver_a->inertia_inv_world * glm::cross(r_a[i], impulse);
+			}
+		}
+
+		void removeContact(unsigned int i)
+		{
+			num_contacts--;
+			local_a[i] = local_a[num_contacts];
+			local_b[i] = local_b[num_contacts];
+			depth[i] = depth[num_contacts];
+			normal_impulse[i] = normal_impulse[num_contacts];
+			tangent_impulse[i] = tangent_impulse[num_contacts];
+			bitangent_impulse[i] = bitangent_impulse[num_contacts];
+			push_impulse[i] = push_impulse[num_contacts];
+		}
+
+		// finds the point to replace with a new point so that the deepest point is kept and area is maximized
+		unsigned int findReplacedContact(glm::vec3 new_world_b, float new_depth)
+		{
+			unsigned int deepest = 4;
+			float max_depth = new_depth;
+			for (unsigned int i = 0; i < 4; ++i)
+			{
+				if (depth[i] > max_depth)
+				{
+					max_depth = depth[i];
+					deepest = i;
+				}
+			}
+
+			glm::vec3 p[4];
+			for (unsigned int i = 0; i < 4; ++i)
+				p[i] = getWorldB(i);
+
+			unsigned int replaced = 0;
+			float max_area = -1.0f;
+			for (unsigned int i = 0; i < 4; ++i)
+			{
+				if (i == deepest)
+					continue;
+
+				// area of the quad formed when point i is replaced by the new point
+				glm::vec3 q[4] = { p[0], p[1], p[2], p[3] };
+				q[i] = new_world_b;
+				float area = quadArea(q[0], q[1], q[2], q[3]);
+				if (area > max_area)
+				{
+					max_area = area;
+					replaced = i;
+				}
+			}
+			return replaced;
+		}
+
+		// approximate area of a quad with unknown vertex order (largest of the diagonal crosses)
+		inline float quadArea(glm::vec3& a, glm::vec3& b, glm::vec3& c, glm::vec3& d)
+		{
+			float area_0 = glm::length(glm::cross(a - b, c - d));
+			float area_1 = glm::length(glm::cross(a - c, b - d));
+			float area_2 = glm::length(glm::cross(a - d, b - c));
+			return glm::max(area_0, glm::max(area_1, area_2));
+		}
+	};
+
+	struct ManifoldKey
+	{
+		Body* a;
+		Body* b;
+		unsigned int child_a;
+		unsigned int child_b;
+
+		bool operator==(const ManifoldKey& other) const
+		{
+			return a == other.a && b == other.b && child_a == other.child_a && child_b == other.child_b;
 		}
+	};
 
-		void updateContacts()
+	struct ManifoldKeyHash
+	{
+		size_t operator()(const ManifoldKey& key) const
 		{
-			// remove contact if too far away
+			size_t hash = std::hash<Body*>()(key.a) ^ (std::hash<Body*>()(key.b) * 31);
+			return hash ^ ((size_t)key.child_a * 73856093) ^ ((size_t)key.child_b * 19349663);
 		}
 	};
 
@@ -570,18 +1080,72 @@ namespace fiz
 
 	Simplex s;
 
-	glm::vec3 support(Body* a, const glm::vec3& axis)
+	glm::vec3 support(Body* a, Shape* shape, const glm::vec3& axis)
 	{
 		glm::vec3 local_axis = a->getLocalVec(axis);
-		return a->getWorldVec(a->shapes[0]->support(local_axis)) + a->pos;
+		return a->getWorldVec(shape->support(local_axis)) + a->pos;
 	}
 
-	bool GJK(Body* body_a, Body* body_b, glm::vec3 axis)
+	glm::vec3 support(Body* a, const glm::vec3& axis)
+	{
+		return support(a, a->shapes[0], axis);
+	}
+
+	/**
+	Support of a shape whose type is known at compile time
+	The shape classes are final, so the call is direct and can be inlined
+	*/
+	template <typename ShapeT>
+	inline glm::vec3 support(Body* a, ShapeT* shape, const glm::vec3& axis)
+	{
+		return a->orientation_mat * shape->support(a->orientation_mat_inv * axis) + a->pos;
+	}
+
+	/**
+	Calls function with the shape cast to its own type
+	Shapes without a case, like user defined shapes, are passed as Shape and use the virtual support
+	*/
+	template <typename Function>
+	inline auto dispatchShape(Shape* shape, Function function)
+	{
+		switch (shape->shape_type)
+		{
+		case ShapeType::SPHERE_TYPE:
+			return function((Sphere*)shape);
+		case ShapeType::BOX_TYPE:
+			return function((Box*)shape);
+		case ShapeType::CYLINDER_TYPE:
+			return function((Cylinder*)shape);
+		case ShapeType::CAPSULE_TYPE:
+			return function((Capsule*)shape);
+		case ShapeType::POLYHEDRON_TYPE:
+			return function((Polyhedron*)shape);
+		case ShapeType::TRIANGLE_TYPE:
+			return function((Triangle*)shape);
+		default:
+			return function(shape);
+		}
+	}
+
+	/**
+	Calls function with both shapes cast to their own types,
+	so a kernel templated on the shapes is instantiated for each pair of types
+	*/
+	template <typename Function>
+	inline auto dispatchShapes(Shape* shape_a, Shape* shape_b, Function function)
+	{
+		return dispatchShape(shape_a, [&](auto* a) {
+			return dispatchShape(shape_b, [&](auto* b) {
+				return function(a, b);
+			});
+		});
+	}
+
+	template <typename ShapeA, typename ShapeB>
+	bool GJKKernel(Body* body_a, ShapeA* shape_a, Body* body_b, ShapeB* shape_b, glm::vec3 axis)
 	{
-		Shape* a = body_a->shapes[0];
-		Shape* b = body_b->shapes[0];
-		glm::vec3 A_a = support(body_a, axis);
-		glm::vec3 A_b = support(body_b, -axis);
+		glm::vec3 A_a = support(body_a, shape_a, axis);
+		glm::vec3 A_b = support(body_b, shape_b, -axis);
 		glm::vec3 A = A_a - A_b;//a->support(axis) - b->support(-axis);
 		s.clear();
 		s.add(A, A_a, A_b);
@@ -592,8 +1156,8 @@ namespace fiz
 		while (iters < 50)
 		{
 			++iters;
-			A_a = support(body_a, D);
-			A_b = support(body_b, -D);
+			A_a = support(body_a, shape_a, D);
+			A_b = support(body_b, shape_b, -D);
 			A = A_a - A_b;//a->support(D) - b->support(-D);
 			if (glm::dot(A, D) < 0)
 				return false;
@@ -800,9 +1364,22 @@ namespace fiz
 		return false;
 	}
 
+	bool GJK(Body* body_a, Shape* shape_a, Body* body_b, Shape* shape_b, glm::vec3 axis)
+	{
+		return dispatchShapes(shape_a, shape_b, [&](auto* a, auto* b) {
+			return GJKKernel(body_a, a, body_b, b, axis);
+		});
+	}
+
+	bool GJK(Body* body_a, Body* body_b, glm::vec3 axis)
+	{
+		return GJK(body_a, body_a->shapes[0], body_b, body_b->shapes[0], axis);
+	}
+
 	Polytope p;
 
-	ContactInfo EPA(Body* a, Body* b)
+	template <typename ShapeA, typename ShapeB>
+	ContactInfo EPAKernel(Body* a, ShapeA* shape_a, Body* b, ShapeB* shape_b)
 	{
 		p.set(s);
 
@@ -815,8 +1392,8 @@ namespace fiz
 			glm::vec3 D = p.normals[closest_face];
 
 			// find the point furthest in that direction on Minkowski difference
-			glm::vec3 A_a = support(a, D);
-			glm::vec3 A_b = support(b, -D);
+			glm::vec3 A_a = support(a, shape_a, D);
+			glm::vec3 A_b = support(b, shape_b, -D);
 			glm::vec3 A = A_a - A_b;//a->support(D) - b->support(-D);
 
 			// find how far that point is from the face
@@ -853,8 +1430,13 @@ namespace fiz
 				float d20 = glm::dot(v2, v0);
 				float d21 = glm::dot(v2, v1);
 				float denom = d00 * d11 - d01 * d01;
-				float v = (d11 * d20 - d01 * d21) / denom;
-				float w = (d00 * d21 - d01 * d20) / denom;
+				float v = 1.0f / 3.0f;
+				float w = 1.0f / 3.0f;
+				if (denom > 0.0000001f) // degenerate faces use the centroid
+				{
+					v = (d11 * d20 - d01 * d21) / denom;
+					w = (d00 * d21 - d01 * d20) / denom;
+				}
 				float u = 1.0f - v - w;
 				// find vertices of shape A that correspond to face
 				glm::vec3 a_a = p.support_a[face.x];
@@ -887,6 +1469,550 @@ namespace fiz
 
 	}
 
+	ContactInfo EPA(Body* a, Shape* shape_a, Body* b, Shape* shape_b)
+	{
+		return dispatchShapes(shape_a, shape_b, [&](auto* typed_a, auto* typed_b) {
+			return EPAKernel(a, typed_a, b, typed_b);
+		});
+	}
+
+	ContactInfo EPA(Body* a, Body* b)
+	{
+		return EPA(a, a->shapes[0], b, b->shapes[0]);
+	}
+
+	struct SimplexVertex
+	{
+		glm::vec3 a; // support point of a
+		glm::vec3 b; // support point of b
+		glm::vec3 w; // a - b
+		float u; // barycentric weight of the vertex in the closest point
+	};
+
+	/**
+	Closest point to the origin on a triangle of the simplex
+	Keeps only the vertices of the feature the point is on
+	*/
+	void closestOnTriangle(const SimplexVertex* in, SimplexVertex* out, unsigned int& count)
+	{
+		const glm::vec3& a = in[0].w;
+		const glm::vec3& b = in[1].w;
+		const glm::vec3& c = in[2].w;
+		glm::vec3 ab = b - a;
+		glm::vec3 ac = c - a;
+
+		float d1 = glm::dot(ab, -a);
+		float d2 = glm::dot(ac, -a);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+		{
+			out[0] = in[0];
+			out[0].u = 1.0f;
+			count = 1;
+			return;
+		}
+
+		float d3 = glm::dot(ab, -b);
+		float d4 = glm::dot(ac, -b);
+		if (d3 >= 0.0f && d4 <= d3)
+		{
+			out[0] = in[1];
+			out[0].u = 1.0f;
+			count = 1;
+			return;
+		}
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			float v = d1 / (d1 - d3);
+			out[0] = in[0];
+			out[1] = in[1];
+			out[0].u = 1.0f - v;
+			out[1].u = v;
+			count = 2;
+			return;
+		}
+
+		float d5 = glm::dot(ab, -c);
+		float d6 = glm::dot(ac, -c);
+		if (d6 >= 0.0f && d5 <= d6)
+		{
+			out[0] = in[2];
+			out[0].u = 1.0f;
+			count = 1;
+			return;
+		}
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			float w = d2 / (d2 - d6);
+			out[0] = in[0];
+			out[1] = in[2];
+			out[0].u = 1.0f - w;
+			out[1].u = w;
+			count = 2;
+			return;
+		}
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			out[0] = in[1];
+			out[1] = in[2];
+			out[0].u = 1.0f - w;
+			out[1].u = w;
+			count = 2;
+			return;
+		}
+
+		float denom = 1.0f / (va + vb + vc);
+		float v = vb * denom;
+		float w = vc * denom;
+		out[0] = in[0];
+		out[1] = in[1];
+		out[2] = in[2];
+		out[0].u = 1.0f - v - w;
+		out[1].u = v;
+		out[2].u = w;
+		count = 3;
+	}
+
+	/**
+	Reduces the simplex to the feature closest to the origin and sets its weights
+	Returns false if the origin is inside the simplex
+	*/
+	bool solveDistanceSimplex(SimplexVertex* simplex, unsigned int& count)
+	{
+		if (count == 1)
+		{
+			simplex[0].u = 1.0f;
+			return true;
+		}
+		if (count == 2)
+		{
+			glm::vec3 ab = simplex[1].w - simplex[0].w;
+			float t = glm::dot(-simplex[0].w, ab) / glm::dot(ab, ab);
+			if (t <= 0.0f)
+			{
+				simplex[0].u = 1.0f;
+				count = 1;
+			}
+			else if (t >= 1.0f)
+			{
+				simplex[0] = simplex[1];
+				simplex[0].u = 1.0f;
+				count = 1;
+			}
+			else
+			{
+				simplex[0].u = 1.0f - t;
+				simplex[1].u = t;
+			}
+			return true;
+		}
+		if (count == 3)
+		{
+			SimplexVertex in[3] = { simplex[0], simplex[1], simplex[2] };
+			closestOnTriangle(in, simplex, count);
+			return true;
+		}
+
+		// tetrahedron, test each face the origin is outside of
+		static const unsigned int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+		SimplexVertex best[3];
+		unsigned int best_count = 0;
+		float best_distance = 9999999.9f;
+		bool outside = false;
+		for (unsigned int f = 0; f < 4; ++f)
+		{
+			const glm::vec3& a = simplex[faces[f][0]].w;
+			glm::vec3 normal = glm::cross(simplex[faces[f][1]].w - a, simplex[faces[f][2]].w - a);
+			float side_origin = glm::dot(normal, -a);
+			float side_opposite = glm::dot(normal, simplex[faces[f][3]].w - a);
+			if (side_origin * side_opposite >= 0.0f)
+				continue;
+
+			outside = true;
+			SimplexVertex in[3] = { simplex[faces[f][0]], simplex[faces[f][1]], simplex[faces[f][2]] };
+			SimplexVertex out[3];
+			unsigned int out_count;
+			closestOnTriangle(in, out, out_count);
+
+			glm::vec3 point(0.0f);
+			for (unsigned int i = 0; i < out_count; ++i)
+				point += out[i].w * out[i].u;
+			float distance = glm::dot(point, point);
+			if (distance < best_distance)
+			{
+				best_distance = distance;
+				best_count = out_count;
+				for (unsigned int i = 0; i < out_count; ++i)
+					best[i] = out[i];
+			}
+		}
+		if (!outside)
+			return false;
+
+		count = best_count;
+		for (unsigned int i = 0; i < count; ++i)
+			simplex[i] = best[i];
+		return true;
+	}
+
+	/**
+	Finds the closest points between two convex shapes with GJK
+	Returns the distance between them, or 0 if they overlap
+	The normal points from a to b
+	*/
+	template <typename ShapeA, typename ShapeB>
+	float GJKDistanceKernel(Body* a, ShapeA* shape_a, Body* b, ShapeB* shape_b, glm::vec3& normal, glm::vec3& point_a, glm::vec3& point_b)
+	{
+		SimplexVertex simplex[4];
+		unsigned int count = 1;
+
+		glm::vec3 axis = b->pos - a->pos;
+		if (glm::dot(axis, axis) < 0.0000001f)
+			axis = glm::vec3(1.0f, 0.0f, 0.0f);
+		simplex[0].a = support(a, shape_a, axis);
+		simplex[0].b = support(b, shape_b, -axis);
+		simplex[0].w = simplex[0].a - simplex[0].b;
+
+		for (unsigned int iter = 0; iter < 32; ++iter)
+		{
+			if (!solveDistanceSimplex(simplex, count))
+				return 0.0f;
+
+			glm::vec3 closest(0.0f);
+			point_a = glm::vec3(0.0f);
+			point_b = glm::vec3(0.0f);
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				closest += simplex[i].w * simplex[i].u;
+				point_a += simplex[i].a * simplex[i].u;
+				point_b += simplex[i].b * simplex[i].u;
+			}
+
+			float distance2 = glm::dot(closest, closest);
+			if (distance2 < 0.00000001f)
+				return 0.0f;
+
+			SimplexVertex next;
+			next.a = support(a, shape_a, -closest);
+			next.b = support(b, shape_b, closest);
+			next.w = next.a - next.b;
+
+			// stop when the new vertex gets no closer to the origin
+			if (distance2 - glm::dot(closest, next.w) <= 0.000001f * distance2)
+				break;
+
+			bool duplicate = false;
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				if (glm::dot(simplex[i].w - next.w, simplex[i].w - next.w) < 0.00000001f)
+					duplicate = true;
+			}
+			if (duplicate)
+				break;
+
+			// a flat simplex can't get closer and would look like it contains the origin
+			glm::vec3 edge = next.w - simplex[0].w;
+			if (count == 2)
+			{
+				glm::vec3 ab = simplex[1].w - simplex[0].w;
+				glm::vec3 area = glm::cross(ab, edge);
+				if (glm::dot(area, area) <= 0.000001f * glm::dot(ab, ab) * glm::dot(edge, edge))
+					break;
+			}
+			else if (count == 3)
+			{
+				glm::vec3 normal_abc = glm::cross(simplex[1].w - simplex[0].w, simplex[2].w - simplex[0].w);
+				float volume = glm::dot(normal_abc, edge);
+				if (volume * volume <= 0.000001f * glm::dot(normal_abc, normal_abc) * glm::dot(edge, edge))
+					break;
+			}
+
+			simplex[count++] = next;
+		}
+
+		float distance = glm::length(point_b - point_a);
+		normal = distance > 0.0f ? (point_b - point_a) / distance : glm::vec3(0.0f, 0.0f, 1.0f);
+		return distance;
+	}
+
+	float GJKDistance(Body* a, Shape* shape_a, Body* b, Shape* shape_b, glm::vec3& normal, glm::vec3& point_a, glm::vec3& point_b)
+	{
+		return dispatchShapes(shape_a, shape_b, [&](auto* typed_a, auto* typed_b) {
+			return GJKDistanceKernel(a, typed_a, b, typed_b, normal, point_a, point_b);
+		});
+	}
+
+	/**
+	Motion of a body over a step for time of impact queries
+	*/
+	struct Sweep
+	{
+		glm::vec3 pos0;
+		glm::vec3 pos1;
+		glm::quat orientation0;
+		glm::quat orientation1;
+		float angle; // bound on the rotation over the step
+
+		void apply(Body* body, float t)
+		{
+			body->pos = pos0 + (pos1 - pos0) * t;
+			if (angle > 0.0f)
+				body->orientation = glm::normalize(glm::slerp(orientation0, orientation1, t));
+			else
+				body->orientation = orientation0;
+			body->updateOrientationMat();
+		}
+	};
+
+	struct TimeOfImpact
+	{
+		float t; // fraction of the sweep, 1 if there is no impact
+		glm::vec3 normal; // from a to b
+		glm::vec3 point_a;
+		glm::vec3 point_b;
+	};
+
+	inline float ccd_target_distance = 0.01f; // distance bodies are stopped at before the impact
+
+	/**
+	Conservative advancement of b along its sweep until it is within the target distance
+	Each step moves b as far as it can go without the distance bound letting it pass through
+	distance(normal, point_a, point_b) returns the distance at the current pose of b
+	*/
+	template <typename DistanceFunction>
+	TimeOfImpact conservativeAdvancement(Body* b, Sweep& sweep, float radius, float t_max, DistanceFunction distance)
+	{
+		TimeOfImpact toi;
+		toi.t = 1.0f;
+
+		glm::vec3 translation = sweep.pos1 - sweep.pos0;
+		float t = 0.0f;
+		for (unsigned int iter = 0; iter < 20; ++iter)
+		{
+			sweep.apply(b, t);
+			glm::vec3 normal, point_a, point_b;
+			float d = distance(normal, point_a, point_b);
+
+			// shapes that are already touching are left to the discrete contacts
+			if (iter == 0 && d <= ccd_target_distance * 1.25f)
+				return toi;
+
+			// overlapping from numerical error, use the last pose that was apart
+			if (d <= 0.0f)
+				return toi;
+
+			// fastest that b can approach along the normal
+			float bound = -glm::dot(translation, normal) + sweep.angle * radius;
+			if (bound <= 0.0000001f)
+			{
+				toi.t = 1.0f;
+				return toi;
+			}
+
+			toi.t = t;
+			toi.normal = normal;
+			toi.point_a = point_a;
+			toi.point_b = point_b;
+			if (d <= ccd_target_distance * 1.25f)
+				return toi;
+
+			t += (d - ccd_target_distance) / bound;
+			if (t >= t_max)
+			{
+				toi.t = 1.0f;
+				return toi;
+			}
+		}
+		return toi;
+	}
+
+	TimeOfImpact timeOfImpact(Body* a, Shape* shape_a, Body* b, Shape* shape_b, Sweep& sweep, float radius, float t_max)
+	{
+		return conservativeAdvancement(b, sweep, radius, t_max, [&](glm::vec3& normal, glm::vec3& point_a, glm::vec3& point_b) {
+			return GJKDistance(a, shape_a, b, shape_b, normal, point_a, point_b);
+		});
+	}
+
+	/**
+	Time of impact with the plane dot(normal, x) = offset in world coordinates
+	*/
+	TimeOfImpact timeOfImpactPlane(const glm::vec3& plane_normal, float offset, Body* b, Shape* shape_b, Sweep& sweep, float radius, float t_max)
+	{
+		return conservativeAdvancement(b, sweep, radius, t_max, [&](glm::vec3& normal, glm::vec3& point_a, glm::vec3& point_b) {
+			point_b = support(b, shape_b, -plane_normal);
+			float d = glm::dot(plane_normal, point_b) - offset;
+			point_a = point_b - plane_normal * d;
+			normal = plane_normal;
+			return d;
+		});
+	}
+
+	/**
+	Checks if a point on a triangle of the concave shape on a lies on an edge
+	that is a flat or concave seam with its neighbor
+	*/
+	bool isOnInternalEdge(Body* a, Triangle& triangle, uint8_t convex_edges, const glm::vec3& point)
+	{
+		// barycentric coordinates of the point on the triangle
+		glm::vec3 local = a->getLocalPos(point);
+		glm::vec3 v0 = triangle.v[1] - triangle.v[0];
+		glm::vec3 v1 = triangle.v[2] - triangle.v[0];
+		glm::vec3 v2 = local - triangle.v[0];
+		float d00 = glm::dot(v0, v0);
+		float d01 = glm::dot(v0, v1);
+		float d11 = glm::dot(v1, v1);
+		float d20 = glm::dot(v2, v0);
+		float d21 = glm::dot(v2, v1);
+		float denom = d00 * d11 - d01 * d01;
+		if (denom <= 0.0000001f)
+			return false;
+		float bary[3];
+		bary[1] = (d11 * d20 - d01 * d21) / denom;
+		bary[2] = (d00 * d21 - d01 * d20) / denom;
+		bary[0] = 1.0f - bary[1] - bary[2];
+
+		// the point is on edge e when the weight of the opposite vertex is zero
+		for (unsigned int e = 0; e < 3; ++e)
+		{
+			if (bary[(e + 2) % 3] < 0.001f && !((convex_edges >> e) & 1))
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	Collides a convex shape of b with a triangle of the concave shape on a
+	Contacts on edges or vertices of the triangle that are flat or concave seams
+	are moved to the face normal, so bodies sliding across them don't catch on
+	internal edges. Contacts that are not penetrating along the face normal
+	are dropped
+	*/
+	ContactInfo checkCollisionTriangle(Body* a, Triangle& triangle, const glm::vec3& local_normal, uint8_t convex_edges, Body* b, Shape* shape_b)
+	{
+		ContactInfo contact;
+		contact.collided = false;
+
+		glm::vec3 face_normal = a->getWorldVec(local_normal);
+
+		if (!GJK(a, &triangle, b, shape_b, face_normal))
+			return contact;
+
+		contact = EPA(a, &triangle, b, shape_b);
+		if (!contact.collided || glm::dot(contact.normal, face_normal) > 0.9999f)
+			return contact;
+
+		if (!isOnInternalEdge(a, triangle, convex_edges, contact.poc_a))
+			return contact;
+
+		glm::vec3 deepest = support(b, shape_b, -face_normal);
+		float depth = glm::dot(face_normal, a->getWorldPos(triangle.v[0]) - deepest);
+		if (depth <= 0.0f)
+		{
+			contact.collided = false;
+			return contact;
+		}
+
+		contact.normal = face_normal;
+		contact.depth = depth;
+		contact.poc_b = deepest;
+		contact.poc_a = deepest + face_normal * depth;
+		contact.poc = (contact.poc_a + contact.poc_b) * 0.5f;
+		return contact;
+	}
+
+	ContactInfo checkCollisionTriangle(Body* a, TriangleMesh* mesh, unsigned int index, Body* b, Shape* shape_b)
+	{
+		Triangle triangle = mesh->getTriangle(index);
+		return checkCollisionTriangle(a, triangle, mesh->normals[index], mesh->convex_edges[index], b, shape_b);
+	}
+
+	/**
+	Collides a convex shape of b with one cell triangle of the heightfield on a
+	Uses the material of the cell for friction and restitution
+	*/
+	ContactInfo checkCollisionHeightfield(Body* a, Heightfield* heightfield, unsigned int index, Body* b, Shape* shape_b)
+	{
+		Triangle triangle = heightfield->getTriangle(index);
+		glm::vec3 normal = heightfield->getNormal(triangle);
+		uint8_t convex_edges = heightfield->getConvexEdges(index, triangle, normal);
+
+		ContactInfo contact = checkCollisionTriangle(a, triangle, normal, convex_edges, b, shape_b);
+		if (contact.collided)
+		{
+			TerrainMaterial& material = heightfield->getMaterial(index);
+			contact.friction = glm::min(material.friction, b->friction);
+			contact.restitution = glm::max(material.restitution, b->restitution);
+		}
+		return contact;
+	}
+
+	/**
+	Finds the gap between two convex shapes that are apart, for speculative contacts
+	The contact is not collided and its depth is minus the gap, or 0 if the shapes touch
+	*/
+	ContactInfo checkSeparation(Body* a, Shape* shape_a, Body* b, Shape* shape_b)
+	{
+		ContactInfo contact;
+		contact.collided = false;
+		contact.body_a = a;
+		contact.body_b = b;
+		contact.depth = -GJKDistance(a, shape_a, b, shape_b, contact.normal, contact.poc_a, contact.poc_b);
+		contact.poc = (contact.poc_a + contact.poc_b) * 0.5f;
+		contact.restitution = glm::max(a->restitution, b->restitution);
+		contact.friction = glm::min(a->friction, b->friction);
+		return contact;
+	}
+
+	/**
+	Finds the gap between a convex shape of b and a triangle of the concave shape on a
+	Gaps across flat or concave seams are measured along the face normal
+	like in checkCollisionTriangle, and shapes behind the face have no gap
+	*/
+	ContactInfo checkSeparationTriangle(Body* a, Triangle& triangle, const glm::vec3& local_normal, uint8_t convex_edges, Body* b, Shape* shape_b)
+	{
+		ContactInfo contact = checkSeparation(a, &triangle, b, shape_b);
+		glm::vec3 face_normal = a->getWorldVec(local_normal);
+		if (contact.depth >= 0.0f || glm::dot(contact.normal, face_normal) > 0.9999f)
+			return contact;
+
+		if (!isOnInternalEdge(a, triangle, convex_edges, contact.poc_a))
+			return contact;
+
+		glm::vec3 lowest = support(b, shape_b, -face_normal);
+		float gap = glm::dot(face_normal, lowest - a->getWorldPos(triangle.v[0]));
+		contact.depth = glm::min(-gap, 0.0f);
+		contact.normal = face_normal;
+		contact.poc_b = lowest;
+		contact.poc_a = lowest - face_normal * gap;
+		contact.poc = (contact.poc_a + contact.poc_b) * 0.5f;
+		return contact;
+	}
+
+	ContactInfo checkSeparationTriangle(Body* a, TriangleMesh* mesh, unsigned int index, Body* b, Shape* shape_b)
+	{
+		Triangle triangle = mesh->getTriangle(index);
+		return checkSeparationTriangle(a, triangle, mesh->normals[index], mesh->convex_edges[index], b, shape_b);
+	}
+
+	ContactInfo checkSeparationHeightfield(Body* a, Heightfield* heightfield, unsigned int index, Body* b, Shape* shape_b)
+	{
+		Triangle triangle = heightfield->getTriangle(index);
+		glm::vec3 normal = heightfield->getNormal(triangle);
+		uint8_t convex_edges = heightfield->getConvexEdges(index, triangle, normal);
+
+		ContactInfo contact = checkSeparationTriangle(a, triangle, normal, convex_edges, b, shape_b);
+		TerrainMaterial& material = heightfield->getMaterial(index);
+		contact.friction = glm::min(material.friction, b->friction);
+		contact.restitution = glm::max(material.restitution, b->restitution);
+		return contact;
+	}
+
 	ContactInfo checkCollision(Body* a, Body* b)
 	{
 		bool collided = GJK(a, b, glm::vec3(1.0f, 0.0f, 0.0f));
@@ -904,31 +2030,31 @@ namespace fiz
 		return contact;
 	}
 
-	ContactInfo checkCollisionSphereSphere(Body* a, Body* b)
+	ContactInfo checkCollisionSphereSphere(Body* a, Sphere* sphere_a, Body* b, Sphere* sphere_b)
 	{
-		Sphere* sphere_a = (Sphere*)a->shapes[0];
-		Sphere* sphere_b = (Sphere*)b->shapes[0];
-
 		ContactInfo contact;
 		contact.collided = false;
 
-		float dx = b->pos.x - a->pos.x;
-		float dy = b->pos.y - a->pos.y;
-		float dz = b->pos.z - a->pos.z;
+		glm::vec3 center_a = a->getWorldPos(sphere_a->pos);
+		glm::vec3 center_b = b->getWorldPos(sphere_b->pos);
+
+		float dx = center_b.x - center_a.x;
+		float dy = center_b.y - center_a.y;
+		float dz = center_b.z - center_a.z;
 		float rad = sphere_a->rad + sphere_b->rad;
 		float rad2 = rad * rad;
 		float dist2 = dx * dx + dy * dy + dz * dz;
 		if (dist2 < rad2)
 		{
 			float dist = glm::sqrt(dist2);
-			glm::vec3 dir = (b->pos - a->pos) / dist;
+			glm::vec3 dir = (center_b - center_a) / dist;
 
 			contact.collided = true;
 			contact.body_a = a;
 			contact.body_b = b;
-			contact.poc = a->pos + dir * sphere_a->rad;
-			contact.poc += b->pos - dir * sphere_b->rad;
-			contact.poc *= 0.5f;
+			contact.poc_a = center_a + dir * sphere_a->rad;
+			contact.poc_b = center_b - dir * sphere_b->rad;
+			contact.poc = (contact.poc_a + contact.poc_b) * 0.5f;
 			contact.normal = dir;
 			contact.depth = rad - dist;
 			contact.restitution = glm::max(a->restitution, b->restitution);
@@ -938,6 +2064,11 @@ namespace fiz
 		return contact;
 	}
 
+	ContactInfo checkCollisionSphereSphere(Body* a, Body* b)
+	{
+		return checkCollisionSphereSphere(a, (Sphere*)a->shapes[0], b, (Sphere*)b->shapes[0]);
+	}
+
 	ContactInfo checkCollisionSphereCapsule(Body* a, Body* b)
 	{
 		Capsule* capsule = (Capsule*)a->shapes[0];
@@ -1012,30 +2143,148 @@ namespace fiz
 
 	float ground_restitution = 0.1f;
 	float ground_friction = 0.8f;
-	ContactInfo checkCollisionGround(Body* body)
+	Plane ground_plane(glm::vec3(0.0f, 0.0f, 1.0f), 0.0f);
+
+	/**
+	Collides a shape of b with the plane dot(normal, x) = offset in world coordinates
+	a is the body of the plane, or nullptr for the ground
+	Shapes above the plane are not collided and have minus their gap as the depth
+	*/
+	ContactInfo checkCollisionPlane(Body* a, const glm::vec3& normal, float offset, Body* b, Shape* shape)
 	{
 		ContactInfo contact;
-		contact.collided = false;
 
-		glm::vec3 local_up = body->getLocalVec(glm::vec3(0.0f, 0.0f, -1.0f));
-		glm::vec3 lowest = body->shapes[0]->support(local_up);
-		lowest = body->getWorldPos(lowest);
+		glm::vec3 lowest = support(b, shape, -normal);
+		float depth = offset - glm::dot(normal, lowest);
 
-		if (lowest.z < 0.0f)
+		contact.collided = depth > 0.0f;
+		contact.body_a = a;
+		contact.body_b = b;
+		contact.poc = lowest;
+		contact.poc_a = lowest + normal * depth;
+		contact.poc_b = lowest;
+		contact.normal = normal;
+		contact.depth = depth;
+		if (a == nullptr)
 		{
-			contact.collided = true;
-			contact.body_a = nullptr;
-			contact.body_b = body;
-			contact.poc = lowest;
-			contact.normal = glm::vec3(0.0f, 0.0f, 1.0f);
-			contact.depth = -lowest.z;
-			contact.restitution = glm::max(ground_restitution, body->restitution);
-			contact.friction = glm::min(ground_friction, body->friction);
+			contact.restitution = glm::max(ground_restitution, b->restitution);
+			contact.friction = glm::min(ground_friction, b->friction);
+		}
+		else
+		{
+			contact.restitution = glm::max(a->restitution, b->restitution);
+			contact.friction = glm::min(a->friction, b->friction);
 		}
 
 		return contact;
 	}
 
+	ContactInfo checkCollisionGround(Body* body, Shape* shape)
+	{
+		return checkCollisionPlane(nullptr, ground_plane.normal, ground_plane.offset, body, shape);
+	}
+
+	ContactInfo checkCollisionGround(Body* body)
+	{
+		return checkCollisionGround(body, body->shapes[0]);
+	}
+
+	/**
+	Whether two shapes overlap, without finding the contact
+	Runs GJK only, since sensors need no depth or normal from EPA
+	*/
+	bool testOverlap(Body* a, Shape* shape_a, Body* b, Shape* shape_b)
+	{
+		if (shape_a->shape_type == ShapeType::PLANE_TYPE)
+		{
+			Plane* plane = (Plane*)shape_a;
+			glm::vec3 normal = a->getWorldVec(plane->normal);
+			float offset = plane->offset + glm::dot(normal, a->pos);
+			return glm::dot(normal, support(b, shape_b, -normal)) < offset;
+		}
+		return GJK(a, shape_a, b, shape_b, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+
+	/**
+	Bounds of the awake dynamic bodies laid out as arrays for the plane pass
+	Each plane is tested against every body in one branchless loop that
+	the compiler vectorizes, and only the bodies whose bounds cross the
+	plane go on to the support test
+	*/
+	struct PlaneBatch
+	{
+		std::vector<float> center_x;
+		std::vector<float> center_y;
+		std::vector<float> center_z;
+		std::vector<float> extent_x;
+		std::vector<float> extent_y;
+		std::vector<float> extent_z;
+		std::vector<float> distance;
+		std::vector<unsigned int> bodies; // index of each body in the world
+
+		/**
+		Gathers the awake bodies that are not sensors, with bounds holding the bounds of each body to test
+		*/
+		void gather(std::vector<DynamicBody>& dynamic_bodies, std::vector<AABB>& bounds)
+		{
+			center_x.clear();
+			center_y.clear();
+			center_z.clear();
+			extent_x.clear();
+			extent_y.clear();
+			extent_z.clear();
+			bodies.clear();
+
+			for (unsigned int i = 0; i < dynamic_bodies.size(); ++i)
+			{
+				if (!dynamic_bodies[i].is_awake || dynamic_bodies[i].is_sensor)
+					continue;
+
+				AABB& aabb = bounds[i];
+				center_x.push_back((aabb.min.x + aabb.max.x) * 0.5f);
+				center_y.push_back((aabb.min.y + aabb.max.y) * 0.5f);
+				center_z.push_back((aabb.min.z + aabb.max.z) * 0.5f);
+				extent_x.push_back((aabb.max.x - aabb.min.x) * 0.5f);
+				extent_y.push_back((aabb.max.y - aabb.min.y) * 0.5f);
+				extent_z.push_back((aabb.max.z - aabb.min.z) * 0.5f);
+				bodies.push_back(i);
+			}
+			distance.resize(bodies.size());
+		}
+
+		/**
+		Finds the bodies whose bounds reach below the plane dot(normal, x) = offset
+		*/
+		void query(const glm::vec3& normal, float offset, std::vector<unsigned int>& hits)
+		{
+			const float nx = normal.x;
+			const float ny = normal.y;
+			const float nz = normal.z;
+			const float ax = glm::abs(nx);
+			const float ay = glm::abs(ny);
+			const float az = glm::abs(nz);
+
+			const float* __restrict cx = center_x.data();
+			const float* __restrict cy = center_y.data();
+			const float* __restrict cz = center_z.data();
+			const float* __restrict ex = extent_x.data();
+			const float* __restrict ey = extent_y.data();
+			const float* __restrict ez = extent_z.data();
+			float* __restrict d = distance.data();
+
+			// distance from the plane to the lowest corner of each box
+			const unsigned int count = bodies.size();
+			for (unsigned int i = 0; i < count; ++i)
+				d[i] = nx * cx[i] + ny * cy[i] + nz * cz[i] - ax * ex[i] - ay * ey[i] - az * ez[i] - offset;
+
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				if (d[i] < 0.0f)
+					hits.push_back(bodies[i]);
+			}
+		}
+	};
+
 	ContactInfo checkCollisionSphereGround(Body* body)
 	{
 		Sphere* sphere = (Sphere*)body->shapes[0];
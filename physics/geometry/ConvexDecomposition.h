@@ -0,0 +1,480 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Shape.h"
+#include "ConvexHull.h"
+#include "../ThreadPool.h"
+
+namespace fiz
+{
+	struct DecompositionSettings
+	{
+		unsigned int max_hulls; // upper bound on the number of output hulls
+		float concavity; // parts deeper than this below their hull are split further
+		unsigned int max_hull_vertices; // vertex budget of each output hull, 0 for no limit
+		unsigned int plane_samples; // candidate split planes per axis
+
+		DecompositionSettings() : max_hulls(32), concavity(0.05f), max_hull_vertices(32), plane_samples(8)
+		{
+
+		}
+	};
+
+	/**
+	Approximate convex decomposition of a triangle mesh.
+	The part with the largest concavity is split by the axis aligned plane
+	that leaves the least concave halves until every part is within the
+	concavity tolerance or max_hulls is reached. Connected pieces are split
+	as a whole before any single piece is cut apart. Concavity is the depth
+	of the surface below the hull of the part, measured along the surface
+	normal. Candidate planes are evaluated in parallel on a thread pool and
+	results can be cached in a binary file.
+	*/
+	class ConvexDecomposition
+	{
+		struct Part
+		{
+			std::vector<glm::uvec3> triangles;
+			float concavity;
+		};
+
+		const std::vector<glm::vec3>* mesh_vertices;
+		std::vector<unsigned int> vertex_component; // connected piece each vertex belongs to
+		std::vector<glm::vec3> component_centroids;
+		float surface_epsilon;
+		ThreadPool* thread_pool;
+
+	public:
+		std::vector<std::vector<glm::vec3>> hull_vertices;
+		std::vector<std::vector<glm::uvec3>> hull_indices;
+
+		// the candidate planes are evaluated on the pool, or on a pool made for this call when there is none
+		void decompose(const std::vector<glm::vec3>& vertices, const std::vector<glm::uvec3>& triangles, const DecompositionSettings& settings = DecompositionSettings(), ThreadPool* pool = nullptr)
+		{
+			hull_vertices.clear();
+			hull_indices.clear();
+			mesh_vertices = &vertices;
+
+			if (triangles.empty())
+				return;
+
+			std::unique_ptr<ThreadPool> own_pool;
+			if (pool == nullptr)
+			{
+				own_pool = std::make_unique<ThreadPool>();
+				pool = own_pool.get();
+			}
+			thread_pool = pool;
+
+			glm::vec3 max_abs(0.0f);
+			for (unsigned int i = 0; i < vertices.size(); ++i)
+				max_abs = glm::max(max_abs, glm::abs(vertices[i]));
+			surface_epsilon = 0.0001f * glm::max(max_abs.x, glm::max(max_abs.y, max_abs.z));
+
+			findComponents(vertices, triangles);
+
+			std::vector<Part> parts(1);
+			parts[0].triangles = triangles;
+			parts[0].concavity = computeConcavity(parts[0].triangles);
+
+			while (parts.size() < settings.max_hulls)
+			{
+				// split the worst part first
+				int worst = -1;
+				float worst_concavity = settings.concavity;
+				for (unsigned int i = 0; i < parts.size(); ++i)
+				{
+					if (parts[i].concavity > worst_concavity && parts[i].triangles.size() > 1)
+					{
+						worst_concavity = parts[i].concavity;
+						worst = i;
+					}
+				}
+				if (worst == -1)
+					break;
+
+				Part left, right;
+				if (!splitPart(parts[worst], settings.plane_samples, left, right))
+				{
+					parts[worst].concavity = 0.0f; // no plane separates it, keep as is
+					continue;
+				}
+
+				parts[worst] = left;
+				parts.push_back(right);
+			}
+
+			HullSettings hull_settings;
+			hull_settings.max_vertices = settings.max_hull_vertices;
+			for (unsigned int i = 0; i < parts.size(); ++i)
+				addHull(parts[i].triangles, hull_settings);
+
+			thread_pool = nullptr;
+		}
+
+		std::vector<Polyhedron*> createPolyhedra()
+		{
+			std::vector<Polyhedron*> polyhedra;
+			for (unsigned int i = 0; i < hull_vertices.size(); ++i)
+			{
+				Polyhedron* polyhedron = new Polyhedron(hull_vertices[i].size());
+
+				for (unsigned int j = 0; j < hull_vertices[i].size(); ++j)
+					polyhedron->addVertex(hull_vertices[i][j]);
+
+				for (unsigned int j = 0; j < hull_indices[i].size(); ++j)
+					polyhedron->addIndex(hull_indices[i][j]);
+
+				polyhedra.push_back(polyhedron);
+			}
+			return polyhedra;
+		}
+
+		/**
+		Writes the hulls to a binary file tagged with the format version and key.
+		*/
+		bool save(const std::string& filepath, uint64_t key)
+		{
+			std::ofstream file(filepath, std::ios::binary);
+			if (!file)
+				return false;
+
+			uint32_t header[3] = { cache_magic, cache_version, (uint32_t)hull_vertices.size() };
+			file.write((const char*)header, sizeof(header));
+			file.write((const char*)&key, sizeof(key));
+
+			for (unsigned int i = 0; i < hull_vertices.size(); ++i)
+			{
+				uint32_t sizes[2] = { (uint32_t)hull_vertices[i].size(), (uint32_t)hull_indices[i].size() };
+				file.write((const char*)sizes, sizeof(sizes));
+				file.write((const char*)hull_vertices[i].data(), sizeof(glm::vec3) * sizes[0]);
+				file.write((const char*)hull_indices[i].data(), sizeof(glm::uvec3) * sizes[1]);
+			}
+			return (bool)file;
+		}
+
+		/**
+		Reads hulls written by save, fails if the version or key does not match,
+		or if the file is shorter than its counts say or has indices out of range.
+		*/
+		bool load(const std::string& filepath, uint64_t key)
+		{
+			hull_vertices.clear();
+			hull_indices.clear();
+
+			std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+			if (!file)
+				return false;
+			uint64_t remaining = (uint64_t)file.tellg();
+			file.seekg(0);
+
+			uint32_t header[3];
+			uint64_t file_key;
+			if (remaining < sizeof(header) + sizeof(file_key))
+				return false;
+			file.read((char*)header, sizeof(header));
+			file.read((char*)&file_key, sizeof(file_key));
+			remaining -= sizeof(header) + sizeof(file_key);
+			if (!file || header[0] != cache_magic || header[1] != cache_version || file_key != key)
+				return false;
+
+			// every hull has at least its two counts
+			uint32_t hull_count = header[2];
+			if ((uint64_t)hull_count * 2 * sizeof(uint32_t) > remaining)
+				return false;
+
+			hull_vertices.resize(hull_count);
+			hull_indices.resize(hull_count);
+			for (unsigned int i = 0; i < hull_count; ++i)
+			{
+				uint32_t sizes[2];
+				file.read((char*)sizes, sizeof(sizes));
+				remaining -= sizeof(sizes);
+				uint64_t bytes = (uint64_t)sizes[0] * sizeof(glm::vec3) + (uint64_t)sizes[1] * sizeof(glm::uvec3);
+				if (!file || bytes > remaining)
+					return failLoad();
+				remaining -= bytes;
+
+				hull_vertices[i].resize(sizes[0]);
+				hull_indices[i].resize(sizes[1]);
+				file.read((char*)hull_vertices[i].data(), sizeof(glm::vec3) * sizes[0]);
+				file.read((char*)hull_indices[i].data(), sizeof(glm::uvec3) * sizes[1]);
+				if (!file)
+					return failLoad();
+
+				for (unsigned int j = 0; j < sizes[1]; ++j)
+				{
+					glm::uvec3& index = hull_indices[i][j];
+					if (index.x >= sizes[0] || index.y >= sizes[0] || index.z >= sizes[0])
+						return failLoad();
+				}
+			}
+			return true;
+		}
+
+		// FNV-1a, used to key cached results by their source data and settings
+		static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			uint64_t h = seed;
+			for (size_t i = 0; i < size; ++i)
+			{
+				h ^= bytes[i];
+				h *= 1099511628211ull;
+			}
+			return h;
+		}
+
+		static uint64_t hashFile(const std::string& filepath, uint64_t seed = 14695981039346656037ull)
+		{
+			std::ifstream file(filepath, std::ios::binary);
+			std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			return hash(bytes.data(), bytes.size(), seed);
+		}
+
+		// the format version is mixed in so files from an older decomposition are never matched
+		static uint64_t hashSettings(const DecompositionSettings& settings, uint64_t seed)
+		{
+			uint32_t version = cache_version;
+			uint64_t h = hash(&version, sizeof(version), seed);
+			h = hash(&settings.max_hulls, sizeof(settings.max_hulls), h);
+			h = hash(&settings.concavity, sizeof(settings.concavity), h);
+			h = hash(&settings.max_hull_vertices, sizeof(settings.max_hull_vertices), h);
+			return hash(&settings.plane_samples, sizeof(settings.plane_samples), h);
+		}
+
+	private:
+		static const uint32_t cache_magic = 0x445a4946; // "FIZD"
+		static const uint32_t cache_version = 2; // bump when the file layout or the decomposition changes
+
+		bool failLoad()
+		{
+			hull_vertices.clear();
+			hull_indices.clear();
+			return false;
+		}
+
+		void gatherPoints(const std::vector<glm::uvec3>& triangles, std::vector<glm::vec3>& points)
+		{
+			const std::vector<glm::vec3>& v = *mesh_vertices;
+			points.clear();
+			points.reserve(triangles.size() * 3);
+			for (unsigned int i = 0; i < triangles.size(); ++i)
+			{
+				points.push_back(v[triangles[i].x]);
+				points.push_back(v[triangles[i].y]);
+				points.push_back(v[triangles[i].z]);
+			}
+		}
+
+		void findComponents(const std::vector<glm::vec3>& vertices, const std::vector<glm::uvec3>& triangles)
+		{
+			// union-find over shared vertex indices
+			std::vector<unsigned int> parent(vertices.size());
+			for (unsigned int i = 0; i < parent.size(); ++i)
+				parent[i] = i;
+
+			auto find = [&](unsigned int x) {
+				while (parent[x] != x)
+				{
+					parent[x] = parent[parent[x]];
+					x = parent[x];
+				}
+				return x;
+			};
+
+			for (unsigned int i = 0; i < triangles.size(); ++i)
+			{
+				parent[find(triangles[i].y)] = find(triangles[i].x);
+				parent[find(triangles[i].z)] = find(triangles[i].x);
+			}
+
+			vertex_component.assign(vertices.size(), 0);
+			component_centroids.clear();
+			std::vector<unsigned int> counts;
+			std::vector<int> root_component(vertices.size(), -1);
+			for (unsigned int i = 0; i < vertices.size(); ++i)
+			{
+				unsigned int root = find(i);
+				if (root_component[root] == -1)
+				{
+					root_component[root] = component_centroids.size();
+					component_centroids.push_back(glm::vec3(0.0f));
+					counts.push_back(0);
+				}
+				vertex_component[i] = root_component[root];
+				component_centroids[vertex_component[i]] += vertices[i];
+				counts[vertex_component[i]]++;
+			}
+			for (unsigned int i = 0; i < component_centroids.size(); ++i)
+				component_centroids[i] /= (float)counts[i];
+		}
+
+		// deepest surface sample below the hull of the part, measured along the surface normal
+		float computeConcavity(const std::vector<glm::uvec3>& triangles)
+		{
+			const std::vector<glm::vec3>& v = *mesh_vertices;
+
+			std::vector<glm::vec3> points;
+			gatherPoints(triangles, points);
+
+			ConvexHull hull;
+			if (!hull.build(points))
+				return 0.0f; // flat parts are convex
+
+			std::vector<glm::vec3> normals(hull.indices.size());
+			std::vector<float> dists(hull.indices.size());
+			for (unsigned int i = 0; i < hull.indices.size(); ++i)
+			{
+				glm::vec3 a = hull.vertices[hull.indices[i].x];
+				glm::vec3 b = hull.vertices[hull.indices[i].y];
+				glm::vec3 c = hull.vertices[hull.indices[i].z];
+				normals[i] = glm::normalize(glm::cross(b - a, c - a));
+				dists[i] = glm::dot(normals[i], a);
+			}
+
+			float concavity = 0.0f;
+			for (unsigned int i = 0; i < triangles.size(); ++i)
+			{
+				glm::vec3 samples[4] = { v[triangles[i].x], v[triangles[i].y], v[triangles[i].z], glm::vec3(0.0f) };
+				samples[3] = (samples[0] + samples[1] + samples[2]) / 3.0f;
+
+				glm::vec3 normal = glm::cross(samples[1] - samples[0], samples[2] - samples[0]);
+				float length = glm::length(normal);
+				if (length <= 0.0f)
+					continue;
+				normal /= length;
+
+				// distance along the surface normal to where it leaves the hull
+				for (unsigned int s = 0; s < 4; ++s)
+				{
+					float depth = 9999999.9f;
+					for (unsigned int f = 0; f < normals.size(); ++f)
+					{
+						float dir = glm::dot(normals[f], normal);
+						if (dir > 0.000001f)
+							depth = glm::min(depth, (dists[f] - glm::dot(normals[f], samples[s])) / dir);
+					}
+					if (depth >= 9999999.9f || depth <= concavity)
+						continue;
+
+					// the gap ends at the first surface in the way, this also ignores internal faces
+					for (unsigned int j = 0; j < triangles.size() && depth > concavity; ++j)
+					{
+						if (j == i)
+							continue;
+						float t = rayTriangle({ samples[s], normal }, v[triangles[j].x], v[triangles[j].y], v[triangles[j].z]);
+						if (t >= -surface_epsilon && t < depth)
+							depth = glm::max(t, 0.0f);
+					}
+					concavity = glm::max(concavity, depth);
+				}
+			}
+			return concavity;
+		}
+
+		bool splitPart(Part& part, unsigned int plane_samples, Part& best_left, Part& best_right)
+		{
+			const std::vector<glm::vec3>& v = *mesh_vertices;
+
+			// whole pieces are kept together while there is more than one,
+			// so every part stays a closed surface as long as possible
+			bool split_components = false;
+			for (unsigned int i = 1; i < part.triangles.size() && !split_components; ++i)
+				split_components = vertex_component[part.triangles[i].x] != vertex_component[part.triangles[0].x];
+
+			std::vector<glm::vec3> centroids(part.triangles.size());
+			glm::vec3 min(9999999.9f), max(-9999999.9f);
+			for (unsigned int i = 0; i < part.triangles.size(); ++i)
+			{
+				if (split_components)
+					centroids[i] = component_centroids[vertex_component[part.triangles[i].x]];
+				else
+					centroids[i] = (v[part.triangles[i].x] + v[part.triangles[i].y] + v[part.triangles[i].z]) / 3.0f;
+				min = glm::min(min, centroids[i]);
+				max = glm::max(max, centroids[i]);
+			}
+
+			struct Candidate
+			{
+				Part left;
+				Part right;
+				float cost;
+			};
+
+			struct Plane
+			{
+				unsigned int axis;
+				float offset;
+			};
+
+			std::vector<Plane> planes;
+			for (unsigned int axis = 0; axis < 3; ++axis)
+			{
+				for (unsigned int s = 1; s <= plane_samples; ++s)
+					planes.push_back({ axis, min[axis] + (max[axis] - min[axis]) * (float)s / (float)(plane_samples + 1) });
+			}
+
+			std::vector<Candidate> candidates(planes.size());
+			thread_pool->run(planes.size(), [this, &part, &centroids, &planes, &candidates](unsigned int index) {
+				Candidate& c = candidates[index];
+				for (unsigned int i = 0; i < part.triangles.size(); ++i)
+				{
+					if (centroids[i][planes[index].axis] < planes[index].offset)
+						c.left.triangles.push_back(part.triangles[i]);
+					else
+						c.right.triangles.push_back(part.triangles[i]);
+				}
+
+				if (c.left.triangles.empty() || c.right.triangles.empty())
+				{
+					c.cost = 9999999.9f;
+					return;
+				}
+
+				c.left.concavity = computeConcavity(c.left.triangles);
+				c.right.concavity = computeConcavity(c.right.triangles);
+				c.cost = glm::max(c.left.concavity, c.right.concavity);
+			});
+
+			float best_cost = 9999999.9f;
+			for (unsigned int i = 0; i < candidates.size(); ++i)
+			{
+				if (candidates[i].cost < best_cost)
+				{
+					best_cost = candidates[i].cost;
+					best_left = std::move(candidates[i].left);
+					best_right = std::move(candidates[i].right);
+				}
+			}
+			return best_cost < 9999999.9f;
+		}
+
+		void addHull(const std::vector<glm::uvec3>& triangles, const HullSettings& hull_settings)
+		{
+			std::vector<glm::vec3> points;
+			gatherPoints(triangles, points);
+
+			ConvexHull hull;
+			if (hull.build(points, hull_settings))
+			{
+				hull_vertices.push_back(hull.vertices);
+				hull_indices.push_back(hull.indices);
+				return;
+			}
+
+			// flat part, keep its triangles
+			hull_vertices.push_back(points);
+			hull_indices.push_back(std::vector<glm::uvec3>());
+			for (unsigned int i = 0; i < triangles.size(); ++i)
+				hull_indices.back().push_back(glm::uvec3(i * 3, i * 3 + 1, i * 3 + 2));
+		}
+	};
+}
@@ -0,0 +1,644 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+#include "Shape.h"
+
+namespace fiz
+{
+	struct HullSettings
+	{
+		unsigned int max_vertices; // stop adding points once the hull has this many vertices, 0 for no limit
+		float tolerance; // points closer than this to the hull are not added
+		float merge_angle; // max angle in radians between faces that are merged as coplanar
+
+		HullSettings() : max_vertices(0), tolerance(0.0f), merge_angle(0.01f)
+		{
+
+		}
+	};
+
+	/**
+	Builds a convex hull from a point cloud using quickhull.
+	The furthest outside point is always added first, so stopping at
+	max_vertices or tolerance keeps the points that matter most.
+	Coplanar triangles are merged into polygons and re-triangulated
+	so the output has no interior or collinear vertices.
+	*/
+	class ConvexHull
+	{
+		struct HullFace
+		{
+			unsigned int v[3];
+			glm::vec3 normal;
+			float dist;
+			std::vector<unsigned int> outside; // points in front of this face
+			unsigned int furthest;
+			float furthest_dist;
+			bool removed;
+		};
+
+		const std::vector<glm::vec3>* points;
+		std::vector<HullFace> faces;
+		std::unordered_map<uint64_t, unsigned int> edge_faces; // directed edge -> face
+		float tolerance; // distance to a plane below which a point is on it, for every test of the build
+
+		static constexpr float relative_tolerance = 1e-6f; // of the size of the input, floats read from files are rounded
+		static constexpr float min_sharpness = 0.001f; // sine of the smallest turn of a polygon that is a corner
+
+	public:
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::uvec3> indices;
+
+		/**
+		Computes the hull of the points.
+		Returns false if the points are flat or too few to form a volume, or no valid hull could be built.
+		*/
+		bool build(const std::vector<glm::vec3>& input, const HullSettings& settings = HullSettings())
+		{
+			vertices.clear();
+			indices.clear();
+			faces.clear();
+			edge_faces.clear();
+			points = &input;
+
+			if (input.size() < 4)
+				return false;
+
+			// scaled to the size of the input
+			glm::vec3 min = input[0];
+			glm::vec3 max = input[0];
+			for (unsigned int i = 1; i < input.size(); ++i)
+			{
+				min = glm::min(min, input[i]);
+				max = glm::max(max, input[i]);
+			}
+			glm::vec3 size = max - min;
+			tolerance = glm::max(settings.tolerance, relative_tolerance * (size.x + size.y + size.z));
+
+			if (!buildInitialSimplex())
+				return false;
+
+			unsigned int vertex_count = 4;
+			unsigned int max_vertices = settings.max_vertices == 0 ? 0 : glm::max(settings.max_vertices, 4u);
+
+			while (max_vertices == 0 || vertex_count < max_vertices)
+			{
+				// the face with the furthest outside point overall
+				int face = -1;
+				float furthest_dist = 0.0f;
+				for (unsigned int i = 0; i < faces.size(); ++i)
+				{
+					if (faces[i].removed || faces[i].outside.empty())
+						continue;
+					if (faces[i].furthest_dist > furthest_dist)
+					{
+						furthest_dist = faces[i].furthest_dist;
+						face = i;
+					}
+				}
+				if (face == -1)
+					break;
+
+				addPoint(faces[face].furthest, face);
+				vertex_count++;
+			}
+
+			mergeFaces(glm::cos(settings.merge_angle));
+
+			// merging nearly coplanar faces can still break the hull, the triangles of the build are kept then
+			if (!isValid())
+			{
+				vertices.clear();
+				indices.clear();
+				addFaces();
+				if (!isValid())
+				{
+					vertices.clear();
+					indices.clear();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		Polyhedron* createPolyhedron()
+		{
+			Polyhedron* polyhedron = new Polyhedron(vertices.size());
+
+			for (unsigned int i = 0; i < vertices.size(); ++i)
+				polyhedron->addVertex(vertices[i]);
+
+			for (unsigned int i = 0; i < indices.size(); ++i)
+				polyhedron->addIndex(indices[i]);
+
+			return polyhedron;
+		}
+
+	private:
+		inline uint64_t edgeKey(unsigned int a, unsigned int b)
+		{
+			return ((uint64_t)a << 32) | (uint64_t)b;
+		}
+
+		inline float distance(HullFace& face, unsigned int point)
+		{
+			return glm::dot(face.normal, (*points)[point]) - face.dist;
+		}
+
+		bool buildInitialSimplex()
+		{
+			const std::vector<glm::vec3>& p = *points;
+
+			// extreme points along each axis
+			unsigned int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+			for (unsigned int i = 1; i < p.size(); ++i)
+			{
+				for (unsigned int axis = 0; axis < 3; ++axis)
+				{
+					if (p[i][axis] < p[extremes[axis * 2]][axis])
+						extremes[axis * 2] = i;
+					if (p[i][axis] > p[extremes[axis * 2 + 1]][axis])
+						extremes[axis * 2 + 1] = i;
+				}
+			}
+
+			// the most distant pair forms the base line
+			unsigned int v0 = 0, v1 = 0;
+			float max_dist = -1.0f;
+			for (unsigned int i = 0; i < 6; ++i)
+			{
+				for (unsigned int j = i + 1; j < 6; ++j)
+				{
+					glm::vec3 d = p[extremes[i]] - p[extremes[j]];
+					float dist = glm::dot(d, d);
+					if (dist > max_dist)
+					{
+						max_dist = dist;
+						v0 = extremes[i];
+						v1 = extremes[j];
+					}
+				}
+			}
+			if (max_dist <= tolerance * tolerance)
+				return false;
+
+			// furthest from the line
+			glm::vec3 line = glm::normalize(p[v1] - p[v0]);
+			unsigned int v2 = 0;
+			max_dist = -1.0f;
+			for (unsigned int i = 0; i < p.size(); ++i)
+			{
+				glm::vec3 d = p[i] - p[v0];
+				d -= line * glm::dot(d, line);
+				float dist = glm::dot(d, d);
+				if (dist > max_dist)
+				{
+					max_dist = dist;
+					v2 = i;
+				}
+			}
+			if (max_dist <= tolerance * tolerance)
+				return false;
+
+			// furthest from the plane
+			glm::vec3 plane = glm::normalize(glm::cross(p[v1] - p[v0], p[v2] - p[v0]));
+			unsigned int v3 = 0;
+			max_dist = -1.0f;
+			for (unsigned int i = 0; i < p.size(); ++i)
+			{
+				float dist = glm::abs(glm::dot(p[i] - p[v0], plane));
+				if (dist > max_dist)
+				{
+					max_dist = dist;
+					v3 = i;
+				}
+			}
+			if (max_dist <= tolerance)
+				return false;
+
+			// wound so the fourth point is behind the first face, the other faces follow from it
+			if (glm::dot(glm::cross(p[v1] - p[v0], p[v2] - p[v0]), p[v3] - p[v0]) > 0.0f)
+				std::swap(v1, v2);
+
+			addFace(v0, v1, v2);
+			addFace(v0, v3, v1);
+			addFace(v1, v3, v2);
+			addFace(v2, v3, v0);
+
+			std::vector<unsigned int> all;
+			all.reserve(p.size());
+			for (unsigned int i = 0; i < p.size(); ++i)
+			{
+				if (i != v0 && i != v1 && i != v2 && i != v3)
+					all.push_back(i);
+			}
+			assignPoints(all, 0);
+
+			return true;
+		}
+
+		unsigned int addFace(unsigned int a, unsigned int b, unsigned int c)
+		{
+			const std::vector<glm::vec3>& p = *points;
+
+			HullFace face;
+			face.v[0] = a;
+			face.v[1] = b;
+			face.v[2] = c;
+			face.normal = glm::cross(p[b] - p[a], p[c] - p[a]);
+			float length = glm::length(face.normal);
+			face.normal = length > 0.0f ? face.normal / length : glm::vec3(0.0f);
+			face.dist = glm::dot(face.normal, p[a]);
+			face.furthest = 0;
+			face.furthest_dist = 0.0f;
+			face.removed = false;
+
+			faces.push_back(face);
+			addEdges(faces.size() - 1);
+			return faces.size() - 1;
+		}
+
+		void addEdges(unsigned int f)
+		{
+			for (unsigned int i = 0; i < 3; ++i)
+				edge_faces[edgeKey(faces[f].v[i], faces[f].v[(i + 1) % 3])] = f;
+		}
+
+		void removeEdges(unsigned int f)
+		{
+			for (unsigned int i = 0; i < 3; ++i)
+			{
+				auto it = edge_faces.find(edgeKey(faces[f].v[i], faces[f].v[(i + 1) % 3]));
+				if (it != edge_faces.end() && it->second == f)
+					edge_faces.erase(it);
+			}
+		}
+
+		// gives each point to the face it is furthest in front of, starting at first_face
+		void assignPoints(std::vector<unsigned int>& candidates, unsigned int first_face)
+		{
+			for (unsigned int i = 0; i < candidates.size(); ++i)
+			{
+				int best = -1;
+				float best_dist = tolerance;
+				for (unsigned int f = first_face; f < faces.size(); ++f)
+				{
+					if (faces[f].removed)
+						continue;
+					float dist = distance(faces[f], candidates[i]);
+					if (dist > best_dist)
+					{
+						best_dist = dist;
+						best = f;
+					}
+				}
+				if (best == -1)
+					continue; // inside the hull
+
+				HullFace& face = faces[best];
+				face.outside.push_back(candidates[i]);
+				if (best_dist > face.furthest_dist)
+				{
+					face.furthest_dist = best_dist;
+					face.furthest = candidates[i];
+				}
+			}
+		}
+
+		void addPoint(unsigned int eye, unsigned int start_face)
+		{
+			// flood fill the faces the eye point can see
+			std::vector<unsigned int> visible;
+			std::vector<unsigned int> stack;
+			stack.push_back(start_face);
+			faces[start_face].removed = true;
+			while (!stack.empty())
+			{
+				unsigned int f = stack.back();
+				stack.pop_back();
+				visible.push_back(f);
+
+				for (unsigned int i = 0; i < 3; ++i)
+				{
+					auto it = edge_faces.find(edgeKey(faces[f].v[(i + 1) % 3], faces[f].v[i]));
+					if (it == edge_faces.end())
+						continue;
+					HullFace& neighbor = faces[it->second];
+					if (!neighbor.removed && distance(neighbor, eye) > tolerance)
+					{
+						neighbor.removed = true;
+						stack.push_back(it->second);
+					}
+				}
+			}
+
+			// horizon edges belong to a visible face and a hidden one
+			std::vector<unsigned int> horizon;
+			for (unsigned int i = 0; i < visible.size(); ++i)
+			{
+				HullFace& face = faces[visible[i]];
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					unsigned int a = face.v[j];
+					unsigned int b = face.v[(j + 1) % 3];
+					auto it = edge_faces.find(edgeKey(b, a));
+					if (it == edge_faces.end() || !faces[it->second].removed)
+					{
+						horizon.push_back(a);
+						horizon.push_back(b);
+					}
+				}
+			}
+
+			std::vector<unsigned int> orphans;
+			for (unsigned int i = 0; i < visible.size(); ++i)
+			{
+				HullFace& face = faces[visible[i]];
+				removeEdges(visible[i]);
+				for (unsigned int j = 0; j < face.outside.size(); ++j)
+				{
+					if (face.outside[j] != eye)
+						orphans.push_back(face.outside[j]);
+				}
+				face.outside.clear();
+				face.outside.shrink_to_fit();
+			}
+
+			unsigned int first_new = faces.size();
+			for (unsigned int i = 0; i < horizon.size(); i += 2)
+				addFace(horizon[i], horizon[i + 1], eye);
+
+			assignPoints(orphans, first_new);
+		}
+
+		void mergeFaces(float min_cos)
+		{
+			const std::vector<glm::vec3>& p = *points;
+
+			std::vector<int> group(faces.size(), -1);
+			std::vector<std::vector<unsigned int>> groups;
+
+			// grow each group across edges while the neighbor stays on the seed plane
+			for (unsigned int seed = 0; seed < faces.size(); ++seed)
+			{
+				if (faces[seed].removed || group[seed] != -1)
+					continue;
+
+				int id = groups.size();
+				groups.push_back(std::vector<unsigned int>());
+				group[seed] = id;
+
+				std::vector<unsigned int> stack;
+				stack.push_back(seed);
+				while (!stack.empty())
+				{
+					unsigned int f = stack.back();
+					stack.pop_back();
+					groups[id].push_back(f);
+
+					for (unsigned int i = 0; i < 3; ++i)
+					{
+						auto it = edge_faces.find(edgeKey(faces[f].v[(i + 1) % 3], faces[f].v[i]));
+						if (it == edge_faces.end() || group[it->second] != -1)
+							continue;
+
+						HullFace& neighbor = faces[it->second];
+						if (glm::dot(neighbor.normal, faces[seed].normal) < min_cos)
+							continue;
+
+						bool coplanar = true;
+						for (unsigned int j = 0; j < 3; ++j)
+							coplanar &= glm::abs(distance(faces[seed], neighbor.v[j])) <= tolerance;
+						if (!coplanar)
+							continue;
+
+						group[it->second] = id;
+						stack.push_back(it->second);
+					}
+				}
+			}
+
+			// boundary loop of each group, left empty when the group keeps its triangles
+			std::vector<std::vector<unsigned int>> loops(groups.size());
+			for (unsigned int g = 0; g < groups.size(); ++g)
+			{
+				std::unordered_map<unsigned int, unsigned int> next;
+				for (unsigned int i = 0; i < groups[g].size(); ++i)
+				{
+					HullFace& face = faces[groups[g][i]];
+					for (unsigned int j = 0; j < 3; ++j)
+					{
+						unsigned int a = face.v[j];
+						unsigned int b = face.v[(j + 1) % 3];
+						auto it = edge_faces.find(edgeKey(b, a));
+						if (it == edge_faces.end() || group[it->second] != (int)g)
+							next[a] = b;
+					}
+				}
+
+				unsigned int start = next.begin()->first;
+				unsigned int v = start;
+				do
+				{
+					loops[g].push_back(v);
+					auto it = next.find(v);
+					if (it == next.end() || loops[g].size() > next.size())
+						break;
+					v = it->second;
+				} while (v != start);
+
+				// not a simple polygon
+				if (v != start || loops[g].size() != next.size())
+					loops[g].clear();
+
+				// nearly coplanar faces can bend the polygon inwards, fanning it would cut outside the hull
+				glm::vec3 normal = faces[groups[g][0]].normal;
+				unsigned int n = loops[g].size();
+				for (unsigned int i = 0; i < n; ++i)
+				{
+					glm::vec3 d1 = p[loops[g][i]] - p[loops[g][(i + n - 1) % n]];
+					glm::vec3 d2 = p[loops[g][(i + 1) % n]] - p[loops[g][i]];
+					if (glm::dot(glm::cross(d1, d2), normal) < -min_sharpness * glm::length(d1) * glm::length(d2))
+					{
+						loops[g].clear();
+						break;
+					}
+				}
+			}
+
+			// a vertex stays if it is a corner of any polygon or used by kept triangles,
+			// dropping it from one side of an edge only would leave the other side without a twin
+			std::unordered_map<unsigned int, bool> corner;
+			for (unsigned int g = 0; g < groups.size(); ++g)
+			{
+				if (loops[g].empty())
+				{
+					for (unsigned int i = 0; i < groups[g].size(); ++i)
+					{
+						for (unsigned int j = 0; j < 3; ++j)
+							corner[faces[groups[g][i]].v[j]] = true;
+					}
+					continue;
+				}
+
+				unsigned int n = loops[g].size();
+				for (unsigned int i = 0; i < n; ++i)
+				{
+					unsigned int cur = loops[g][i];
+					corner[cur] = corner[cur] || isCorner(loops[g][(i + n - 1) % n], cur, loops[g][(i + 1) % n]);
+				}
+			}
+
+			std::unordered_map<unsigned int, unsigned int> remap;
+			for (unsigned int g = 0; g < groups.size(); ++g)
+			{
+				if (loops[g].empty())
+				{
+					for (unsigned int i = 0; i < groups[g].size(); ++i)
+					{
+						HullFace& face = faces[groups[g][i]];
+						addTriangle(face.v[0], face.v[1], face.v[2], remap);
+					}
+					continue;
+				}
+
+				std::vector<unsigned int> polygon;
+				for (unsigned int i = 0; i < loops[g].size(); ++i)
+				{
+					if (corner[loops[g][i]])
+						polygon.push_back(loops[g][i]);
+				}
+
+				// ear clipping from the sharpest corner, collinear vertices kept for a neighbor
+				// are never the tip of an ear so no triangle is flat
+				while (polygon.size() > 3)
+				{
+					unsigned int n = polygon.size();
+					unsigned int ear = 0;
+					float max_sharpness = 0.0f;
+					for (unsigned int i = 0; i < n; ++i)
+					{
+						float sharpness = cornerSharpness(polygon[(i + n - 1) % n], polygon[i], polygon[(i + 1) % n]);
+						if (sharpness > max_sharpness)
+						{
+							max_sharpness = sharpness;
+							ear = i;
+						}
+					}
+					if (max_sharpness <= min_sharpness)
+						break;
+
+					addTriangle(polygon[(ear + n - 1) % n], polygon[ear], polygon[(ear + 1) % n], remap);
+					polygon.erase(polygon.begin() + ear);
+				}
+				if (polygon.size() == 3)
+					addTriangle(polygon[0], polygon[1], polygon[2], remap);
+			}
+		}
+
+		// the faces of the build without merging
+		void addFaces()
+		{
+			std::unordered_map<unsigned int, unsigned int> remap;
+			for (unsigned int i = 0; i < faces.size(); ++i)
+			{
+				if (!faces[i].removed)
+					addTriangle(faces[i].v[0], faces[i].v[1], faces[i].v[2], remap);
+			}
+		}
+
+		void addTriangle(unsigned int a, unsigned int b, unsigned int c, std::unordered_map<unsigned int, unsigned int>& remap)
+		{
+			unsigned int v[3] = { a, b, c };
+			glm::uvec3 triangle;
+			for (unsigned int i = 0; i < 3; ++i)
+			{
+				auto it = remap.find(v[i]);
+				if (it == remap.end())
+				{
+					it = remap.insert({ v[i], (unsigned int)vertices.size() }).first;
+					vertices.push_back((*points)[v[i]]);
+				}
+				triangle[i] = it->second;
+			}
+			indices.push_back(triangle);
+		}
+
+		// sine of the turn at cur
+		float cornerSharpness(unsigned int prev, unsigned int cur, unsigned int next)
+		{
+			const std::vector<glm::vec3>& p = *points;
+			glm::vec3 d1 = p[cur] - p[prev];
+			glm::vec3 d2 = p[next] - p[cur];
+			float length = glm::length(d1) * glm::length(d2);
+			return length > 0.0f ? glm::length(glm::cross(d1, d2)) / length : 0.0f;
+		}
+
+		bool isCorner(unsigned int prev, unsigned int cur, unsigned int next)
+		{
+			return cornerSharpness(prev, cur, next) > min_sharpness;
+		}
+
+		/**
+		Checks the output is a closed hull, every edge has exactly one twin
+		and no input point is in front of a triangle, except points a limit left outside
+		*/
+		bool isValid()
+		{
+			std::unordered_map<uint64_t, unsigned int> edges;
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					if (++edges[edgeKey(indices[i][j], indices[i][(j + 1) % 3])] > 1)
+						return false;
+				}
+			}
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					if (edges.find(edgeKey(indices[i][(j + 1) % 3], indices[i][j])) == edges.end())
+						return false;
+				}
+			}
+
+			// a point found inside a face that was replaced later can be slightly in front of the new faces,
+			// and the normals of thin triangles are rounded
+			const std::vector<glm::vec3>& p = *points;
+			float max_dist = 10.0f * tolerance;
+			std::vector<bool> skipped(p.size(), false);
+			for (unsigned int i = 0; i < faces.size(); ++i)
+			{
+				if (faces[i].removed)
+					continue;
+				for (unsigned int j = 0; j < faces[i].outside.size(); ++j)
+					skipped[faces[i].outside[j]] = true;
+			}
+
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				glm::vec3 a = vertices[indices[i].x];
+				glm::vec3 normal = glm::cross(vertices[indices[i].y] - a, vertices[indices[i].z] - a);
+				float length = glm::length(normal);
+				if (length <= 0.0f)
+					return false;
+				normal /= length;
+
+				for (unsigned int j = 0; j < p.size(); ++j)
+				{
+					if (!skipped[j] && glm::dot(normal, p[j] - a) > max_dist)
+						return false;
+				}
+			}
+			return true;
+		}
+	};
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Shape.h"
+#include "TriangleMesh.h"
+
+namespace fiz
+{
+	struct TerrainMaterial
+	{
+		float friction;
+		float restitution;
+	};
+
+	/**
+	Grid of heights for static terrain.
+	The grid is centered on the body origin in x and y, with heights along z.
+	Each cell is split into two triangles along the diagonal from its
+	lowest corner to its highest corner in x and y, and each cell has a
+	material index. Heights can be quantized to 16 bits to save memory.
+	*/
+	class Heightfield final : public Shape
+	{
+	public:
+		unsigned int columns; // cells along x
+		unsigned int rows; // cells along y
+		float cell_size;
+
+		bool quantized;
+		std::vector<float> heights; // (columns + 1) * (rows + 1) samples, row major
+		std::vector<uint16_t> quantized_heights;
+		float height_scale;
+		float min_height;
+		float max_height;
+
+		std::vector<uint8_t> cell_materials;
+		std::vector<TerrainMaterial> materials;
+
+		Heightfield(unsigned int columns, unsigned int rows, float cell_size, const std::vector<float>& samples, bool quantize = false) : columns(columns), rows(rows), cell_size(cell_size), quantized(quantize)
+		{
+			shape_type = HEIGHTFIELD_TYPE;
+			volume = 0.0f;
+			centroid = glm::vec3(0.0f);
+			local_inertia = glm::vec3(0.0f);
+			local_products = glm::vec3(0.0f);
+
+			min_height = samples[0];
+			max_height = samples[0];
+			for (unsigned int i = 1; i < samples.size(); ++i)
+			{
+				min_height = glm::min(min_height, samples[i]);
+				max_height = glm::max(max_height, samples[i]);
+			}
+
+			if (quantized)
+			{
+				height_scale = (max_height - min_height) / 65535.0f;
+				quantized_heights.resize(samples.size());
+				for (unsigned int i = 0; i < samples.size(); ++i)
+				{
+					float q = height_scale > 0.0f ? (samples[i] - min_height) / height_scale : 0.0f;
+					quantized_heights[i] = (uint16_t)glm::clamp(q + 0.5f, 0.0f, 65535.0f);
+				}
+			}
+			else
+			{
+				height_scale = 1.0f;
+				heights = samples;
+			}
+
+			materials.push_back({ 0.8f, 0.1f });
+			cell_materials.assign(columns * rows, 0);
+		}
+
+		unsigned int addMaterial(float friction, float restitution)
+		{
+			materials.push_back({ friction, restitution });
+			return materials.size() - 1;
+		}
+
+		void setCellMaterial(unsigned int x, unsigned int y, unsigned int material)
+		{
+			cell_materials[y * columns + x] = material;
+		}
+
+		/**
+		Returns the material of a cell triangle
+		*/
+		TerrainMaterial& getMaterial(unsigned int triangle)
+		{
+			return materials[cell_materials[triangle / 2]];
+		}
+
+		inline float getHeight(unsigned int x, unsigned int y)
+		{
+			unsigned int index = y * (columns + 1) + x;
+			if (quantized)
+				return min_height + quantized_heights[index] * height_scale;
+			return heights[index];
+		}
+
+		inline glm::vec3 getVertex(unsigned int x, unsigned int y)
+		{
+			return glm::vec3(x * cell_size - columns * cell_size * 0.5f, y * cell_size - rows * cell_size * 0.5f, getHeight(x, y));
+		}
+
+		/**
+		Finds the range of cells under an AABB in heightfield coordinates
+		Returns false if the AABB is outside of the terrain
+		*/
+		bool getCellRange(const AABB& local_aabb, int& min_x, int& min_y, int& max_x, int& max_y)
+		{
+			if (local_aabb.min.z > max_height || local_aabb.max.z < min_height)
+				return false;
+
+			float half_width = columns * cell_size * 0.5f;
+			float half_depth = rows * cell_size * 0.5f;
+			min_x = (int)glm::floor((local_aabb.min.x + half_width) / cell_size);
+			min_y = (int)glm::floor((local_aabb.min.y + half_depth) / cell_size);
+			max_x = (int)glm::floor((local_aabb.max.x + half_width) / cell_size);
+			max_y = (int)glm::floor((local_aabb.max.y + half_depth) / cell_size);
+
+			if (max_x < 0 || max_y < 0 || min_x >= (int)columns || min_y >= (int)rows)
+				return false;
+
+			min_x = glm::max(min_x, 0);
+			min_y = glm::max(min_y, 0);
+			max_x = glm::min(max_x, (int)columns - 1);
+			max_y = glm::min(max_y, (int)rows - 1);
+			return true;
+		}
+
+		/**
+		Triangle k of cell (x, y), indexed as (y * columns + x) * 2 + k
+		*/
+		Triangle getTriangle(unsigned int triangle)
+		{
+			unsigned int cell = triangle / 2;
+			unsigned int x = cell % columns;
+			unsigned int y = cell / columns;
+			if (triangle % 2 == 0)
+				return Triangle(getVertex(x, y), getVertex(x + 1, y), getVertex(x + 1, y + 1));
+			return Triangle(getVertex(x, y), getVertex(x + 1, y + 1), getVertex(x, y + 1));
+		}
+
+		glm::vec3 getNormal(Triangle& triangle)
+		{
+			return glm::normalize(glm::cross(triangle.v[1] - triangle.v[0], triangle.v[2] - triangle.v[0]));
+		}
+
+		/**
+		Flags the edges of a cell triangle that are convex or on the border, see TriangleMesh
+		*/
+		uint8_t getConvexEdges(unsigned int triangle, Triangle& tri, const glm::vec3& normal)
+		{
+			unsigned int cell = triangle / 2;
+			int x = cell % columns;
+			int y = cell / columns;
+
+			// grid sample opposite each edge on the neighboring triangle
+			glm::ivec2 opposite[3];
+			if (triangle % 2 == 0)
+			{
+				opposite[0] = glm::ivec2(x, y - 1); // bottom edge
+				opposite[1] = glm::ivec2(x + 2, y + 1); // right edge
+				opposite[2] = glm::ivec2(x, y + 1); // diagonal
+			}
+			else
+			{
+				opposite[0] = glm::ivec2(x + 1, y); // diagonal
+				opposite[1] = glm::ivec2(x + 1, y + 2); // top edge
+				opposite[2] = glm::ivec2(x - 1, y); // left edge
+			}
+
+			uint8_t convex = 0;
+			for (unsigned int e = 0; e < 3; ++e)
+			{
+				if (opposite[e].x < 0 || opposite[e].y < 0 || opposite[e].x > (int)columns || opposite[e].y > (int)rows)
+				{
+					convex |= 1 << e; // border edge
+					continue;
+				}
+
+				glm::vec3 a = tri.v[e];
+				float edge_length = glm::length(tri.v[(e + 1) % 3] - a);
+				float height = glm::dot(normal, getVertex(opposite[e].x, opposite[e].y) - a);
+				if (height < -0.001f * edge_length)
+					convex |= 1 << e;
+			}
+			return convex;
+		}
+
+		glm::vec3 support(glm::vec3)
+		{
+			// terrain has no support mapping, narrowphase uses its cell triangles
+			return glm::vec3(0.0f);
+		}
+
+		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
+		{
+			float half_width = columns * cell_size * 0.5f;
+			float half_depth = rows * cell_size * 0.5f;
+			AABB local(glm::vec3(-half_width, -half_depth, min_height), glm::vec3(half_width, half_depth, max_height));
+			*aabb = local.transform(orientation, position);
+		}
+
+		/**
+		Walks the cells under the ray in order with a 2D DDA
+		and returns the first triangle hit
+		*/
+		float castRay(Ray& ray)
+		{
+			float half_width = columns * cell_size * 0.5f;
+			float half_depth = rows * cell_size * 0.5f;
+
+			// clip the ray to the bounds of the terrain
+			glm::vec3 bounds_min(-half_width, -half_depth, min_height);
+			glm::vec3 bounds_max(half_width, half_depth, max_height);
+			float t_enter = 0.0f;
+			float t_exit = 9999999.9f;
+			for (unsigned int i = 0; i < 3; ++i)
+			{
+				if (glm::abs(ray.dir[i]) < 0.0000001f)
+				{
+					if (ray.start[i] < bounds_min[i] || ray.start[i] > bounds_max[i])
+						return 0.0f;
+					continue;
+				}
+				float t1 = (bounds_min[i] - ray.start[i]) / ray.dir[i];
+				float t2 = (bounds_max[i] - ray.start[i]) / ray.dir[i];
+				t_enter = glm::max(t_enter, glm::min(t1, t2));
+				t_exit = glm::min(t_exit, glm::max(t1, t2));
+			}
+			if (t_enter > t_exit)
+				return 0.0f;
+
+			glm::vec3 entry = ray.start + ray.dir * t_enter;
+			int x = glm::clamp((int)glm::floor((entry.x + half_width) / cell_size), 0, (int)columns - 1);
+			int y = glm::clamp((int)glm::floor((entry.y + half_depth) / cell_size), 0, (int)rows - 1);
+
+			int step_x = ray.dir.x > 0.0f ? 1 : -1;
+			int step_y = ray.dir.y > 0.0f ? 1 : -1;
+
+			// ray distance to the next cell border and between cell borders
+			float delta_x = glm::abs(ray.dir.x) > 0.0000001f ? cell_size / glm::abs(ray.dir.x) : 9999999.9f;
+			float delta_y = glm::abs(ray.dir.y) > 0.0000001f ? cell_size / glm::abs(ray.dir.y) : 9999999.9f;
+			float next_x = 9999999.9f;
+			float next_y = 9999999.9f;
+			if (glm::abs(ray.dir.x) > 0.0000001f)
+				next_x = ((x + (step_x > 0 ? 1 : 0)) * cell_size - half_width - ray.start.x) / ray.dir.x;
+			if (glm::abs(ray.dir.y) > 0.0000001f)
+				next_y = ((y + (step_y > 0 ? 1 : 0)) * cell_size - half_depth - ray.start.y) / ray.dir.y;
+
+			while (x >= 0 && y >= 0 && x < (int)columns && y < (int)rows)
+			{
+				unsigned int cell = y * columns + x;
+				float hit = castRayCell(ray, cell);
+				if (hit < 9999999.9f)
+					return hit;
+
+				if (glm::min(next_x, next_y) > t_exit)
+					break;
+
+				if (next_x < next_y)
+				{
+					x += step_x;
+					next_x += delta_x;
+				}
+				else
+				{
+					y += step_y;
+					next_y += delta_y;
+				}
+			}
+			return 0.0f;
+		}
+
+	private:
+		// ray distance to the nearer triangle of a cell, 9999999.9f if it misses both
+		float castRayCell(Ray& ray, unsigned int cell)
+		{
+			float hit = 9999999.9f;
+			for (unsigned int i = 0; i < 2; ++i)
+			{
+				Triangle triangle = getTriangle(cell * 2 + i);
+				float t = rayTriangle(ray, triangle.v[0], triangle.v[1], triangle.v[2]);
+				if (t > 0.000001f)
+					hit = glm::min(hit, t);
+			}
+			return hit;
+		}
+	};
+}
@@ -12,6 +12,34 @@ namespace fiz
 		glm::vec3 dir;
 	};
 
+	/**
+	Ray distance to the triangle abc with Moller-Trumbore, negative if the triangle is behind
+	the start and -9999999.9f if the ray misses it or runs along its plane
+	*/
+	inline float rayTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		glm::vec3 e1 = b - a;
+		glm::vec3 e2 = c - a;
+
+		glm::vec3 ray_cross_e2 = glm::cross(ray.dir, e2);
+		float det = glm::dot(e1, ray_cross_e2);
+		if (glm::abs(det) < 0.0000001f)
+			return -9999999.9f;
+
+		float inv_det = 1.0f / det;
+		glm::vec3 s = ray.start - a;
+		float u = inv_det * glm::dot(s, ray_cross_e2);
+		if (u < 0 || u > 1)
+			return -9999999.9f;
+
+		glm::vec3 s_cross_e1 = glm::cross(s, e1);
+		float v = inv_det * glm::dot(ray.dir, s_cross_e1);
+		if (v < 0 || u + v > 1.0f)
+			return -9999999.9f;
+
+		return inv_det * glm::dot(e2, s_cross_e1);
+	}
+
 	class AABB
 	{
 	public:
@@ -59,6 +87,31 @@ namespace fiz
 			bool z = max.z > other.min.z && min.z < other.max.z;
 			return x && y && z;
 		}
+		/**
+		Returns the bounds of this AABB after it is rotated and translated
+		*/
+		AABB transform(const glm::mat3& rotation, const glm::vec3& translation) const
+		{
+			glm::vec3 center = (min + max) * 0.5f;
+			glm::vec3 extent = (max - min) * 0.5f;
+
+			glm::vec3 new_center = rotation * center + translation;
+			glm::vec3 new_extent;
+			for (unsigned int i = 0; i < 3; ++i)
+			{
+				new_extent[i] = glm::abs(rotation[0][i]) * extent.x +
+								glm::abs(rotation[1][i]) * extent.y +
+								glm::abs(rotation[2][i]) * extent.z;
+			}
+			return AABB(new_center - new_extent, new_center + new_extent);
+		}
+		/**
+		Returns the bounds covering this AABB as it moves along displacement
+		*/
+		AABB sweep(const glm::vec3& displacement) const
+		{
+			return AABB(min + glm::min(displacement, glm::vec3(0.0f)), max + glm::max(displacement, glm::vec3(0.0f)));
+		}
 		int maxExtent() const
 		{
 			glm::vec3 extent = max - min;
@@ -105,7 +158,8 @@ namespace fiz
 			tmin = glm::max(tmin, glm::min(tz1, tz2));
 			tmax = glm::min(tmax, glm::max(tz1, tz2));
 
-			return tmax > tmin;
+			// the flat bounds of a single triangle are entered and left at the same distance
+			return tmax >= tmin;
 		}
 	};
 
@@ -115,7 +169,11 @@ namespace fiz
 		CYLINDER_TYPE,
 		BOX_TYPE,
 		CAPSULE_TYPE,
-		POLYHEDRON_TYPE
+		POLYHEDRON_TYPE,
+		TRIANGLE_TYPE,
+		TRIANGLE_MESH_TYPE,
+		HEIGHTFIELD_TYPE,
+		PLANE_TYPE
 	};
 
 	class Shape
@@ -136,6 +194,14 @@ namespace fiz
 
 		virtual void computeMassProperties() {}
 
+		// a copy that bodies can move without changing the shape, null for shapes only static bodies use
+		virtual Shape* clone() { return nullptr; }
+
+		// moves the shape in body coordinates
+		virtual void translate(const glm::vec3&) {}
+
+		virtual ~Shape() {}
+
 		virtual float castRay(Ray& ray) { return -1.0f; }
 	};
 
@@ -162,8 +228,9 @@ namespace fiz
 
 		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
 		{
-			aabb->min = position - glm::vec3(rad);
-			aabb->max = position + glm::vec3(rad);
+			glm::vec3 center = position + orientation * pos;
+			aabb->min = center - glm::vec3(rad);
+			aabb->max = center + glm::vec3(rad);
 		}
 
 		void computeMassProperties()
@@ -179,6 +246,16 @@ namespace fiz
 			local_products.z = 0.0f;
 		}
 
+		Shape* clone()
+		{
+			return new Sphere(*this);
+		}
+
+		void translate(const glm::vec3& offset)
+		{
+			pos += offset;
+		}
+
 		float castRay(Ray& ray)
 		{
 			float a = glm::dot(ray.dir, ray.dir);
@@ -233,9 +310,16 @@ namespace fiz
 
 		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
 		{
-			float extent = glm::length(dim);
-			aabb->min = position - glm::vec3(extent);
-			aabb->max = position + glm::vec3(extent);
+			glm::vec3 center = position + orientation * pos;
+			glm::vec3 extent;
+			for (unsigned int i = 0; i < 3; ++i)
+			{
+				extent[i] = glm::abs(orientation[0][i]) * dim.x +
+							glm::abs(orientation[1][i]) * dim.y +
+							glm::abs(orientation[2][i]) * dim.z;
+			}
+			aabb->min = center - extent;
+			aabb->max = center + extent;
 		}
 
 		void computeMassProperties()
@@ -253,6 +337,16 @@ namespace fiz
 			local_products.z = 0.0f;
 		}
 
+		Shape* clone()
+		{
+			return new Box(*this);
+		}
+
+		void translate(const glm::vec3& offset)
+		{
+			pos += offset;
+		}
+
 		float castRay(Ray& ray)
 		{
 			AABB aabb = AABB(pos - dim, pos + dim);
@@ -340,14 +434,20 @@ namespace fiz
 				planar.y = 0.0f;
 			}
 			planar.z = axis.z > 0 ? height : -height;
-			return planar;
+			return pos + planar;
 		}
 
 		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
 		{
-			float extent = glm::sqrt(rad * rad + height * height);
-			aabb->min = position - glm::vec3(extent);
-			aabb->max = position + glm::vec3(extent);
+			glm::vec3 center = position + orientation * pos;
+
+			// the caps stick out by the height along the axis and by the radius across it
+			glm::vec3 axis = orientation[2];
+			glm::vec3 extent;
+			for (unsigned int i = 0; i < 3; ++i)
+				extent[i] = glm::abs(axis[i]) * height + rad * glm::sqrt(glm::max(1.0f - axis[i] * axis[i], 0.0f));
+			aabb->min = center - extent;
+			aabb->max = center + extent;
 		}
 
 		void computeMassProperties()
@@ -364,11 +464,23 @@ namespace fiz
 			local_products.z = 0.0f;
 		}
 
+		Shape* clone()
+		{
+			return new Cylinder(*this);
+		}
+
+		void translate(const glm::vec3& offset)
+		{
+			pos += offset;
+		}
+
 		float castRay(Ray& ray)
 		{
+			glm::vec3 start = ray.start - pos;
+
 			float a = ray.dir.x * ray.dir.x + ray.dir.y * ray.dir.y;
-			float b = 2.0f * (ray.start.x * ray.dir.x + ray.start.y * ray.dir.y);
-			float c = ray.start.x * ray.start.x + ray.start.y * ray.start.y - rad * rad;
+			float b = 2.0f * (start.x * ray.dir.x + start.y * ray.dir.y);
+			float c = start.x * start.x + start.y * start.y - rad * rad;
 
 			float desc = b * b - 4.0f * a * c;
 			if (desc < 0.0f)
@@ -377,16 +489,16 @@ namespace fiz
 
 			if (t > 0.000001f)
 			{
-				float h = ray.start.z + t * ray.dir.z;
+				float h = start.z + t * ray.dir.z;
 				if (h > height)
 				{
 					// check top
 					// find intersection with z = height
 					// height = o + dt
 					// t = (height - o) / d
-					float t2 = (height - ray.start.z) / ray.dir.z;
-					float tx = ray.start.x + t2 * ray.dir.x;
-					float ty = ray.start.y + t2 * ray.dir.y;
+					float t2 = (height - start.z) / ray.dir.z;
+					float tx = start.x + t2 * ray.dir.x;
+					float ty = start.y + t2 * ray.dir.y;
 					if (tx * tx + ty * ty < rad * rad)
 						return t2;
 					return 0.0f;
@@ -397,9 +509,9 @@ namespace fiz
 					// find intersection with z = -height
 					// -height = o + dt
 					// t = (-height - o) / d
-					float t2 = (-height - ray.start.z) / ray.dir.z;
-					float tx = ray.start.x + t2 * ray.dir.x;
-					float ty = ray.start.y + t2 * ray.dir.y;
+					float t2 = (-height - start.z) / ray.dir.z;
+					float tx = start.x + t2 * ray.dir.x;
+					float ty = start.y + t2 * ray.dir.y;
 					if (tx * tx + ty * ty < rad * rad)
 						return t2;
 					return 0.0f;
@@ -445,11 +557,12 @@ namespace fiz
 
 		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
 		{
-			aabb->min = position + orientation[2] * height - glm::vec3(rad);
-			aabb->max = position + orientation[2] * height + glm::vec3(rad);
+			glm::vec3 center = position + orientation * pos;
+			aabb->min = center + orientation[2] * height - glm::vec3(rad);
+			aabb->max = center + orientation[2] * height + glm::vec3(rad);
 
-			glm::vec3 bottom_min = position - orientation[2] * height - glm::vec3(rad);
-			glm::vec3 bottom_max = position - orientation[2] * height + glm::vec3(rad);
+			glm::vec3 bottom_min = center - orientation[2] * height - glm::vec3(rad);
+			glm::vec3 bottom_max = center - orientation[2] * height + glm::vec3(rad);
 			AABB bottom = AABB(bottom_min, bottom_max);
 
 			aabb->combine(bottom);
@@ -472,6 +585,16 @@ namespace fiz
 			local_products.y = 0.0f;
 			local_products.z = 0.0f;
 		}
+
+		Shape* clone()
+		{
+			return new Capsule(*this);
+		}
+
+		void translate(const glm::vec3& offset)
+		{
+			pos += offset;
+		}
 	};
 
 	class Polyhedron final : Shape
@@ -589,10 +712,17 @@ namespace fiz
 			local_products.x = -(intg[7] - volume * centroid.x * centroid.y);
 			local_products.y = -(intg[8] - volume * centroid.y * centroid.z);
 			local_products.z = -(intg[9] - volume * centroid.x * centroid.z);
+		}
+
+		Shape* clone()
+		{
+			return new Polyhedron(*this);
+		}
 
-			// temp moving centroid to origin
+		void translate(const glm::vec3& offset)
+		{
 			for (unsigned int i = 0; i < vertices.size(); ++i)
-				vertices[i] -= centroid;
+				vertices[i] += offset;
 		}
 
 		float castRay(Ray& ray)
@@ -600,37 +730,7 @@ namespace fiz
 			float closest_hit = 9999999.9f;
 			for (unsigned int i = 0; i < indices.size(); ++i)
 			{
-				const glm::vec3& a = vertices[indices[i].x];
-				const glm::vec3& b = vertices[indices[i].y];
-				const glm::vec3& c = vertices[indices[i].z];
-
-				glm::vec3 e1 = b - a;
-				glm::vec3 e2 = c - a;
-
-				glm::vec3 ray_cross_e2 = glm::cross(ray.dir, e2);
-
-				float det = glm::dot(e1, ray_cross_e2);
-
-				if (det > -0.000001f && det < 0.0000001f)
-					continue;
-
-				float inv_det = 1.0f / det;
-				glm::vec3 s = ray.start - a;
-
-				float u = inv_det * glm::dot(s, ray_cross_e2);
-
-				if (u < 0 || u > 1)
-					continue;
-
-				glm::vec3 s_cross_e1 = glm::cross(s, e1);
-
-				float v = inv_det * glm::dot(ray.dir, s_cross_e1);
-
-				if (v < 0 || u + v > 1.0f)
-					continue;
-
-				float t = inv_det * glm::dot(e2, s_cross_e1);
-
+				float t = rayTriangle(ray, vertices[indices[i].x], vertices[indices[i].y], vertices[indices[i].z]);
 				if (t > 0.000001f && t < closest_hit)
 					closest_hit = t;
 			}
@@ -651,4 +751,55 @@ namespace fiz
 			g2 = f2 + w2 * (f1 + w2);
 		}
 	};
+
+	/**
+	Half-space of the points below the plane dot(normal, x) = offset
+	Planes are infinite so static bodies with a plane are kept out of the BVH
+	and collide with every dynamic body in a separate pass
+	*/
+	class Plane final : public Shape
+	{
+	public:
+		glm::vec3 normal;
+		float offset;
+
+		Plane(glm::vec3 normal, float offset) : normal(glm::normalize(normal)), offset(offset)
+		{
+			shape_type = PLANE_TYPE;
+			volume = 0.0f;
+			centroid = glm::vec3(0.0f);
+			local_inertia = glm::vec3(0.0f);
+			local_products = glm::vec3(0.0f);
+		}
+
+		bool intersects(glm::vec3 point)
+		{
+			return glm::dot(normal, point) <= offset;
+		}
+
+		glm::vec3 support(glm::vec3)
+		{
+			// a half-space has no support mapping, it is tested with the support of the other shape
+			return normal * offset;
+		}
+
+		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
+		{
+			glm::vec3 point = position + orientation * (normal * offset);
+			aabb->min = point;
+			aabb->max = point;
+		}
+
+		float castRay(Ray& ray)
+		{
+			float d = glm::dot(normal, ray.dir);
+			if (d > -0.0000001f)
+				return 0.0f;
+
+			float t = (offset - glm::dot(normal, ray.start)) / d;
+			if (t > 0.000001f)
+				return t;
+			return 0.0f;
+		}
+	};
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Shape.h"
+#include "../acceleration/BVH.h"
+
+namespace fiz
+{
+	/**
+	A single triangle used as the convex shape in narrowphase against a mesh
+	*/
+	class Triangle final : public Shape
+	{
+	public:
+		glm::vec3 v[3];
+
+		Triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+		{
+			shape_type = TRIANGLE_TYPE;
+			v[0] = a;
+			v[1] = b;
+			v[2] = c;
+		}
+
+		glm::vec3 support(glm::vec3 axis)
+		{
+			float d0 = glm::dot(v[0], axis);
+			float d1 = glm::dot(v[1], axis);
+			float d2 = glm::dot(v[2], axis);
+			if (d0 > d1)
+				return d0 > d2 ? v[0] : v[2];
+			return d1 > d2 ? v[1] : v[2];
+		}
+
+		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
+		{
+			glm::vec3 a = orientation * v[0];
+			glm::vec3 b = orientation * v[1];
+			glm::vec3 c = orientation * v[2];
+			aabb->min = glm::min(a, glm::min(b, c)) + position;
+			aabb->max = glm::max(a, glm::max(b, c)) + position;
+		}
+	};
+
+	struct MeshTriangle
+	{
+		AABB aabb;
+		unsigned int index; // index into the triangles of the mesh
+	};
+
+	/**
+	Concave triangle mesh for static bodies.
+	Each triangle is tested on its own against convex shapes, found
+	through a BVH over the triangles in mesh coordinates.
+	Edges shared by two triangles are flagged as convex or not so
+	contacts on flat or concave seams can use the face normal.
+	*/
+	class TriangleMesh final : public Shape
+	{
+	public:
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::uvec3> indices;
+		std::vector<glm::vec3> normals; // face normal of each triangle
+		std::vector<uint8_t> convex_edges; // bit i is set if edge (i, i + 1) of a triangle is convex or open
+
+		std::vector<MeshTriangle> triangles;
+		BVH<MeshTriangle> tree;
+
+		TriangleMesh(const std::vector<glm::vec3>& mesh_vertices, const std::vector<glm::uvec3>& mesh_indices) : vertices(mesh_vertices), indices(mesh_indices), tree(&triangles)
+		{
+			shape_type = TRIANGLE_MESH_TYPE;
+			volume = 0.0f;
+			centroid = glm::vec3(0.0f);
+			local_inertia = glm::vec3(0.0f);
+			local_products = glm::vec3(0.0f);
+
+			normals.resize(indices.size());
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				glm::vec3 n = glm::cross(vertices[indices[i].y] - vertices[indices[i].x], vertices[indices[i].z] - vertices[indices[i].x]);
+				float length = glm::length(n);
+				normals[i] = length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+
+			computeEdgeConvexity();
+
+			triangles.resize(indices.size());
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				triangles[i].index = i;
+				triangles[i].aabb.min = glm::min(vertices[indices[i].x], glm::min(vertices[indices[i].y], vertices[indices[i].z]));
+				triangles[i].aabb.max = glm::max(vertices[indices[i].x], glm::max(vertices[indices[i].y], vertices[indices[i].z]));
+			}
+			if (!triangles.empty())
+				tree.createBVH();
+		}
+
+		TriangleMesh(const TriangleMesh&) = delete;
+		TriangleMesh& operator=(const TriangleMesh&) = delete;
+
+		Triangle getTriangle(unsigned int index)
+		{
+			return Triangle(vertices[indices[index].x], vertices[indices[index].y], vertices[indices[index].z]);
+		}
+
+		/**
+		Finds the triangles whose bounds intersect an AABB in mesh coordinates
+		*/
+		void query(AABB& local_aabb, std::vector<int>& hits)
+		{
+			if (!tree.is_built)
+				return;
+
+			std::vector<int> leaves;
+			tree.traverse(local_aabb, leaves);
+			for (unsigned int i = 0; i < leaves.size(); ++i)
+				hits.push_back(triangles[leaves[i]].index);
+		}
+
+		bool isEdgeConvex(unsigned int triangle, unsigned int edge)
+		{
+			return (convex_edges[triangle] >> edge) & 1;
+		}
+
+		glm::vec3 support(glm::vec3)
+		{
+			// a concave mesh has no support mapping, narrowphase uses its triangles
+			return glm::vec3(0.0f);
+		}
+
+		void setAABB(AABB* aabb, glm::vec3& position, glm::mat3& orientation)
+		{
+			glm::vec3 min = orientation * vertices[0];
+			glm::vec3 max = min;
+			for (unsigned int i = 1; i < vertices.size(); ++i)
+			{
+				glm::vec3 projected = orientation * vertices[i];
+				min = glm::min(min, projected);
+				max = glm::max(max, projected);
+			}
+			aabb->min = min + position;
+			aabb->max = max + position;
+		}
+
+		float castRay(Ray& ray)
+		{
+			if (!tree.is_built)
+				return 0.0f;
+
+			std::vector<int> leaves;
+			tree.traverse(&ray, leaves);
+
+			float closest_hit = 9999999.9f;
+			for (unsigned int i = 0; i < leaves.size(); ++i)
+			{
+				glm::uvec3& tri = indices[triangles[leaves[i]].index];
+				float t = rayTriangle(ray, vertices[tri.x], vertices[tri.y], vertices[tri.z]);
+				if (t > 0.000001f && t < closest_hit)
+					closest_hit = t;
+			}
+			return closest_hit < 9999999.9f ? closest_hit : 0.0f;
+		}
+
+	private:
+		void computeEdgeConvexity()
+		{
+			convex_edges.assign(indices.size(), 0);
+
+			// directed edge -> triangle and edge number
+			std::unordered_map<uint64_t, unsigned int> edges;
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				for (unsigned int e = 0; e < 3; ++e)
+				{
+					uint64_t a = indices[i][e];
+					uint64_t b = indices[i][(e + 1) % 3];
+					edges[(a << 32) | b] = i * 3 + e;
+				}
+			}
+
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				for (unsigned int e = 0; e < 3; ++e)
+				{
+					uint64_t a = indices[i][e];
+					uint64_t b = indices[i][(e + 1) % 3];
+					auto it = edges.find((b << 32) | a);
+					if (it == edges.end())
+					{
+						convex_edges[i] |= 1 << e; // open edge
+						continue;
+					}
+
+					// convex if the vertex opposite the edge on the neighbor is below this face
+					unsigned int neighbor = it->second / 3;
+					unsigned int opposite = indices[neighbor][(it->second % 3 + 2) % 3];
+					float edge_length = glm::length(vertices[b] - vertices[a]);
+					float height = glm::dot(normals[i], vertices[opposite] - vertices[a]);
+					if (height < -0.001f * edge_length)
+						convex_edges[i] |= 1 << e;
+				}
+			}
+		}
+	};
+}
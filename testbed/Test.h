@@ -39,6 +39,10 @@ public:
 	Shape* platform;
 	Shape* bowling_ball;
 	std::vector<Shape*> road_shapes;
+	Shape* road_mesh;
+	Shape* terrain;
+	Shape* half_space;
+	Shape* trigger;
 
 	void initShapes(DebugRenderer* renderer)
 	{
@@ -58,7 +62,37 @@ public:
 		ground = new Box(glm::vec3(0.0f), glm::vec3(50.0f, 50.0f, 0.5f));
 		platform = new Box(glm::vec3(0.0f), glm::vec3(1.0f, 2.0f, 0.1f));
 		bowling_ball = new Sphere(glm::vec3(0.0f), 0.7f);
-		road_shapes = renderer->loadPolyhedra("objects/race_track.obj", 1.0f);
+		road_shapes = renderer->loadPolyhedronAndDecompose("objects/race_track.obj", 1.0f);
+		road_mesh = renderer->loadTriangleMesh("objects/race_track.obj", 1.0f);
+		terrain = createTerrain();
+		renderer->addHeightfield(terrain);
+		half_space = new Plane(glm::vec3(0.0f, 0.0f, 1.0f), 0.0f);
+		trigger = new Box(glm::vec3(0.0f), glm::vec3(2.0f, 2.0f, 1.0f));
+	}
+
+	// rolling hills with an icy valley through the middle
+	Shape* createTerrain()
+	{
+		const unsigned int size = 64;
+		std::vector<float> samples;
+		samples.reserve((size + 1) * (size + 1));
+		for (unsigned int y = 0; y <= size; ++y)
+		{
+			for (unsigned int x = 0; x <= size; ++x)
+			{
+				float height = 1.5f * glm::sin(x * 0.2f) * glm::cos(y * 0.15f) + 0.5f * glm::sin(x * 0.07f + y * 0.11f);
+				samples.push_back(height);
+			}
+		}
+
+		Heightfield* heightfield = new Heightfield(size, size, 1.0f, samples, true);
+		unsigned int ice = heightfield->addMaterial(0.05f, 0.0f);
+		for (unsigned int y = 0; y < size; ++y)
+		{
+			for (unsigned int x = size / 2 - 4; x < size / 2 + 4; ++x)
+				heightfield->setCellMaterial(x, y, ice);
+		}
+		return heightfield;
 	}
 
 	void deleteShapes()
@@ -79,6 +113,10 @@ public:
 
 		for (unsigned int i = 0; i < road_shapes.size(); ++i)
 			delete(road_shapes[i]);
+		delete(road_mesh);
+		delete(terrain);
+		delete(half_space);
+		delete(trigger);
 	}
 };
 
@@ -416,6 +454,7 @@ public:
 		bd.angular_vel = glm::vec3(0.0f, -40.0f, 0.0f);
 		bd.linear_damping = 1.0f;
 		bd.angular_damping = 1.0f;
+		bd.ccd = true;
 		world.createBody(bd);
 
 		world.dynamic_dynamic_collision_listener = [](ContactInfo* info) {
@@ -429,7 +468,7 @@ class BoxTest : public Test
 public:
 	DynamicBody* body;
 	DynamicBody* body2;
-	DynamicBody* player;
+	BodyHandle player;
 	BoxTest()
 	{
 		world = World();
@@ -536,28 +575,50 @@ public:
 		bd.rotation_locked = true;
 		bd.friction = 0.5f;
 		bd.restitution = 0.0f;
-		player = (DynamicBody*)world.createBody(bd);
+		player = world.createDynamicBody(bd);
 
 		createChain(glm::vec3(5.0f, 0.0f, 5.0f));
 		createChain(glm::vec3(6.0f, 0.0f, 5.0f));
 		createChain(glm::vec3(7.0f, 0.0f, 5.0f));
 		createChain(glm::vec3(8.0f, 0.0f, 5.0f));
 		createChain(glm::vec3(9.0f, 0.0f, 5.0f));
+
+		// a longer chain in reduced coordinates, it doesn't stretch however few iters are used
+		createArticulatedChain(glm::vec3(11.0f, 0.0f, 12.0f), 12);
 		
-		/*bd.pos = glm::vec3(1.0f, 0.0f, 5.4f);
-		bd.shape = box;
+		// two flaps hinged about y, the first hangs from the world and swings down onto its limit
+		bd.shape = shapes.box;
+		bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 		bd.rotation_locked = false;
+		bd.pos = glm::vec3(1.8f, 0.0f, 5.4f);
 		DynamicBody* rev_a = (DynamicBody*)world.createBody(bd);
 
-		bd.pos = glm::vec3(2.6f, 1.2f, 5.4f);
+		bd.pos = glm::vec3(3.4f, 0.0f, 5.4f);
 		DynamicBody* rev_b = (DynamicBody*)world.createBody(bd);
 
+		AnchoredRevoluteJoint* anchored_rev_joint = new AnchoredRevoluteJoint();
+		anchored_rev_joint->body = rev_a;
+		anchored_rev_joint->local = glm::vec3(-0.8f, 0.0f, 0.0f);
+		anchored_rev_joint->local_axis = glm::vec3(0.0f, 1.0f, 0.0f);
+		anchored_rev_joint->anchor = glm::vec3(1.0f, 0.0f, 5.4f);
+		anchored_rev_joint->anchor_axis = glm::vec3(0.0f, 1.0f, 0.0f);
+		anchored_rev_joint->enable_limit = true;
+		anchored_rev_joint->lower_angle = -0.5f;
+		anchored_rev_joint->upper_angle = 1.0f;
+		world.addJoint(anchored_rev_joint);
+
 		RevoluteJoint* rev_joint = new RevoluteJoint();
 		rev_joint->a = rev_a;
 		rev_joint->b = rev_b;
-		rev_joint->local_a = glm::vec3(0.8f, 0.6f, 0.0f);
-		rev_joint->local_b = glm::vec3(-0.8f, -0.6f, 0.0f);
-		world.addJoint(rev_joint);*/
+		rev_joint->local_a = glm::vec3(0.8f, 0.0f, 0.0f);
+		rev_joint->local_b = glm::vec3(-0.8f, 0.0f, 0.0f);
+		rev_joint->local_axis_a = glm::vec3(0.0f, 1.0f, 0.0f);
+		rev_joint->local_axis_b = glm::vec3(0.0f, 1.0f, 0.0f);
+		rev_joint->enable_limit = true;
+		rev_joint->lower_angle = -0.5f;
+		rev_joint->upper_angle = 0.5f;
+		rev_joint->collide_connected = false;
+		world.addJoint(rev_joint);
 	}
 
 	void update(float dt)
@@ -569,20 +630,21 @@ public:
 	{
 		float speed = 4.0f;
 
-		player->setAwake();
-		player->vel.x = 0.0f;
-		player->vel.y = 0.0f;
+		DynamicBody* player_body = world.getBody(player);
+		player_body->setAwake();
+		player_body->vel.x = 0.0f;
+		player_body->vel.y = 0.0f;
 		if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-			player->vel.x = -speed;
+			player_body->vel.x = -speed;
 		if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
-			player->vel.x = speed;
+			player_body->vel.x = speed;
 		if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS)
-			player->vel.y = speed;
+			player_body->vel.y = speed;
 		if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-			player->vel.y = -speed;
+			player_body->vel.y = -speed;
 
 		if (glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS)
-			player->vel.z = speed;
+			player_body->vel.z = speed;
 	}
 
 private:
@@ -626,6 +688,525 @@ private:
 		}
 	}
 
+	void createArticulatedChain(glm::vec3 pos, unsigned int count)
+	{
+		BodyDef bd;
+		float capsule_rad = 0.2f;
+		float height = capsule_rad * 4.0f;
+		float spacing = 0.1f;
+		bd.shape = shapes.small_capsule;
+		bd.friction = 0.2f;
+		bd.restitution = 0.1f;
+		bd.linear_damping = 0.999f;
+		bd.angular_damping = 0.999f;
+
+		Articulation* articulation = new Articulation();
+		int prev = -1;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			bd.pos = pos;
+			bd.pos.z -= i * (height + spacing);
+			DynamicBody* body = (DynamicBody*)world.createBody(bd);
+
+			glm::vec3 anchor = bd.pos + glm::vec3(0.0f, 0.0f, height * 0.5f + spacing * 0.5f);
+			prev = articulation->addLink(body, prev, ARTICULATION_SPHERICAL, anchor);
+		}
+		world.addArticulation(articulation);
+	}
+
+};
+
+class CompoundTest : public Test
+{
+	std::vector<Shape*> dumbbell_shapes;
+	std::vector<Shape*> table_shapes;
+
+public:
+	CompoundTest()
+	{
+		world = World();
+
+		dumbbell_shapes.push_back(new Box(glm::vec3(0.0f), glm::vec3(0.6f, 0.08f, 0.08f)));
+		dumbbell_shapes.push_back(new Sphere(glm::vec3(-0.7f, 0.0f, 0.0f), 0.25f));
+		dumbbell_shapes.push_back(new Sphere(glm::vec3(0.7f, 0.0f, 0.0f), 0.25f));
+
+		table_shapes.push_back(new Box(glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.8f, 0.5f, 0.05f)));
+		table_shapes.push_back(new Box(glm::vec3(-0.7f, -0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+		table_shapes.push_back(new Box(glm::vec3(0.7f, -0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+		table_shapes.push_back(new Box(glm::vec3(-0.7f, 0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+		table_shapes.push_back(new Box(glm::vec3(0.7f, 0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+	}
+	~CompoundTest()
+	{
+		for (unsigned int i = 0; i < dumbbell_shapes.size(); ++i)
+			delete(dumbbell_shapes[i]);
+		for (unsigned int i = 0; i < table_shapes.size(); ++i)
+			delete(table_shapes[i]);
+	}
+
+	void initialize()
+	{
+		BodyDef bd;
+		bd.friction = 0.4f;
+		bd.angular_damping = 0.99f;
+
+		// one body per table instead of five jointed bodies
+		bd.shape = table_shapes[0];
+		bd.child_shapes.assign(table_shapes.begin() + 1, table_shapes.end());
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			bd.pos = glm::vec3(i * 2.0f - 3.0f, 0.0f, 1.0f);
+			world.createBody(bd);
+		}
+
+		bd.shape = dumbbell_shapes[0];
+		bd.child_shapes.assign(dumbbell_shapes.begin() + 1, dumbbell_shapes.end());
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			glm::vec3 axis = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+			bd.orientation = glm::angleAxis(random(-2.0f, 2.0f), axis);
+			bd.pos = glm::vec3(random(-3.0f, 3.0f), random(-1.0f, 1.0f), random(3.0f, 8.0f));
+			world.createBody(bd);
+		}
+	}
+};
+
+class MeshTest : public Test
+{
+public:
+	MeshTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// the whole track is one static body
+		BodyDef terrain_bd;
+		terrain_bd.type = BodyType::STATIC;
+		terrain_bd.shape = shapes.road_mesh;
+		terrain_bd.friction = 0.6f;
+		world.createBody(terrain_bd);
+		world.buildBVH();
+
+		Shape* drop_shapes[] = { shapes.box2, shapes.sphere, shapes.long_cylinder, shapes.medium_capsule, shapes.d_8, shapes.d_20 };
+
+		TriangleMesh* mesh = (TriangleMesh*)shapes.road_mesh;
+
+		BodyDef bd;
+		bd.angular_damping = 0.99f;
+		for (unsigned int i = 0; i < 64; ++i)
+		{
+			glm::vec3 axis = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+			bd.orientation = glm::angleAxis(random(-2.0f, 2.0f), axis);
+			bd.shape = drop_shapes[i % 6];
+
+			// above a random point of the track
+			glm::vec3 vertex = mesh->vertices[(unsigned int)(random() * (mesh->vertices.size() - 1))];
+			bd.pos = vertex + glm::vec3(0.0f, 0.0f, random(2.0f, 6.0f));
+			world.createBody(bd);
+		}
+	}
+};
+
+class TerrainTest : public Test
+{
+public:
+	TerrainTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// the heightfield replaces the ground plane
+		world.ground_enabled = false;
+
+		BodyDef terrain_bd;
+		terrain_bd.type = BodyType::STATIC;
+		terrain_bd.shape = shapes.terrain;
+		terrain_bd.friction = 0.8f;
+		world.createBody(terrain_bd);
+		world.buildBVH();
+
+		Shape* drop_shapes[] = { shapes.box2, shapes.sphere, shapes.long_cylinder, shapes.medium_capsule, shapes.d_8, shapes.d_20 };
+
+		BodyDef bd;
+		bd.angular_damping = 0.99f;
+		for (unsigned int i = 0; i < 100; ++i)
+		{
+			glm::vec3 axis = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+			bd.orientation = glm::angleAxis(random(-2.0f, 2.0f), axis);
+			bd.shape = drop_shapes[i % 6];
+			bd.pos = glm::vec3(random(-28.0f, 28.0f), random(-28.0f, 28.0f), random(4.0f, 10.0f));
+			world.createBody(bd);
+		}
+	}
+};
+
+class PlaneTest : public Test
+{
+public:
+	PlaneTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// a pit with four walls and a ramp on one side, all using the same plane
+		BodyDef plane_bd;
+		plane_bd.type = BodyType::STATIC;
+		plane_bd.shape = shapes.half_space;
+		plane_bd.friction = 0.3f;
+
+		const float half_pi = glm::pi<float>() * 0.5f;
+		plane_bd.pos = glm::vec3(6.0f, 0.0f, 0.0f);
+		plane_bd.orientation = glm::angleAxis(-half_pi, glm::vec3(0.0f, 1.0f, 0.0f));
+		world.createBody(plane_bd);
+
+		plane_bd.pos = glm::vec3(-6.0f, 0.0f, 0.0f);
+		plane_bd.orientation = glm::angleAxis(half_pi, glm::vec3(0.0f, 1.0f, 0.0f));
+		world.createBody(plane_bd);
+
+		plane_bd.pos = glm::vec3(0.0f, 6.0f, 0.0f);
+		plane_bd.orientation = glm::angleAxis(half_pi, glm::vec3(1.0f, 0.0f, 0.0f));
+		world.createBody(plane_bd);
+
+		plane_bd.pos = glm::vec3(0.0f, -6.0f, 0.0f);
+		plane_bd.orientation = glm::angleAxis(-half_pi, glm::vec3(1.0f, 0.0f, 0.0f));
+		world.createBody(plane_bd);
+
+		plane_bd.pos = glm::vec3(2.0f, 0.0f, 0.0f);
+		plane_bd.orientation = glm::angleAxis(-0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+		world.createBody(plane_bd);
+
+		Shape* drop_shapes[] = { shapes.box2, shapes.sphere, shapes.long_cylinder, shapes.medium_capsule, shapes.d_8, shapes.d_20 };
+
+		BodyDef bd;
+		bd.angular_damping = 0.99f;
+		for (unsigned int i = 0; i < 80; ++i)
+		{
+			glm::vec3 axis = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+			bd.orientation = glm::angleAxis(random(-2.0f, 2.0f), axis);
+			bd.shape = drop_shapes[i % 6];
+			bd.pos = glm::vec3(random(-5.0f, 5.0f), random(-5.0f, 5.0f), random(4.0f, 12.0f));
+			world.createBody(bd);
+		}
+	}
+};
+
+class CCDTest : public Test
+{
+public:
+	CCDTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// one substep, fast bodies rely on continuous collision instead
+		world.iters = 1;
+
+		BodyDef wall_bd;
+		wall_bd.type = BodyType::STATIC;
+		wall_bd.shape = shapes.platform;
+		wall_bd.orientation = glm::angleAxis(glm::pi<float>() * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			wall_bd.pos = glm::vec3(10.0f, i * 4.0f - 6.0f, 1.0f);
+			world.createBody(wall_bd);
+		}
+		world.buildBVH();
+
+		// the left half of each wall is hit by bodies with ccd, the right half without
+		Shape* fast_shapes[] = { shapes.sphere, shapes.cube, shapes.small_capsule, shapes.d_8 };
+		BodyDef bd;
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			bd.shape = fast_shapes[i];
+			bd.vel = glm::vec3(60.0f + i * 10.0f, 0.0f, 0.0f);
+			bd.angular_vel = glm::vec3(0.0f, i * 5.0f, 0.0f);
+
+			bd.ccd = true;
+			bd.pos = glm::vec3(0.0f, i * 4.0f - 7.0f, 1.0f);
+			world.createBody(bd);
+
+			bd.ccd = false;
+			bd.pos = glm::vec3(0.0f, i * 4.0f - 5.0f, 1.0f);
+			world.createBody(bd);
+		}
+	}
+};
+
+class SpeculativeTest : public Test
+{
+public:
+	SpeculativeTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// fast bodies are stopped by speculative contacts with two substeps and no ccd
+		world.iters = 2;
+		world.speculative_contacts = true;
+
+		BodyDef wall_bd;
+		wall_bd.type = BodyType::STATIC;
+		wall_bd.shape = shapes.platform;
+		wall_bd.orientation = glm::angleAxis(glm::pi<float>() * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			wall_bd.pos = glm::vec3(10.0f, i * 4.0f - 6.0f, 1.0f);
+			world.createBody(wall_bd);
+		}
+		world.buildBVH();
+
+		Shape* fast_shapes[] = { shapes.sphere, shapes.cube, shapes.small_capsule, shapes.d_8 };
+		BodyDef bd;
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			bd.shape = fast_shapes[i];
+			bd.angular_vel = glm::vec3(0.0f, i * 5.0f, 0.0f);
+
+			// thrown at the walls
+			bd.vel = glm::vec3(60.0f + i * 10.0f, 0.0f, 0.0f);
+			bd.pos = glm::vec3(0.0f, i * 4.0f - 6.0f, 1.0f);
+			world.createBody(bd);
+
+			// thrown at the ground
+			bd.vel = glm::vec3(0.0f, 0.0f, -80.0f);
+			bd.pos = glm::vec3(-6.0f, i * 4.0f - 6.0f, 8.0f);
+			world.createBody(bd);
+
+			// thrown at a body resting on the ground
+			bd.vel = glm::vec3(0.0f);
+			bd.pos = glm::vec3(-12.0f, i * 4.0f - 6.0f, 1.0f);
+			world.createBody(bd);
+			bd.vel = glm::vec3(0.0f, 0.0f, -80.0f);
+			bd.pos = glm::vec3(-12.0f, i * 4.0f - 6.0f, 10.0f);
+			world.createBody(bd);
+		}
+	}
+};
+
+class SensorTest : public Test
+{
+public:
+	Body* trigger;
+	Body* plane_trigger;
+	BodyHandle sweeper;
+
+	unsigned int enter_count = 0;
+	unsigned int exit_count = 0;
+
+	float time = 0.0f;
+
+	SensorTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// a box sensor on the ground, a plane sensor beyond x = 6 and a sphere sensor moving over the floor
+		BodyDef sensor_bd;
+		sensor_bd.type = BodyType::STATIC;
+		sensor_bd.is_sensor = true;
+		sensor_bd.shape = shapes.trigger;
+		sensor_bd.pos = glm::vec3(0.0f, 0.0f, 1.0f);
+		trigger = world.createBody(sensor_bd);
+
+		sensor_bd.shape = shapes.half_space;
+		sensor_bd.pos = glm::vec3(6.0f, 0.0f, 0.0f);
+		sensor_bd.orientation = glm::angleAxis(-glm::pi<float>() * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+		plane_trigger = world.createBody(sensor_bd);
+		world.buildBVH();
+		trigger = &world.sensor_bodies[0]; // building the tree reorders the sensors
+
+		BodyDef sweeper_bd;
+		sweeper_bd.shape = shapes.bowling_ball;
+		sweeper_bd.is_sensor = true;
+		sweeper_bd.pos = glm::vec3(0.0f, -5.0f, 0.7f);
+		sweeper = world.createDynamicBody(sweeper_bd);
+
+		Shape* drop_shapes[] = { shapes.box2, shapes.sphere, shapes.long_cylinder, shapes.medium_capsule, shapes.d_8, shapes.d_20 };
+
+		BodyDef bd;
+		bd.angular_damping = 0.99f;
+		for (unsigned int i = 0; i < 40; ++i)
+		{
+			glm::vec3 axis = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+			bd.orientation = glm::angleAxis(random(-2.0f, 2.0f), axis);
+			bd.shape = drop_shapes[i % 6];
+			bd.pos = glm::vec3(random(-8.0f, 8.0f), random(-4.0f, 4.0f), random(4.0f, 12.0f));
+			world.createBody(bd);
+		}
+	}
+
+	void update(float dt)
+	{
+		// the sweeper is driven along y and held above the floor, it passes through everything
+		time += dt;
+		DynamicBody* body = world.getBody(sweeper);
+		body->is_awake = true;
+		body->vel = glm::vec3(0.0f, 5.0f * glm::cos(time), (0.7f - body->pos.z) / dt);
+
+		world.step(dt);
+
+		for (unsigned int i = 0; i < world.sensor_events.size(); ++i)
+		{
+			if (world.sensor_events[i].type == SENSOR_ENTER)
+				++enter_count;
+			else if (world.sensor_events[i].type == SENSOR_EXIT)
+				++exit_count;
+		}
+	}
+
+	void renderImGui()
+	{
+		unsigned int inside[3] = { 0, 0, 0 };
+		for (unsigned int i = 0; i < world.sensor_overlaps.size(); ++i)
+		{
+			Body* sensor = world.sensor_overlaps[i].sensor;
+			++inside[sensor == trigger ? 0 : sensor == plane_trigger ? 1 : 2];
+		}
+
+		ImGui::Text(("Inside box: " + std::to_string(inside[0])).c_str());
+		ImGui::Text(("Beyond plane: " + std::to_string(inside[1])).c_str());
+		ImGui::Text(("Touching sweeper: " + std::to_string(inside[2])).c_str());
+		ImGui::Text(("Enter events: " + std::to_string(enter_count)).c_str());
+		ImGui::Text(("Exit events: " + std::to_string(exit_count)).c_str());
+	}
+
+	void renderDebug(DebugRenderer* renderer)
+	{
+		renderer->renderAABB(trigger->aabb);
+
+		renderer->setSphereColor(glm::vec3(0.2f, 1.0f, 0.4f));
+		for (unsigned int i = 0; i < world.sensor_overlaps.size(); ++i)
+			renderer->renderSphere(world.sensor_overlaps[i].body->pos, 0.1f);
+	}
+};
+
+class FilterTest : public Test
+{
+public:
+	FilterTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// the links of the chain overlap at the joints, they only hang straight because jointed bodies don't collide
+		BodyDef link_bd;
+		float height = 0.8f;
+		float overlap = 0.2f;
+		link_bd.shape = shapes.box2;
+		link_bd.linear_damping = 0.999f;
+		link_bd.angular_damping = 0.999f;
+		DynamicBody* prev = nullptr;
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			link_bd.pos = glm::vec3(0.0f, 0.0f, 8.0f - i * (height - overlap));
+			DynamicBody* body = (DynamicBody*)world.createBody(link_bd);
+
+			if (prev == nullptr)
+			{
+				AnchoredBallJoint* joint = new AnchoredBallJoint();
+				joint->body = body;
+				joint->local = glm::vec3(0.0f, 0.0f, (height - overlap) * 0.5f);
+				joint->anchor = link_bd.pos + joint->local;
+				world.addJoint(joint);
+			}
+			else
+			{
+				BallJoint* joint = new BallJoint();
+				joint->a = prev;
+				joint->b = body;
+				joint->local_a = glm::vec3(0.0f, 0.0f, -(height - overlap) * 0.5f);
+				joint->local_b = glm::vec3(0.0f, 0.0f, (height - overlap) * 0.5f);
+				joint->collide_connected = false;
+				world.addJoint(joint);
+			}
+			prev = body;
+		}
+
+		// debris shares a negative group so it falls through itself, but lands on the ground and the chain
+		BodyDef debris_bd;
+		debris_bd.shape = shapes.d_4;
+		debris_bd.angular_damping = 0.99f;
+		debris_bd.filter.category = 0x0002;
+		debris_bd.filter.group = -1;
+		for (unsigned int i = 0; i < 60; ++i)
+		{
+			debris_bd.pos = glm::vec3(random(-1.5f, 1.5f), random(-1.5f, 1.5f), random(4.0f, 14.0f));
+			world.createBody(debris_bd);
+		}
+
+		// the balls are masked off from the debris category and roll through it
+		BodyDef ball_bd;
+		ball_bd.shape = shapes.sphere;
+		ball_bd.filter.category = 0x0004;
+		ball_bd.filter.mask = ~0x0002u;
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			ball_bd.pos = glm::vec3(-4.0f, i * 1.2f - 3.0f, 0.5f);
+			ball_bd.vel = glm::vec3(3.0f, 0.0f, 0.0f);
+			world.createBody(ball_bd);
+		}
+	}
+};
+
+class PileTest : public Test
+{
+	bool color_islands = true;
+
+public:
+	PileTest()
+	{
+		world = World();
+	}
+
+	void initialize()
+	{
+		// a brick pattern so the whole pile ends up as one island
+		BodyDef bd;
+		bd.shape = shapes.cube;
+		bd.friction = 0.5f;
+		unsigned int size = 12;
+		for (unsigned int z = 0; z < 8; ++z)
+		{
+			for (unsigned int y = 0; y < size; ++y)
+			{
+				for (unsigned int x = 0; x < size; ++x)
+				{
+					bd.pos = glm::vec3(x + (z % 2) * 0.5f - size * 0.5f, y - size * 0.5f, 0.5f + z);
+					world.createBody(bd);
+				}
+			}
+		}
+	}
+
+	void renderImGui()
+	{
+		unsigned int largest = 0;
+		for (unsigned int i = 0; i < world.islands.size(); ++i)
+			largest = glm::max(largest, world.islands[i].manifold_count);
+
+		ImGui::Text(("Islands: " + std::to_string(world.islands.size())).c_str());
+		ImGui::Text(("Largest island manifolds: " + std::to_string(largest)).c_str());
+		ImGui::Text(("Colors: " + std::to_string(world.contact_coloring.num_colors)).c_str());
+		ImGui::Text(("Overflow: " + std::to_string(world.contact_coloring.getOverflowSize())).c_str());
+
+		// compare the frame time with the island solved on one thread
+		if (ImGui::Checkbox("Color Large Islands", &color_islands))
+			world.graph_color_size = color_islands ? 256 : (unsigned int)-1;
+	}
 };
 
 class BVHTest : public Test
@@ -20,11 +20,14 @@ public:
 
 	DebugRenderer renderer;
 
+	fiz::ThreadPool thread_pool;
+	bool parallel_islands; // solve the islands of the current test on thread_pool
+
 	bool paused;
 	bool swapping_test;
 	bool updating_physics;
 
-	TestBed() : curr_test(nullptr), renderer(nullptr), paused(false), swapping_test(false), updating_physics(false)
+	TestBed() : curr_test(nullptr), renderer(nullptr), parallel_islands(true), paused(false), swapping_test(false), updating_physics(false)
 	{
 		camera = &renderer.camera;
 
@@ -110,9 +113,21 @@ public:
 		std::string joints_text = "Joints: " + std::to_string(world->joints.size());
 		ImGui::Text(joints_text.c_str());
 
+		unsigned int awake_islands = 0;
+		for (unsigned int i = 0; i < world->islands.size(); ++i)
+			awake_islands += world->islands[i].is_awake;
+		std::string islands_text = "Islands: " + std::to_string(awake_islands) + " awake / " + std::to_string(world->islands.size());
+		ImGui::Text(islands_text.c_str());
+
 		std::string bvh_nodes_text = "BVH Nodes: " + std::to_string(world->static_bvh.nodes.size());
 		ImGui::Text(bvh_nodes_text.c_str());
 
+		if (ImGui::Checkbox("Parallel Islands", &parallel_islands))
+			world->thread_pool = parallel_islands ? &thread_pool : nullptr;
+		ImGui::Checkbox("SIMD Contacts", &world->wide_contacts);
+		ImGui::Checkbox("TGS Substepping", &world->tgs_substepping);
+		ImGui::Checkbox("Block Contacts", &world->block_contacts);
+
 		ImGui::DragFloat3("Gravity", &world->gravity.x, 0.01f);
 
 		ImGui::Checkbox("Show Velocities", &renderer.show_velocities);
@@ -182,7 +197,7 @@ public:
 
 	void renderTestImGui()
 	{
-		const char* tests[] = { "Box Test", "Domino Test", "Stack Test", "Bowling Test", "GJK Test", "BVH Test", "Car Test", "Raycast Test" };
+		const char* tests[] = { "Box Test", "Domino Test", "Stack Test", "Bowling Test", "GJK Test", "BVH Test", "Car Test", "Raycast Test", "Compound Test", "Mesh Test", "Terrain Test", "Plane Test", "CCD Test", "Speculative Test", "Sensor Test", "Filter Test", "Pile Test" };
 		static int selected_test = 0;
 
 		if (ImGui::BeginCombo("Tests", tests[selected_test]))
@@ -227,6 +242,51 @@ public:
 				selected_test = 7;
 				setTest(new RaycastTest());
 			}
+			if (ImGui::Selectable(tests[8]))
+			{
+				selected_test = 8;
+				setTest(new CompoundTest());
+			}
+			if (ImGui::Selectable(tests[9]))
+			{
+				selected_test = 9;
+				setTest(new MeshTest());
+			}
+			if (ImGui::Selectable(tests[10]))
+			{
+				selected_test = 10;
+				setTest(new TerrainTest());
+			}
+			if (ImGui::Selectable(tests[11]))
+			{
+				selected_test = 11;
+				setTest(new PlaneTest());
+			}
+			if (ImGui::Selectable(tests[12]))
+			{
+				selected_test = 12;
+				setTest(new CCDTest());
+			}
+			if (ImGui::Selectable(tests[13]))
+			{
+				selected_test = 13;
+				setTest(new SpeculativeTest());
+			}
+			if (ImGui::Selectable(tests[14]))
+			{
+				selected_test = 14;
+				setTest(new SensorTest());
+			}
+			if (ImGui::Selectable(tests[15]))
+			{
+				selected_test = 15;
+				setTest(new FilterTest());
+			}
+			if (ImGui::Selectable(tests[16]))
+			{
+				selected_test = 16;
+				setTest(new PileTest());
+			}
 
 			ImGui::EndCombo();
 		}
@@ -271,6 +331,7 @@ public:
 		curr_test = test;
 		curr_test->setRenderer(&renderer);
 		test->initialize();
+		curr_test->world.thread_pool = parallel_islands ? &thread_pool : nullptr;
 		renderer.world = &curr_test->world;
 		renderer.randomizeColors();
 		swapping_test = false;
@@ -0,0 +1,85 @@
+// Standalone checks for body handles, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/BodyHandleTests.cpp -o body_handle_tests
+#include <cstdio>
+
+#include "../physics/World.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+BodyHandle createSphere(World& world, Shape* shape, glm::vec3 pos)
+{
+	BodyDef bd;
+	bd.shape = shape;
+	bd.pos = pos;
+	return world.createDynamicBody(bd);
+}
+
+// a destroyed body can't be reached through its handle, even after its slot is reused
+void testStaleHandle()
+{
+	World world;
+	Sphere sphere(glm::vec3(0.0f), 0.5f);
+
+	BodyHandle a = createSphere(world, &sphere, glm::vec3(0.0f, 0.0f, 1.0f));
+	BodyHandle b = createSphere(world, &sphere, glm::vec3(0.0f, 0.0f, 2.0f));
+	CHECK(world.getBody(a) != nullptr);
+
+	world.destroyBody(a);
+	CHECK(world.getBody(a) == nullptr);
+	CHECK(world.dynamic_bodies.size() == 1);
+
+	// the last body took the place of the destroyed one
+	CHECK(world.getBody(b) != nullptr && world.getBody(b)->pos.z == 2.0f);
+
+	BodyHandle c = createSphere(world, &sphere, glm::vec3(0.0f, 0.0f, 3.0f));
+	CHECK(c.slot == a.slot);
+	CHECK(c.generation != a.generation);
+	CHECK(world.getBody(a) == nullptr);
+	CHECK(world.getBody(c) != nullptr && world.getBody(c)->pos.z == 3.0f);
+
+	// destroying a stale handle again leaves the new body alone
+	world.destroyBody(a);
+	CHECK(world.getBody(c) != nullptr);
+	CHECK(world.dynamic_bodies.size() == 2);
+
+	// a handle from another world's slots is out of range
+	BodyHandle unknown = { 100, 0 };
+	CHECK(world.getBody(unknown) == nullptr);
+}
+
+// handles still find their bodies after the storage has been reallocated and bodies have moved
+void testHandlesSurviveGrowth()
+{
+	World world;
+	Sphere sphere(glm::vec3(0.0f), 0.5f);
+
+	std::vector<BodyHandle> handles;
+	for (unsigned int i = 0; i < 100; ++i)
+		handles.push_back(createSphere(world, &sphere, glm::vec3(2.0f * i, 0.0f, 1.0f)));
+
+	for (unsigned int i = 0; i < 100; i += 3)
+		world.destroyBody(handles[i]);
+
+	for (unsigned int i = 0; i < 100; ++i)
+	{
+		DynamicBody* body = world.getBody(handles[i]);
+		bool destroyed = i % 3 == 0;
+		CHECK((body == nullptr) == destroyed);
+		CHECK(destroyed || (body->pos.x == 2.0f * i && world.getHandle(body).slot == handles[i].slot));
+	}
+}
+
+int main()
+{
+	testStaleHandle();
+	testHandlesSurviveGrowth();
+
+	if (failures == 0)
+		std::printf("all body handle tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
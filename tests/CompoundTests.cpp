@@ -0,0 +1,113 @@
+// Standalone checks for compound bodies, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/CompoundTests.cpp -o compound_tests
+#include <cstdio>
+
+#include "../physics/World.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// center of mass of the shapes of a body in world coordinates
+glm::vec3 getCenterOfMass(DynamicBody* body)
+{
+	glm::vec3 center = glm::vec3(0.0f);
+	float mass = 0.0f;
+	for (unsigned int i = 0; i < body->shapes.size(); ++i)
+	{
+		float shape_mass = body->shapes[i]->volume * body->density;
+		center += shape_mass * body->getWorldPos(body->shapes[i]->centroid);
+		mass += shape_mass;
+	}
+	return center / mass;
+}
+
+// a table has its center of mass well above the origin of its shapes
+void testSpinningCompoundKeepsCenterOfMass()
+{
+	World world;
+	world.gravity = glm::vec3(0.0f);
+	world.ground_enabled = false;
+
+	BodyDef bd;
+	bd.shape = new Box(glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.8f, 0.5f, 0.05f));
+	bd.child_shapes.push_back(new Box(glm::vec3(-0.7f, -0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+	bd.child_shapes.push_back(new Box(glm::vec3(0.7f, -0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+	bd.child_shapes.push_back(new Box(glm::vec3(-0.7f, 0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+	bd.child_shapes.push_back(new Box(glm::vec3(0.7f, 0.4f, 0.0f), glm::vec3(0.05f, 0.05f, 0.45f)));
+	bd.pos = glm::vec3(0.0f, 0.0f, 5.0f);
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	bd.angular_vel = glm::vec3(1.0f, 2.0f, 3.0f);
+	DynamicBody* body = (DynamicBody*)world.createBody(bd);
+	BodyHandle handle = world.getHandle(body);
+
+	// the body origin is the center of mass
+	CHECK(glm::length(getCenterOfMass(body) - body->pos) < 0.0001f);
+
+	glm::vec3 start = getCenterOfMass(body);
+	float drift = 0.0f;
+	for (unsigned int i = 0; i < 600; ++i)
+	{
+		world.step(1.0f / 60.0f);
+		body = world.getBody(handle);
+		drift = glm::max(drift, glm::length(getCenterOfMass(body) - start));
+	}
+	CHECK(drift < 0.001f);
+	CHECK(glm::length(body->angular_vel) > 1.0f);
+}
+
+// bodies work on their own copies of shapes, so sharing a shape doesn't move it for the other bodies
+void testSharedShapeIsNotMoved()
+{
+	World world;
+	world.gravity = glm::vec3(0.0f);
+	world.ground_enabled = false;
+
+	Sphere* sphere = new Sphere(glm::vec3(1.0f, 0.0f, 0.0f), 0.5f);
+
+	BodyDef bd;
+	bd.shape = new Box(glm::vec3(0.0f), glm::vec3(0.5f));
+	bd.child_shapes.push_back(sphere);
+	bd.pos = glm::vec3(0.0f, 0.0f, 5.0f);
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	BodyHandle compound = world.getHandle((DynamicBody*)world.createBody(bd));
+	glm::vec3 compound_offset = getCenterOfMass(world.getBody(compound)) - world.getBody(compound)->pos;
+
+	BodyDef single_bd;
+	single_bd.shape = sphere;
+	single_bd.pos = glm::vec3(0.0f, 4.0f, 5.0f);
+	single_bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	DynamicBody* single = (DynamicBody*)world.createBody(single_bd);
+
+	BodyDef static_bd;
+	static_bd.type = BodyType::STATIC;
+	static_bd.shape = sphere;
+	static_bd.pos = glm::vec3(0.0f, -4.0f, 5.0f);
+	static_bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	Body* fixed = world.createBody(static_bd);
+
+	// the shape is unchanged and every body keeps it where it was placed
+	CHECK(sphere->pos == glm::vec3(1.0f, 0.0f, 0.0f));
+	CHECK(glm::length(single->getWorldPos(single->shapes[0]->centroid) - glm::vec3(1.0f, 4.0f, 5.0f)) < 0.0001f);
+	CHECK(glm::length(single->pos - glm::vec3(1.0f, 4.0f, 5.0f)) < 0.0001f);
+	CHECK(glm::length((fixed->aabb.min + fixed->aabb.max) * 0.5f - glm::vec3(1.0f, -4.0f, 5.0f)) < 0.0001f);
+
+	// building the other bodies didn't change the first one
+	DynamicBody* body = world.getBody(compound);
+	CHECK(glm::length(compound_offset) < 0.0001f);
+	CHECK(glm::length(getCenterOfMass(body) - body->pos) < 0.0001f);
+	CHECK(glm::length(body->getWorldPos(body->shapes[1]->centroid) - glm::vec3(1.0f, 0.0f, 5.0f)) < 0.0001f);
+}
+
+int main()
+{
+	testSpinningCompoundKeepsCenterOfMass();
+	testSharedShapeIsNotMoved();
+
+	if (failures == 0)
+		std::printf("all compound tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Standalone checks for convex decomposition and its cache, run from the repo root with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/ConvexDecompositionTests.cpp -o decomposition_tests -lpthread
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "../physics/geometry/ConvexDecomposition.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+static const char* cache_path = "decomposition_tests.hulls";
+
+// a closed cube with outward triangles
+void addCube(glm::vec3 min, glm::vec3 max, std::vector<glm::vec3>& vertices, std::vector<glm::uvec3>& triangles)
+{
+	unsigned int first = vertices.size();
+	for (unsigned int i = 0; i < 8; ++i)
+		vertices.push_back(glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z));
+
+	unsigned int faces[12][3] = {
+		{ 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 },
+		{ 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+		{ 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 }
+	};
+	for (unsigned int i = 0; i < 12; ++i)
+		triangles.push_back(glm::uvec3(first + faces[i][0], first + faces[i][1], first + faces[i][2]));
+}
+
+// two separate cubes are split into a hull each, the same way with any number of threads
+void testTwoCubes()
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::uvec3> triangles;
+	addCube(glm::vec3(0.0f), glm::vec3(1.0f), vertices, triangles);
+	addCube(glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(4.0f, 1.0f, 1.0f), vertices, triangles);
+
+	ConvexDecomposition serial;
+	ThreadPool one_thread(1);
+	serial.decompose(vertices, triangles, DecompositionSettings(), &one_thread);
+	CHECK(serial.hull_vertices.size() == 2);
+
+	ConvexDecomposition parallel;
+	ThreadPool four_threads(4);
+	parallel.decompose(vertices, triangles, DecompositionSettings(), &four_threads);
+	CHECK(parallel.hull_vertices == serial.hull_vertices);
+	CHECK(parallel.hull_indices == serial.hull_indices);
+
+	// without a pool the decomposition makes its own
+	ConvexDecomposition own_pool;
+	own_pool.decompose(vertices, triangles);
+	CHECK(own_pool.hull_vertices == serial.hull_vertices);
+}
+
+// the cache reads back what was written and rejects other keys and cut off files
+void testCache()
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::uvec3> triangles;
+	addCube(glm::vec3(0.0f), glm::vec3(1.0f), vertices, triangles);
+	addCube(glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(4.0f, 1.0f, 1.0f), vertices, triangles);
+
+	DecompositionSettings settings;
+	uint64_t key = ConvexDecomposition::hashSettings(settings, ConvexDecomposition::hash(vertices.data(), sizeof(glm::vec3) * vertices.size()));
+
+	ConvexDecomposition decomposition;
+	decomposition.decompose(vertices, triangles, settings);
+	CHECK(decomposition.save(cache_path, key));
+
+	ConvexDecomposition loaded;
+	CHECK(loaded.load(cache_path, key));
+	CHECK(loaded.hull_vertices == decomposition.hull_vertices);
+	CHECK(loaded.hull_indices == decomposition.hull_indices);
+
+	CHECK(!loaded.load(cache_path, key + 1));
+	CHECK(loaded.hull_vertices.empty());
+
+	settings.concavity *= 2.0f;
+	CHECK(ConvexDecomposition::hashSettings(settings, 0) != ConvexDecomposition::hashSettings(DecompositionSettings(), 0));
+
+	// every cut through the hulls fails instead of reading past the end
+	std::ifstream in(cache_path, std::ios::binary);
+	std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+	unsigned int accepted = 0;
+	for (unsigned int size = 0; size < bytes.size(); size += 7)
+	{
+		std::ofstream out(cache_path, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), size);
+		out.close();
+		accepted += loaded.load(cache_path, key);
+	}
+	CHECK(accepted == 0);
+
+	// a hull count larger than the file
+	std::string corrupt = bytes;
+	uint32_t hull_count = 0x7FFFFFFF;
+	corrupt.replace(2 * sizeof(uint32_t), sizeof(hull_count), (const char*)&hull_count, sizeof(hull_count));
+	std::ofstream out(cache_path, std::ios::binary | std::ios::trunc);
+	out.write(corrupt.data(), corrupt.size());
+	out.close();
+	CHECK(!loaded.load(cache_path, key));
+
+	std::remove(cache_path);
+}
+
+int main()
+{
+	testTwoCubes();
+	testCache();
+
+	if (failures == 0)
+		std::printf("all convex decomposition tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Standalone checks for convex hulls, run from the repo root with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/ConvexHullTests.cpp -o hull_tests
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "../physics/geometry/ConvexHull.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// vertex positions of an obj file
+std::vector<glm::vec3> loadPoints(const char* filename, float scale)
+{
+	std::vector<glm::vec3> points;
+	std::ifstream file(filename);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.size() < 2 || line[0] != 'v' || line[1] != ' ')
+			continue;
+		std::istringstream stream(line.substr(2));
+		glm::vec3 point;
+		stream >> point.x >> point.y >> point.z;
+		points.push_back(point * scale);
+	}
+	return points;
+}
+
+// every edge has exactly one twin, every face points away from the center and no point is in front of a face
+void checkHull(const char* name, const std::vector<glm::vec3>& points, unsigned int vertex_count, unsigned int triangle_count)
+{
+	ConvexHull hull;
+	bool built = hull.build(points);
+	CHECK(built);
+	if (!built)
+		return;
+
+	if (hull.vertices.size() != vertex_count || hull.indices.size() != triangle_count)
+	{
+		std::printf("%s: %zu vertices and %zu triangles\n", name, hull.vertices.size(), hull.indices.size());
+		++failures;
+	}
+
+	std::unordered_map<uint64_t, unsigned int> edges;
+	for (unsigned int i = 0; i < hull.indices.size(); ++i)
+	{
+		for (unsigned int j = 0; j < 3; ++j)
+			edges[((uint64_t)hull.indices[i][j] << 32) | hull.indices[i][(j + 1) % 3]]++;
+	}
+	unsigned int duplicate = 0;
+	unsigned int unmatched = 0;
+	for (auto it = edges.begin(); it != edges.end(); ++it)
+	{
+		duplicate += it->second > 1;
+		unmatched += edges.find((it->first << 32) | (it->first >> 32)) == edges.end();
+	}
+
+	glm::vec3 center = glm::vec3(0.0f);
+	glm::vec3 size = glm::vec3(0.0f);
+	for (unsigned int i = 0; i < hull.vertices.size(); ++i)
+	{
+		center += hull.vertices[i];
+		size = glm::max(size, glm::abs(hull.vertices[i]));
+	}
+	center /= (float)hull.vertices.size();
+	float tolerance = 1e-4f * (size.x + size.y + size.z);
+
+	unsigned int inward = 0;
+	unsigned int outside = 0;
+	for (unsigned int i = 0; i < hull.indices.size(); ++i)
+	{
+		glm::vec3 a = hull.vertices[hull.indices[i].x];
+		glm::vec3 normal = glm::normalize(glm::cross(hull.vertices[hull.indices[i].y] - a, hull.vertices[hull.indices[i].z] - a));
+		inward += glm::dot(normal, center - a) >= 0.0f;
+		for (unsigned int j = 0; j < points.size(); ++j)
+			outside += glm::dot(normal, points[j] - a) > tolerance;
+	}
+
+	if (duplicate != 0 || unmatched != 0 || inward != 0 || outside != 0)
+	{
+		std::printf("%s: %u duplicate edges, %u unmatched edges, %u inward faces, %u points outside\n", name, duplicate, unmatched, inward, outside);
+		++failures;
+	}
+}
+
+// the dice are nearly coplanar after rounding in the files
+void testDice()
+{
+	checkHull("d_4", loadPoints("objects/d_4.obj", 15.0f), 4, 4);
+	checkHull("d_6", loadPoints("objects/d_6.obj", 15.0f), 8, 12);
+	checkHull("d_6 small", loadPoints("objects/d_6.obj", 1.0f), 8, 12);
+	checkHull("d_8", loadPoints("objects/d_8.obj", 15.0f), 6, 8);
+	checkHull("d_10", loadPoints("objects/d_10.obj", 15.0f), 12, 20);
+	checkHull("d_10 small", loadPoints("objects/d_10.obj", 1.0f), 12, 20);
+	checkHull("d_12", loadPoints("objects/d_12.obj", 15.0f), 20, 36);
+	checkHull("d_20", loadPoints("objects/d_20.obj", 15.0f), 12, 20);
+}
+
+// quad sides are merged from triangles of the build
+void testTriangularPrism()
+{
+	std::vector<glm::vec3> points = {
+		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 1.0f)
+	};
+	checkHull("prism", points, 6, 8);
+}
+
+// points on the faces, edges and inside of a cube leave only its corners
+void testCubeGrid()
+{
+	std::vector<glm::vec3> points;
+	for (unsigned int x = 0; x < 3; ++x)
+	{
+		for (unsigned int y = 0; y < 3; ++y)
+		{
+			for (unsigned int z = 0; z < 3; ++z)
+				points.push_back(glm::vec3(x, y, z) * 0.5f);
+		}
+	}
+	checkHull("grid", points, 8, 12);
+}
+
+int main()
+{
+	testDice();
+	testTriangularPrism();
+	testCubeGrid();
+
+	if (failures == 0)
+		std::printf("all convex hull tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// Standalone checks for collision filtering, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/FilterTests.cpp -o filter_tests
+#include <cstdio>
+
+#include "../physics/World.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// the number of manifolds between two bodies
+unsigned int countManifolds(World& world, Body* a, Body* b)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < world.contact_manifolds.size(); ++i)
+	{
+		ContactManifold& manifold = world.contact_manifolds[i];
+		if ((manifold.body_a == a && manifold.body_b == b) || (manifold.body_a == b && manifold.body_b == a))
+			++count;
+	}
+	return count;
+}
+
+// a row of overlapping spheres, more than four so the pair test covers several batches
+std::vector<BodyHandle> createRow(World& world, Shape* shape, const CollisionFilter* filters, unsigned int count)
+{
+	std::vector<BodyHandle> handles;
+	BodyDef bd;
+	bd.shape = shape;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		bd.pos = glm::vec3(0.8f * i, 0.0f, 5.0f);
+		bd.filter = filters[i];
+		handles.push_back(world.createDynamicBody(bd));
+	}
+	return handles;
+}
+
+// neighbours touch unless their filters reject each other
+void testDynamicPairs()
+{
+	World world;
+	world.gravity = glm::vec3(0.0f);
+	world.ground_enabled = false;
+	Sphere sphere(glm::vec3(0.0f), 0.5f);
+
+	CollisionFilter filters[7];
+	filters[1].category = 0x0002; // 0 doesn't accept it
+	filters[0].mask = ~0x0002u;
+	filters[2].group = -1; // 2 and 3 share a negative group
+	filters[3].group = -1;
+	filters[4].group = 1; // 4 and 5 share a positive group that overrides the masks
+	filters[4].mask = 0;
+	filters[5].group = 1;
+	filters[5].mask = 0;
+	std::vector<BodyHandle> handles = createRow(world, &sphere, filters, 7);
+
+	world.step(1.0f / 60.0f);
+
+	bool expected[6] = { false, true, false, false, true, false };
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		unsigned int count = countManifolds(world, world.getBody(handles[i]), world.getBody(handles[i + 1]));
+		if ((count != 0) != expected[i])
+		{
+			std::printf("bodies %u and %u: %u manifolds\n", i, i + 1, count);
+			++failures;
+		}
+	}
+}
+
+// a filtered body passes through a static box, including its tree
+void testStaticPairs()
+{
+	World world;
+	world.gravity = glm::vec3(0.0f);
+	world.ground_enabled = false;
+	Sphere sphere(glm::vec3(0.0f), 0.5f);
+	Box box(glm::vec3(0.0f), glm::vec3(2.0f, 2.0f, 0.5f));
+
+	BodyDef static_bd;
+	static_bd.type = BodyType::STATIC;
+	static_bd.shape = &box;
+	static_bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	static_bd.filter.category = 0x0004;
+	world.createBody(static_bd);
+	world.buildBVH();
+
+	BodyDef bd;
+	bd.shape = &sphere;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	bd.pos = glm::vec3(-1.0f, 0.0f, 0.8f);
+	BodyHandle touching = world.createDynamicBody(bd);
+	bd.pos = glm::vec3(1.0f, 0.0f, 0.8f);
+	bd.filter.mask = ~0x0004u;
+	BodyHandle filtered = world.createDynamicBody(bd);
+
+	world.step(1.0f / 60.0f);
+
+	Body* ground = &world.static_bodies[0];
+	CHECK(countManifolds(world, ground, world.getBody(touching)) == 1);
+	CHECK(countManifolds(world, ground, world.getBody(filtered)) == 0);
+}
+
+int main()
+{
+	testDynamicPairs();
+	testStaticPairs();
+
+	if (failures == 0)
+		std::printf("all filter tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
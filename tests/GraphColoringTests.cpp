@@ -0,0 +1,141 @@
+// Standalone checks for graph coloring, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/GraphColoringTests.cpp -o graph_coloring_tests -lpthread
+#include <cstdio>
+
+#include "../physics/World.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+struct Pair
+{
+	unsigned int a;
+	unsigned int b;
+};
+
+// no two constraints of a color share a dynamic body and every constraint is in exactly one set
+void checkColoring(GraphColoring& coloring, const std::vector<Pair>& pairs, unsigned int num_bodies)
+{
+	std::vector<unsigned int> seen(pairs.size(), 0);
+	for (unsigned int c = 0; c < coloring.num_colors; ++c)
+	{
+		std::vector<bool> used(num_bodies, false);
+		for (unsigned int i = coloring.getColorStart(c); i < coloring.getColorStart(c) + coloring.getColorSize(c); ++i)
+		{
+			const Pair& pair = pairs[coloring.constraints[i]];
+			seen[coloring.constraints[i]]++;
+			if (pair.a != GraphColoring::no_body)
+			{
+				CHECK(!used[pair.a]);
+				used[pair.a] = true;
+			}
+			if (pair.b != GraphColoring::no_body)
+			{
+				CHECK(!used[pair.b]);
+				used[pair.b] = true;
+			}
+		}
+	}
+	for (unsigned int i = coloring.getOverflowStart(); i < coloring.getOverflowStart() + coloring.getOverflowSize(); ++i)
+		seen[coloring.constraints[i]]++;
+
+	for (unsigned int i = 0; i < pairs.size(); ++i)
+		CHECK(seen[i] == 1);
+}
+
+// a chain needs two colors, and constraints keep the order they were added in within a color
+void testChain()
+{
+	std::vector<Pair> pairs;
+	for (unsigned int i = 0; i < 10; ++i)
+		pairs.push_back({ i, i + 1 });
+
+	GraphColoring coloring;
+	coloring.reset(11);
+	for (unsigned int i = 0; i < pairs.size(); ++i)
+		coloring.add(i, pairs[i].a, pairs[i].b);
+	coloring.finish();
+
+	CHECK(coloring.num_colors == 2);
+	CHECK(coloring.getOverflowSize() == 0);
+	checkColoring(coloring, pairs, 11);
+	for (unsigned int c = 0; c < coloring.num_colors; ++c)
+	{
+		for (unsigned int i = coloring.getColorStart(c) + 1; i < coloring.getColorStart(c) + coloring.getColorSize(c); ++i)
+			CHECK(coloring.constraints[i - 1] < coloring.constraints[i]);
+	}
+}
+
+// a body in more constraints than there are colors sends the rest to the overflow set,
+// constraints against the ground only conflict through their dynamic body
+void testOverflow()
+{
+	std::vector<Pair> pairs;
+	for (unsigned int i = 0; i < GraphColoring::max_colors + 8; ++i)
+		pairs.push_back({ 0, i + 1 });
+	for (unsigned int i = 0; i < 4; ++i)
+		pairs.push_back({ GraphColoring::no_body, i + 1 });
+	unsigned int num_bodies = GraphColoring::max_colors + 9;
+
+	GraphColoring coloring;
+	coloring.reset(num_bodies);
+	for (unsigned int i = 0; i < pairs.size(); ++i)
+		coloring.add(i, pairs[i].a, pairs[i].b);
+	coloring.addOverflow(pairs.size());
+	pairs.push_back({ GraphColoring::no_body, GraphColoring::no_body });
+	coloring.finish();
+
+	CHECK(coloring.num_colors == GraphColoring::max_colors);
+	CHECK(coloring.getOverflowSize() == 9);
+	CHECK(coloring.constraints.back() == pairs.size() - 1);
+	checkColoring(coloring, pairs, num_bodies);
+}
+
+// a pyramid big enough to be solved color by color settles like the island solver
+void testColoredIslandSettles()
+{
+	World world;
+	world.wide_contacts = false;
+	world.graph_color_size = 16;
+	Box box(glm::vec3(0.0f), glm::vec3(0.5f));
+
+	BodyDef bd;
+	bd.shape = &box;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	bd.friction = 0.6f;
+	bd.restitution = 0.0f;
+	std::vector<BodyHandle> handles;
+	for (unsigned int row = 0; row < 6; ++row)
+	{
+		for (unsigned int i = 0; i < 6 - row; ++i)
+		{
+			bd.pos = glm::vec3(1.02f * i + 0.51f * row, 0.0f, 0.5f + row);
+			handles.push_back(world.createDynamicBody(bd));
+		}
+	}
+
+	ThreadPool pool(4);
+	world.thread_pool = &pool;
+	for (unsigned int i = 0; i < 240; ++i)
+		world.step(1.0f / 60.0f);
+
+	// the top box stays on the pyramid
+	DynamicBody* top = world.getBody(handles.back());
+	CHECK(glm::abs(top->pos.z - 5.5f) < 0.1f);
+	CHECK(glm::abs(top->pos.x - 2.55f) < 0.1f);
+}
+
+int main()
+{
+	testChain();
+	testOverflow();
+	testColoredIslandSettles();
+
+	if (failures == 0)
+		std::printf("all graph coloring tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
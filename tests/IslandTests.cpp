@@ -0,0 +1,103 @@
+// Standalone checks for islands and sleeping, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/IslandTests.cpp -o island_tests -lpthread
+#include <cstdio>
+
+#include "../physics/World.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// index of the island holding the body
+unsigned int findIsland(World& world, DynamicBody* body)
+{
+	unsigned int index = (unsigned int)(body - world.dynamic_bodies.data());
+	for (unsigned int i = 0; i < world.islands.size(); ++i)
+	{
+		Island& island = world.islands[i];
+		for (unsigned int j = island.start; j < island.start + island.count; ++j)
+		{
+			if (world.island_bodies[j] == index)
+				return i;
+		}
+	}
+	return (unsigned int)-1;
+}
+
+// two boxes stacked on the ground
+void createStack(World& world, Shape* shape, float x, BodyHandle* handles)
+{
+	BodyDef bd;
+	bd.shape = shape;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	bd.friction = 0.5f;
+	bd.restitution = 0.0f;
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		bd.pos = glm::vec3(x, 0.0f, 0.5f + i);
+		handles[i] = world.createDynamicBody(bd);
+	}
+}
+
+// separate stacks are separate islands, they fall asleep and only the touched one wakes up
+void testStacksSleepApart(bool wide_contacts, ThreadPool* pool)
+{
+	World world;
+	world.wide_contacts = wide_contacts;
+	world.thread_pool = pool;
+	Box box(glm::vec3(0.0f), glm::vec3(0.5f));
+
+	BodyHandle a[2];
+	BodyHandle b[2];
+	createStack(world, &box, 0.0f, a);
+	createStack(world, &box, 10.0f, b);
+
+	world.step(1.0f / 60.0f);
+	CHECK(world.islands.size() == 2);
+	CHECK(findIsland(world, world.getBody(a[0])) == findIsland(world, world.getBody(a[1])));
+	CHECK(findIsland(world, world.getBody(b[0])) == findIsland(world, world.getBody(b[1])));
+	CHECK(findIsland(world, world.getBody(a[0])) != findIsland(world, world.getBody(b[0])));
+
+	unsigned int steps = 0;
+	while (steps < 600 && world.islands.size() == 2 && (world.islands[0].is_awake || world.islands[1].is_awake))
+	{
+		world.step(1.0f / 60.0f);
+		++steps;
+	}
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		CHECK(!world.getBody(a[i])->is_awake);
+		CHECK(!world.getBody(b[i])->is_awake);
+		CHECK(glm::abs(world.getBody(a[i])->pos.z - (0.5f + i)) < 0.05f);
+	}
+
+	// a sleeping stack stays where it is
+	glm::vec3 rest = world.getBody(a[1])->pos;
+	for (unsigned int i = 0; i < 60; ++i)
+		world.step(1.0f / 60.0f);
+	CHECK(world.getBody(a[1])->pos == rest);
+
+	// waking the top box wakes the box under it, but not the other stack
+	world.getBody(a[1])->setAwake();
+	world.getBody(a[1])->vel = glm::vec3(0.5f, 0.0f, 0.0f);
+	world.step(1.0f / 60.0f);
+	CHECK(world.getBody(a[0])->is_awake);
+	CHECK(world.getBody(a[1])->is_awake);
+	CHECK(!world.getBody(b[0])->is_awake);
+	CHECK(!world.getBody(b[1])->is_awake);
+}
+
+int main()
+{
+	ThreadPool pool(4);
+	testStacksSleepApart(true, nullptr);
+	testStacksSleepApart(false, nullptr);
+	testStacksSleepApart(false, &pool);
+
+	if (failures == 0)
+		std::printf("all island tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// Standalone checks for ray casts against triangles, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/RayTests.cpp -o ray_tests
+#include <cstdio>
+
+#include "../physics/geometry/TriangleMesh.h"
+#include "../physics/geometry/Heightfield.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// hits, misses and rays along the plane, from either side of the triangle
+void testRayTriangle()
+{
+	glm::vec3 a(0.0f, 0.0f, 0.0f);
+	glm::vec3 b(1.0f, 0.0f, 0.0f);
+	glm::vec3 c(0.0f, 1.0f, 0.0f);
+
+	CHECK(glm::abs(rayTriangle({ glm::vec3(0.25f, 0.25f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f) }, a, b, c) - 2.0f) < 0.0001f);
+	CHECK(glm::abs(rayTriangle({ glm::vec3(0.25f, 0.25f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f) }, a, b, c) - 2.0f) < 0.0001f);
+
+	// behind the start
+	CHECK(glm::abs(rayTriangle({ glm::vec3(0.25f, 0.25f, -2.0f), glm::vec3(0.0f, 0.0f, -1.0f) }, a, b, c) + 2.0f) < 0.0001f);
+
+	// outside the edges
+	CHECK(rayTriangle({ glm::vec3(0.75f, 0.75f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f) }, a, b, c) < -9999.0f);
+	CHECK(rayTriangle({ glm::vec3(-0.1f, 0.25f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f) }, a, b, c) < -9999.0f);
+
+	// a ray at a shallow angle to the plane is treated the same from both sides
+	float tilt = 0.0000005f;
+	CHECK(glm::abs(rayTriangle({ glm::vec3(-1.0f, 0.25f, -1.25f * tilt), glm::vec3(1.0f, 0.0f, tilt) }, a, b, c) - 1.25f) < 0.01f);
+	CHECK(glm::abs(rayTriangle({ glm::vec3(-1.0f, 0.25f, 1.25f * tilt), glm::vec3(1.0f, 0.0f, -tilt) }, a, b, c) - 1.25f) < 0.01f);
+
+	// and one along the plane misses
+	CHECK(rayTriangle({ glm::vec3(-1.0f, 0.25f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) }, a, b, c) < -9999.0f);
+}
+
+// a flat mesh, heightfield and box all report the same distance to their top
+void testShapesAgree()
+{
+	std::vector<glm::vec3> vertices = { glm::vec3(-2.0f, -2.0f, 1.0f), glm::vec3(2.0f, -2.0f, 1.0f), glm::vec3(2.0f, 2.0f, 1.0f), glm::vec3(-2.0f, 2.0f, 1.0f) };
+	std::vector<glm::uvec3> indices = { glm::uvec3(0, 1, 2), glm::uvec3(0, 2, 3) };
+	TriangleMesh mesh(vertices, indices);
+
+	Heightfield heightfield(4, 4, 1.0f, std::vector<float>(25, 1.0f));
+
+	Polyhedron box(8);
+	for (unsigned int i = 0; i < 8; ++i)
+		box.addVertex(glm::vec3(i & 1 ? 2.0f : -2.0f, i & 2 ? 2.0f : -2.0f, i & 4 ? 1.0f : -1.0f));
+	unsigned int faces[12][3] = {
+		{ 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 },
+		{ 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+		{ 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 }
+	};
+	for (unsigned int i = 0; i < 12; ++i)
+		box.addIndex(glm::uvec3(faces[i][0], faces[i][1], faces[i][2]));
+
+	Ray ray = { glm::vec3(0.3f, -0.7f, 4.0f), glm::normalize(glm::vec3(0.1f, 0.2f, -1.0f)) };
+	float expected = 3.0f / -ray.dir.z;
+	CHECK(glm::abs(mesh.castRay(ray) - expected) < 0.0001f);
+	CHECK(glm::abs(heightfield.castRay(ray) - expected) < 0.0001f);
+	CHECK(glm::abs(box.castRay(ray) - expected) < 0.0001f);
+
+	// pointing away
+	Ray away = { ray.start, -ray.dir };
+	CHECK(mesh.castRay(away) == 0.0f);
+	CHECK(heightfield.castRay(away) == 0.0f);
+	CHECK(box.castRay(away) == 0.0f);
+}
+
+int main()
+{
+	testRayTriangle();
+	testShapesAgree();
+
+	if (failures == 0)
+		std::printf("all ray tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Standalone checks for sensors, build with the repo root and glm on the include path:
+// g++ -std=c++17 -I. -I<glm> tests/SensorTests.cpp -o sensor_tests
+#include <cstdio>
+
+#include "../physics/World.h"
+
+using namespace fiz;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+// the number of events of a type for a body
+unsigned int countEvents(World& world, SensorEventType type, Body* body)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < world.sensor_events.size(); ++i)
+		count += world.sensor_events[i].type == type && world.sensor_events[i].body == body;
+	return count;
+}
+
+// a world without gravity or ground and a box sensor around the origin
+Body* createSensorWorld(World& world, Shape* shape)
+{
+	world.gravity = glm::vec3(0.0f);
+	world.ground_enabled = false;
+
+	BodyDef bd;
+	bd.type = BodyType::STATIC;
+	bd.is_sensor = true;
+	bd.shape = shape;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	bd.filter.category = 0x0002;
+	world.createBody(bd);
+	world.buildBVH();
+	return &world.sensor_bodies[0];
+}
+
+BodyHandle createSphere(World& world, Shape* shape, glm::vec3 pos)
+{
+	BodyDef bd;
+	bd.shape = shape;
+	bd.pos = pos;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	return world.createDynamicBody(bd);
+}
+
+// a body moved into the sensor and out again gets an enter, a stay and an exit in separate steps
+void testEnterStayExit()
+{
+	World world;
+	Box box(glm::vec3(0.0f), glm::vec3(1.0f));
+	Sphere sphere(glm::vec3(0.0f), 0.25f);
+	Body* sensor = createSensorWorld(world, &box);
+	BodyHandle handle = createSphere(world, &sphere, glm::vec3(-3.0f, 0.0f, 0.0f));
+
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.empty());
+
+	world.getBody(handle)->pos = glm::vec3(0.0f);
+	world.step(1.0f / 60.0f);
+	DynamicBody* body = world.getBody(handle);
+	CHECK(world.sensor_events.size() == 1);
+	CHECK(countEvents(world, SENSOR_ENTER, body) == 1);
+	CHECK(world.sensor_events.size() == 1 && world.sensor_events[0].sensor == sensor);
+
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.size() == 1);
+	CHECK(countEvents(world, SENSOR_STAY, body) == 1);
+
+	world.getBody(handle)->pos = glm::vec3(3.0f, 0.0f, 0.0f);
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.size() == 1);
+	CHECK(countEvents(world, SENSOR_EXIT, body) == 1);
+
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.empty());
+
+	// the body passed through without being pushed
+	CHECK(world.contact_manifolds.empty());
+	CHECK(world.getBody(handle)->vel == glm::vec3(0.0f));
+}
+
+// destroying a body drops its events and overlaps, the events of the body moved into its place follow it
+void testDestroyWithPendingEvent()
+{
+	World world;
+	Box box(glm::vec3(0.0f), glm::vec3(1.0f));
+	Sphere sphere(glm::vec3(0.0f), 0.25f);
+	Body* sensor = createSensorWorld(world, &box);
+	BodyHandle destroyed = createSphere(world, &sphere, glm::vec3(-0.5f, 0.0f, 0.0f));
+	BodyHandle kept = createSphere(world, &sphere, glm::vec3(0.5f, 0.0f, 0.0f));
+
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.size() == 2);
+
+	world.destroyBody(destroyed);
+	DynamicBody* body = world.getBody(kept);
+	CHECK(world.sensor_events.size() == 1);
+	CHECK(world.sensor_events.size() == 1 && world.sensor_events[0].body == body && world.sensor_events[0].sensor == sensor);
+	CHECK(world.sensor_overlaps.size() == 1 && world.sensor_overlaps[0].body == body);
+
+	// no exit for the destroyed body, it isn't there to leave
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.size() == 1);
+	CHECK(countEvents(world, SENSOR_STAY, world.getBody(kept)) == 1);
+}
+
+// a body whose mask rejects the sensor category is never reported
+void testFilteredBody()
+{
+	World world;
+	Box box(glm::vec3(0.0f), glm::vec3(1.0f));
+	Sphere sphere(glm::vec3(0.0f), 0.25f);
+	createSensorWorld(world, &box);
+
+	BodyDef bd;
+	bd.shape = &sphere;
+	bd.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	bd.filter.mask = ~0x0002u;
+	world.createDynamicBody(bd);
+
+	world.step(1.0f / 60.0f);
+	CHECK(world.sensor_events.empty());
+	CHECK(world.sensor_overlaps.empty());
+}
+
+int main()
+{
+	testEnterStayExit();
+	testDestroyWithPendingEvent();
+	testFilteredBody();
+
+	if (failures == 0)
+		std::printf("all sensor tests passed\n");
+	return failures == 0 ? 0 : 1;
+}